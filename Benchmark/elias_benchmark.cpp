@@ -0,0 +1,1569 @@
+//
+//  elias_benchmark.cpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Standalone benchmark for the portable encoders and decoders in
+//  elias.hpp, elias_encode.cpp and the C++ part of Eliasg.mm. The
+//  corpora are rebuilt from the configs in HuffRenderFrame without
+//  UIKit, images are loaded from the PNG and TGA files in Shared/.
+//
+//  Each variant is run on one frame until it has been timed for at
+//  least minIterations and about budgetSeconds. The p50 and p99 of
+//  the per frame times are reported along with MB/s and symbols/s
+//  at the p50 time and the bits per pixel of the stream. Results are
+//  printed as a table and written as JSON with --json.
+//
+//  Every decoder output is checked against the input image before
+//  it is timed, so a fast but broken variant can not be reported.
+//  The container and sequence variants time whole files written to
+//  P_tmpdir, the files are removed after each corpus.
+//
+//  The render pass schedule of decode.renderPasses is set with
+//  --render-targets, --render-passes and --combine-slices, and the
+//  bytes read and written by each emulated pass are also reported.
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <png.h>
+
+#include "elias_encode.h"
+#include "elias.hpp"
+#include "elias_threads.hpp"
+#include "elias_interleaved.hpp"
+#include "elias_deltas.hpp"
+#include "elias_block_index.hpp"
+#include "elias_render_passes.hpp"
+#include "elias_layout.hpp"
+#include "elias_planes.hpp"
+
+using namespace std;
+
+// Functions defined in Eliasg.mm, declared here since Eliasg.h is an
+// Objective C header.
+
+bool
+Eliasg_decodeBlockSymbols(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsOpt64(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsTable(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsParallel(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numThreads,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsSIMD(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_encodeBlockSymbolsParallel(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          int numThreads);
+
+bool
+Eliasg_decodeRegion(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int regionX,
+                          int regionY,
+                          int regionWidth,
+                          int regionHeight,
+                          uint8_t *outPtr,
+                          int outRowStride);
+
+bool
+Eliasg_decodeToLayout(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          EliasOutputLayoutKind layout,
+                          uint8_t *outPtr,
+                          int outRowStride,
+                          int numThreads);
+
+void
+Eliasg_encodeBlockSymbolsExpGolomb(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsExpGolomb(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+void
+Eliasg_encodeBlockSymbolsRuns(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsRuns(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_encodeBlockSymbolsHybrid(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockEntries);
+
+bool
+Eliasg_decodeBlockSymbolsHybrid(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockEntriesPtr,
+                          int blockDim);
+
+void
+Eliasg_encodeBlockSymbolsPredicted(
+                          const uint8_t *blockPixels,
+                          int numSymbols,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsPredicted(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+void
+Eliasg_encodeImageBlocks(
+                          const uint8_t *imageBytes,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int numBlocksInWidth,
+                          int numBlocksInHeight,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          uint8_t *outBlockDeltas);
+
+bool
+Eliasg_decodeBlockSymbolsIndexed(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          const EliasBlockIndex & blockIndex);
+
+bool
+Eliasg_encodeImageStrips(
+                          int width,
+                          int height,
+                          int blockDim,
+                          const std::function<bool(int y, uint8_t *rowPtr)> & rowSource,
+                          const std::function<void(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks)> & sink);
+
+void
+Eliasg_encodeImageBlocks16(
+                          const uint16_t *imageSymbols,
+                          int width,
+                          int height,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbols16(
+                          int numSymbolsToDecode,
+                          const uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint16_t *outBuffer,
+                          const uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_writeContainerFile(
+                          const char *path,
+                          int width,
+                          int height,
+                          int blockDim,
+                          const uint8_t *codesPtr,
+                          int codesNumBytes,
+                          const uint32_t *blockBitOffsetsPtr,
+                          int numBlocks);
+
+bool
+Eliasg_decodeContainerFile(
+                          const char *path,
+                          uint8_t *outBuffer,
+                          int outBufferNumBytes);
+
+bool
+Eliasg_encodeSequenceFile(
+                          const char *path,
+                          const uint8_t * const *framePtrs,
+                          int numFrames,
+                          int width,
+                          int height,
+                          int blockDim);
+
+bool
+Eliasg_decodeSequenceFile(
+                          const char *path,
+                          const std::function<void(int frameIndex, const uint8_t *blockPixels, int numSymbols)> & frameSink);
+
+void
+Eliasg_encodePlanes(
+                          const uint8_t *pixels,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          vector<vector<uint8_t> > & outPlaneCodes,
+                          vector<vector<uint32_t> > & outPlaneBlockBitOffsets);
+
+bool
+Eliasg_decodePlanes(
+                          const uint8_t * const *planeCodesPtrs,
+                          const int *planeCodesNumBytes,
+                          const uint32_t * const *planeBlockBitOffsetsPtrs,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride);
+
+bool
+Eliasg_emulateRenderPasses(
+                          const EliasRenderPassSchedule & schedule,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride,
+                          vector<EliasRenderPassStats> & outStats);
+
+// One grayscale input frame
+
+typedef struct {
+    string name;
+    int width;
+    int height;
+    vector<uint8_t> pixels;
+} BenchCorpus;
+
+// Timing and size result for one variant on one corpus
+
+typedef struct {
+    string corpus;
+    string variant;
+    bool isEncode;
+    int width;
+    int height;
+    int numSymbols;
+    int numBits;
+    int numIterations;
+    double p50Seconds;
+    double p99Seconds;
+} BenchResult;
+
+// Bytes read and written by each emulated render pass for one corpus
+
+typedef struct {
+    string corpus;
+    vector<EliasRenderPassStats> passes;
+} BenchRenderPasses;
+
+typedef struct {
+    string dataDir;
+    string jsonPath;
+    string corpusFilter;
+    string variantFilter;
+    int blockDim;
+    int minIterations;
+    int maxIterations;
+    double budgetSeconds;
+    unsigned int seed;
+    EliasRenderPassSchedule schedule;
+} BenchOptions;
+
+// Corpus generation, see HuffRenderFrame renderFrameForConfig:
+
+static
+BenchCorpus makeCorpus(const char *name, int width, int height, const uint8_t *values)
+{
+    BenchCorpus corpus;
+    corpus.name = name;
+    corpus.width = width;
+    corpus.height = height;
+    corpus.pixels.assign(values, values + (width * height));
+    return corpus;
+}
+
+static
+void appendIdentCorpora(vector<BenchCorpus> & corpora)
+{
+    {
+        static const uint8_t values[] = {
+            0,  1,  4,  5,   10, 11, 14, 15,
+            2,  3,  6,  7,   12, 13, 16, 17,
+            8,  9,  12, 13,  18, 19, 22, 23,
+            10, 11, 14, 15,  20, 21, 24, 25,
+
+            30, 31, 34, 35,  40, 41, 44, 45,
+            32, 33, 36, 37,  42, 43, 46, 47,
+            38, 39, 42, 43,  48, 49, 52, 53,
+            40, 41, 44, 45,  50, 51, 54, 55,
+        };
+        corpora.push_back(makeCorpus("TEST_8x8_IDENT", 8, 8, values));
+    }
+
+    {
+        uint8_t values[16 * 8];
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                values[(row * 16) + col] = (uint8_t) (((row % 4) * 8) + col);
+                values[(row * 16) + 8 + col] = (uint8_t) ((col + 1) * 2);
+            }
+        }
+        corpora.push_back(makeCorpus("TEST_16x8_IDENT", 16, 8, values));
+    }
+
+    {
+        // Rows alternate between increasing and decreasing runs on the
+        // left and a constant step or noise pattern on the right.
+
+        static const uint8_t leftRows[4][8] = {
+            { 0,  1,  2,  3,   4,  5,  6,  7 },
+            { 10, 9,  8,  7,   6,  5,  4,  3 },
+            { 50, 51, 52, 53,  54, 55, 56, 57 },
+            { 58, 57, 56, 55,  54, 53, 52, 51 },
+        };
+        static const uint8_t rightRows[2][8] = {
+            { 102, 104, 106, 108, 110, 112, 114, 116 },
+            { 3,   5,   6,   3,   1,   2,   1,   1 },
+        };
+
+        uint8_t values[16 * 16];
+        for (int row = 0; row < 16; row++) {
+            const int half = (row / 4) % 2;
+            memcpy(&values[row * 16], leftRows[(half * 2) + (row % 2)], 8);
+            memcpy(&values[(row * 16) + 8], rightRows[half], 8);
+        }
+        corpora.push_back(makeCorpus("TEST_16x16_IDENT", 16, 16, values));
+    }
+
+    {
+        static const uint8_t firstRow[5] = { 228, 228, 228, 44, 2 };
+
+        uint8_t values[16 * 16];
+
+        memset(values, 0, sizeof(values));
+        memcpy(values, firstRow, sizeof(firstRow));
+        corpora.push_back(makeCorpus("TEST_16x16_IDENT2", 16, 16, values));
+
+        memset(values, 0, sizeof(values));
+        memcpy(&values[8 * 16], firstRow, sizeof(firstRow));
+        corpora.push_back(makeCorpus("TEST_16x16_IDENT3", 16, 16, values));
+    }
+
+    {
+        // Very wide image with partial blocks at the right and bottom
+        // edges, the morton layout cuts it into many small squares
+
+        BenchCorpus corpus;
+        corpus.name = "TEST_WIDE_4100x60";
+        corpus.width = 4100;
+        corpus.height = 60;
+        corpus.pixels.resize((size_t)corpus.width * corpus.height);
+        for (int y = 0; y < corpus.height; y++) {
+            for (int x = 0; x < corpus.width; x++) {
+                corpus.pixels[((size_t)y * corpus.width) + x] = (uint8_t) ((x / 3) + (y * 5));
+            }
+        }
+        corpora.push_back(std::move(corpus));
+    }
+
+    for (int dim = 2048; dim <= 4096; dim *= 2) {
+        BenchCorpus corpus;
+        corpus.name = (dim == 2048) ? "TEST_8x8_IDENT_2048" : "TEST_8x8_IDENT_4096";
+        corpus.width = dim;
+        corpus.height = dim;
+        corpus.pixels.resize((size_t)dim * dim);
+        for (size_t i = 0; i < corpus.pixels.size(); i++) {
+            corpus.pixels[i] = (uint8_t) (i % 256);
+        }
+        corpora.push_back(std::move(corpus));
+    }
+}
+
+// The app seeds with sranddev(), a fixed seed is used here so that
+// runs can be compared.
+
+static
+BenchCorpus makeLargeRandomCorpus(unsigned int seed)
+{
+    BenchCorpus corpus;
+    corpus.name = "TEST_LARGE_RANDOM";
+    corpus.width = 1024;
+    corpus.height = 1024;
+    corpus.pixels.resize(corpus.width * corpus.height);
+
+    srand(seed);
+
+    for (size_t i = 0; i < corpus.pixels.size(); i++) {
+        float normalized = rand() / (float) RAND_MAX;
+        corpus.pixels[i] = (uint8_t) round(normalized * 255);
+    }
+
+    return corpus;
+}
+
+// Rec. 601 luma in 8 bit fixed point, close to but not bit identical
+// with a CoreGraphics DeviceGray bitmap context.
+
+static inline
+uint8_t grayFromRGB(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (uint8_t) (((r * 77) + (g * 150) + (b * 29) + 128) >> 8);
+}
+
+static
+bool loadPNGCorpus(const string & path, const char *name, BenchCorpus & corpus)
+{
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&image, path.c_str())) {
+        return false;
+    }
+
+    image.format = PNG_FORMAT_RGB;
+
+    vector<uint8_t> rgb(PNG_IMAGE_SIZE(image));
+
+    if (!png_image_finish_read(&image, NULL, rgb.data(), 0, NULL)) {
+        png_image_free(&image);
+        return false;
+    }
+
+    corpus.name = name;
+    corpus.width = (int) image.width;
+    corpus.height = (int) image.height;
+    corpus.pixels.resize((size_t)corpus.width * corpus.height);
+
+    for (size_t i = 0; i < corpus.pixels.size(); i++) {
+        corpus.pixels[i] = grayFromRGB(rgb[(i*3)+0], rgb[(i*3)+1], rgb[(i*3)+2]);
+    }
+
+    return true;
+}
+
+// Uncompressed true color or grayscale TGA, 8, 24 or 32 bits per pixel
+
+static
+bool loadTGACorpus(const string & path, const char *name, BenchCorpus & corpus)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    uint8_t header[18];
+    bool worked = (fread(header, 1, sizeof(header), fp) == sizeof(header));
+
+    const int imageType = header[2];
+    const int width = header[12] | (header[13] << 8);
+    const int height = header[14] | (header[15] << 8);
+    const int bytesPerPixel = header[16] / 8;
+    const bool topToBottom = (header[17] & 0x20) != 0;
+
+    worked = worked && (imageType == 2 || imageType == 3) && header[1] == 0;
+    worked = worked && (bytesPerPixel == 1 || bytesPerPixel == 3 || bytesPerPixel == 4);
+    worked = worked && (fseek(fp, header[0], SEEK_CUR) == 0);
+
+    vector<uint8_t> bytes;
+
+    if (worked) {
+        bytes.resize((size_t)width * height * bytesPerPixel);
+        worked = (fread(bytes.data(), 1, bytes.size(), fp) == bytes.size());
+    }
+
+    fclose(fp);
+
+    if (!worked) {
+        return false;
+    }
+
+    corpus.name = name;
+    corpus.width = width;
+    corpus.height = height;
+    corpus.pixels.resize((size_t)width * height);
+
+    for (int row = 0; row < height; row++) {
+        const int srcRow = topToBottom ? row : (height - 1 - row);
+        const uint8_t *srcPtr = bytes.data() + ((size_t)srcRow * width * bytesPerPixel);
+        uint8_t *outPtr = corpus.pixels.data() + ((size_t)row * width);
+
+        for (int col = 0; col < width; col++) {
+            const uint8_t *pixelPtr = srcPtr + (col * bytesPerPixel);
+            if (bytesPerPixel == 1) {
+                outPtr[col] = pixelPtr[0];
+            } else {
+                // TGA pixels are stored as B G R (A)
+                outPtr[col] = grayFromRGB(pixelPtr[2], pixelPtr[1], pixelPtr[0]);
+            }
+        }
+    }
+
+    return true;
+}
+
+static
+void appendImageCorpora(vector<BenchCorpus> & corpora, const string & dataDir)
+{
+    static const char *pngFiles[][2] = {
+        { "TEST_IMAGE1", "Image.png" },
+        { "TEST_IMAGE2", "ImageHuge.png" },
+        { "TEST_IMAGE3", "ImageIpadSize.png" },
+        { "TEST_IMAGE4", "BigBridge.png" },
+    };
+
+    for (size_t i = 0; i < sizeof(pngFiles)/sizeof(pngFiles[0]); i++) {
+        BenchCorpus corpus;
+        string path = dataDir + "/" + pngFiles[i][1];
+        if (loadPNGCorpus(path, pngFiles[i][0], corpus)) {
+            corpora.push_back(std::move(corpus));
+        } else {
+            fprintf(stderr, "skipping %s : could not load %s\n", pngFiles[i][0], path.c_str());
+        }
+    }
+
+    {
+        BenchCorpus corpus;
+        string path = dataDir + "/Image.tga";
+        if (loadTGACorpus(path, "IMAGE_TGA", corpus)) {
+            corpora.push_back(std::move(corpus));
+        } else {
+            fprintf(stderr, "skipping IMAGE_TGA : could not load %s\n", path.c_str());
+        }
+    }
+}
+
+// Timing
+
+static
+double percentile(const vector<double> & sortedSeconds, double fraction)
+{
+    size_t i = (size_t) ceil(fraction * sortedSeconds.size());
+    i = (i == 0) ? 0 : (i - 1);
+    return sortedSeconds[min(i, sortedSeconds.size() - 1)];
+}
+
+// Time func once per frame after one warm up call
+
+static
+void timeFrames(const BenchOptions & options, const std::function<void()> & func, BenchResult & result)
+{
+    vector<double> frameSeconds;
+    double totalSeconds = 0.0;
+
+    func();
+
+    while ((int)frameSeconds.size() < options.minIterations ||
+           (totalSeconds < options.budgetSeconds && (int)frameSeconds.size() < options.maxIterations))
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        frameSeconds.push_back(elapsed.count());
+        totalSeconds += elapsed.count();
+    }
+
+    sort(frameSeconds.begin(), frameSeconds.end());
+
+    result.numIterations = (int) frameSeconds.size();
+    result.p50Seconds = percentile(frameSeconds, 0.50);
+    result.p99Seconds = percentile(frameSeconds, 0.99);
+}
+
+// Size of a file in bits, or 0 if it can not be read
+
+static
+int fileNumBits(const string & path)
+{
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) {
+        return 0;
+    }
+    return (int) (fileStat.st_size * 8);
+}
+
+static
+bool matchesFilter(const string & filter, const string & name)
+{
+    return filter.empty() || name.find(filter) != string::npos;
+}
+
+// Encode and decode one corpus with every variant
+
+static
+void benchmarkCorpus(const BenchOptions & options,
+                     const BenchCorpus & corpus,
+                     vector<BenchResult> & results,
+                     vector<BenchRenderPasses> & renderPasses)
+{
+    const int blockDim = options.blockDim;
+    const int width = corpus.width;
+    const int height = corpus.height;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    const int numSymbols = (numBlocksInWidth * numBlocksInHeight) * (blockDim * blockDim);
+    const uint8_t *imageBytes = corpus.pixels.data();
+
+    // Block order deltas and codes used as input by the other variants
+
+    vector<uint8_t> blockDeltas(numSymbols);
+    vector<uint8_t> codes;
+    vector<uint32_t> blockBitOffsets;
+
+    Eliasg_encodeImageBlocks(imageBytes, width, height, blockDim, numBlocksInWidth, numBlocksInHeight,
+                             codes, blockBitOffsets, blockDeltas.data());
+
+    const int numCodeBits = (int) (codes.size() - 2) * 8;
+
+    // Block order pixels that every block decoder must output
+
+    vector<uint8_t> blockPixels(blockDeltas);
+    EliasZerodDeltas::undoBlockDeltas(blockPixels.data(), numBlocksInWidth * numBlocksInHeight, blockDim * blockDim);
+
+    vector<uint8_t> decoded(numSymbols);
+
+    auto newResult = [&](const char *variant, bool isEncode, int numBits) {
+        BenchResult result;
+        result.corpus = corpus.name;
+        result.variant = variant;
+        result.isEncode = isEncode;
+        result.width = width;
+        result.height = height;
+        result.numSymbols = numSymbols;
+        result.numBits = numBits;
+        return result;
+    };
+
+    auto runVariant = [&](BenchResult result, const std::function<void()> & func, const std::function<bool()> & check) {
+        if (!matchesFilter(options.variantFilter, result.variant)) {
+            return;
+        }
+        func();
+        if (!check()) {
+            fprintf(stderr, "%s : %s : output does not match input\n", corpus.name.c_str(), result.variant.c_str());
+            exit(1);
+        }
+        timeFrames(options, func, result);
+        results.push_back(result);
+    };
+
+    // Encoders
+
+    {
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.imageBlocks", true, numCodeBits), [&]() {
+            Eliasg_encodeImageBlocks(imageBytes, width, height, blockDim, numBlocksInWidth, numBlocksInHeight,
+                                     outCodes, outOffsets, NULL);
+        }, [&]() {
+            return outCodes == codes && outOffsets == blockBitOffsets;
+        });
+    }
+
+    {
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        bool worked = false;
+        runVariant(newResult("encode.parallel", true, numCodeBits), [&]() {
+            worked = Eliasg_encodeBlockSymbolsParallel(blockDeltas.data(), numSymbols, blockDim * blockDim, outCodes, outOffsets, 0);
+        }, [&]() {
+            return worked && outCodes == codes && outOffsets == blockBitOffsets;
+        });
+    }
+
+    {
+        // Streaming encode of one strip of rows at a time, the strips
+        // must add up to the whole image encode.
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.strips", true, numCodeBits), [&]() {
+            outCodes.clear();
+            outOffsets.clear();
+            Eliasg_encodeImageStrips(width, height, blockDim, [&](int y, uint8_t *rowPtr) {
+                memcpy(rowPtr, imageBytes + ((size_t)y * width), width);
+                return true;
+            }, [&](const uint8_t *codesPtr, int numBytes, const uint32_t *offsetsPtr, int numBlocks) {
+                outCodes.insert(outCodes.end(), codesPtr, codesPtr + numBytes);
+                outOffsets.insert(outOffsets.end(), offsetsPtr, offsetsPtr + numBlocks);
+            });
+        }, [&]() {
+            return outCodes == codes && outOffsets == blockBitOffsets;
+        });
+    }
+
+    {
+        // Bit by bit encoder and 16 bit register decoder on one stream of
+        // the block order deltas, the stream is the same as the block codes.
+
+        EliasGammaEncoder encoder;
+        encoder.emitPaddingZeros = true;
+        encoder.emitMSB = true;
+        runVariant(newResult("encode.baseline", true, numCodeBits), [&]() {
+            encoder.reset();
+            encoder.encode(blockDeltas.data(), numSymbols);
+        }, [&]() {
+            return encoder.bytes == codes;
+        });
+
+        EliasGammaDecoderOpt16 decoder;
+        vector<uint8_t> decodedDeltas(numSymbols);
+        runVariant(newResult("decode.opt16", false, numCodeBits), [&]() {
+            decoder.decode(codes.data(), numSymbols, decodedDeltas);
+        }, [&]() {
+            return decodedDeltas == blockDeltas;
+        });
+    }
+
+    {
+        // Block order deltas in 4 interleaved streams with one block in
+        // each chunk, the size does not count the header and padding.
+
+        EliasGammaInterleavedEncoder encoder;
+        encoder.numStreams = 4;
+        encoder.numSymbolsInChunk = blockDim * blockDim;
+        encoder.encode(blockDeltas.data(), numSymbols);
+        const vector<uint8_t> interleavedCodes = encoder.bytes;
+        const int numBits = (int) (interleavedCodes.size() - EliasGammaInterleaved::headerNumBytes - EliasGammaInterleaved::numPaddingBytes) * 8;
+
+        runVariant(newResult("encode.interleaved", true, numBits), [&]() {
+            encoder.encode(blockDeltas.data(), numSymbols);
+        }, [&]() {
+            return encoder.bytes == interleavedCodes;
+        });
+
+        EliasGammaInterleavedDecoder decoder;
+        vector<uint8_t> decodedDeltas;
+        bool worked = false;
+        runVariant(newResult("decode.interleaved", false, numBits), [&]() {
+            worked = decoder.decode(interleavedCodes.data(), (unsigned int) interleavedCodes.size(), decodedDeltas);
+        }, [&]() {
+            return worked && decodedDeltas == blockDeltas;
+        });
+    }
+
+    {
+        vector<uint8_t> expCodes;
+        vector<uint32_t> expOffsets;
+        Eliasg_encodeBlockSymbolsExpGolomb(blockDeltas.data(), numSymbols, blockDim * blockDim, expCodes, expOffsets);
+        const int numBits = (int) (expCodes.size() - 2) * 8;
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.expGolomb", true, numBits), [&]() {
+            Eliasg_encodeBlockSymbolsExpGolomb(blockDeltas.data(), numSymbols, blockDim * blockDim, outCodes, outOffsets);
+        }, [&]() {
+            return outCodes == expCodes;
+        });
+
+        runVariant(newResult("decode.expGolomb", false, numBits), [&]() {
+            Eliasg_decodeBlockSymbolsExpGolomb(numSymbols, expCodes.data(), (int) expCodes.size(), decoded.data(), expOffsets.data(), blockDim);
+        }, [&]() {
+            return decoded == blockPixels;
+        });
+    }
+
+    {
+        vector<uint8_t> runCodes;
+        vector<uint32_t> runOffsets;
+        Eliasg_encodeBlockSymbolsRuns(blockDeltas.data(), numSymbols, blockDim * blockDim, runCodes, runOffsets);
+        const int numBits = (int) (runCodes.size() - 2) * 8;
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.runs", true, numBits), [&]() {
+            Eliasg_encodeBlockSymbolsRuns(blockDeltas.data(), numSymbols, blockDim * blockDim, outCodes, outOffsets);
+        }, [&]() {
+            return outCodes == runCodes;
+        });
+
+        runVariant(newResult("decode.runs", false, numBits), [&]() {
+            Eliasg_decodeBlockSymbolsRuns(numSymbols, runCodes.data(), (int) runCodes.size(), decoded.data(), runOffsets.data(), blockDim);
+        }, [&]() {
+            return decoded == blockPixels;
+        });
+    }
+
+    {
+        vector<uint8_t> hybridCodes;
+        vector<uint32_t> hybridEntries;
+        if (!Eliasg_encodeBlockSymbolsHybrid(blockDeltas.data(), numSymbols, blockDim * blockDim, hybridCodes, hybridEntries)) {
+            fprintf(stderr, "%s : hybrid block offsets do not fit in 30 bits\n", corpus.name.c_str());
+            exit(1);
+        }
+        const int numBits = (int) (hybridCodes.size() - 2) * 8;
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outEntries;
+        runVariant(newResult("encode.hybrid", true, numBits), [&]() {
+            Eliasg_encodeBlockSymbolsHybrid(blockDeltas.data(), numSymbols, blockDim * blockDim, outCodes, outEntries);
+        }, [&]() {
+            return outCodes == hybridCodes && outEntries == hybridEntries;
+        });
+
+        runVariant(newResult("decode.hybrid", false, numBits), [&]() {
+            Eliasg_decodeBlockSymbolsHybrid(numSymbols, hybridCodes.data(), (int) hybridCodes.size(), decoded.data(), hybridEntries.data(), blockDim);
+        }, [&]() {
+            return decoded == blockPixels;
+        });
+    }
+
+    {
+        vector<uint8_t> predictedCodes;
+        vector<uint32_t> predictedOffsets;
+        Eliasg_encodeBlockSymbolsPredicted(blockPixels.data(), numSymbols, blockDim, predictedCodes, predictedOffsets);
+        const int numBits = (int) (predictedCodes.size() - 2) * 8;
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.predicted", true, numBits), [&]() {
+            Eliasg_encodeBlockSymbolsPredicted(blockPixels.data(), numSymbols, blockDim, outCodes, outOffsets);
+        }, [&]() {
+            return outCodes == predictedCodes && outOffsets == predictedOffsets;
+        });
+
+        runVariant(newResult("decode.predicted", false, numBits), [&]() {
+            Eliasg_decodeBlockSymbolsPredicted(numSymbols, predictedCodes.data(), (int) predictedCodes.size(), decoded.data(), predictedOffsets.data(), blockDim);
+        }, [&]() {
+            return decoded == blockPixels;
+        });
+    }
+
+    {
+        // Single stream of the raster pixels without deltas or blocks
+
+        const int numFlatSymbols = width * height;
+        vector<uint8_t> flatCodes(elias_gamma_encode_max_num_bytes(numFlatSymbols));
+        vector<uint8_t> flatDecoded(numFlatSymbols);
+        int numFlatBits = 0;
+        int numFlatBytes = elias_gamma_encode_into(imageBytes, numFlatSymbols, flatCodes.data(), (int) flatCodes.size(), &numFlatBits);
+
+        BenchResult encodeResult = newResult("encode.flat", true, numFlatBits);
+        encodeResult.numSymbols = numFlatSymbols;
+        vector<uint8_t> outCodes(flatCodes.size());
+        runVariant(encodeResult, [&]() {
+            elias_gamma_encode_into(imageBytes, numFlatSymbols, outCodes.data(), (int) outCodes.size(), NULL);
+        }, [&]() {
+            return memcmp(outCodes.data(), flatCodes.data(), numFlatBytes) == 0;
+        });
+
+        BenchResult decodeResult = newResult("decode.flat", false, numFlatBits);
+        decodeResult.numSymbols = numFlatSymbols;
+        runVariant(decodeResult, [&]() {
+            elias_gamma_decode_into(flatCodes.data(), numFlatBytes, flatDecoded.data(), numFlatSymbols, NULL);
+        }, [&]() {
+            return memcmp(flatDecoded.data(), imageBytes, numFlatSymbols) == 0;
+        });
+    }
+
+    {
+        // 12 bit symbols with the gray pixel in the high bits and the low
+        // bits of the column in the low bits. The decoder output is the
+        // zero padded blocks of symbols in block order.
+
+        vector<uint16_t> symbols16((size_t)width * height);
+        vector<uint16_t> blockSymbols16(numSymbols, 0);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const uint16_t symbol = (uint16_t) ((imageBytes[((size_t)y * width) + x] << 4) | (x & 0xF));
+                const int blocki = ((y / blockDim) * numBlocksInWidth) + (x / blockDim);
+                symbols16[((size_t)y * width) + x] = symbol;
+                blockSymbols16[((size_t)blocki * blockDim * blockDim) + ((y % blockDim) * blockDim) + (x % blockDim)] = symbol;
+            }
+        }
+
+        vector<uint8_t> codes16;
+        vector<uint32_t> offsets16;
+        Eliasg_encodeImageBlocks16(symbols16.data(), width, height, blockDim, codes16, offsets16);
+        const int numBits = (int) (codes16.size() - 2) * 8;
+
+        vector<uint8_t> outCodes;
+        vector<uint32_t> outOffsets;
+        runVariant(newResult("encode.symbols16", true, numBits), [&]() {
+            Eliasg_encodeImageBlocks16(symbols16.data(), width, height, blockDim, outCodes, outOffsets);
+        }, [&]() {
+            return outCodes == codes16 && outOffsets == offsets16;
+        });
+
+        vector<uint16_t> decoded16(numSymbols);
+        runVariant(newResult("decode.symbols16", false, numBits), [&]() {
+            Eliasg_decodeBlockSymbols16(numSymbols, codes16.data(), (int) codes16.size(), decoded16.data(), offsets16.data(), blockDim);
+        }, [&]() {
+            return decoded16 == blockSymbols16;
+        });
+    }
+
+    {
+        // BGRA pixels with the gray pixel in G and B and R derived from it,
+        // encoded as Y Co Cg A planes with the YCoCg-R transform.
+
+        const EliasPixelFormat format = EliasPixelFormatBGRA;
+        const EliasColorTransform transform = EliasColorTransformYCoCgR;
+        const int numPlanes = EliasPlanes::numPlanes(format);
+
+        vector<uint8_t> pixels((size_t)width * height * numPlanes);
+        for (size_t i = 0; i < corpus.pixels.size(); i++) {
+            const uint8_t gray = corpus.pixels[i];
+            pixels[(i*4)+0] = (uint8_t) ((gray / 2) + 64);
+            pixels[(i*4)+1] = gray;
+            pixels[(i*4)+2] = (uint8_t) (255 - gray);
+            pixels[(i*4)+3] = 0xFF;
+        }
+
+        vector<vector<uint8_t> > planeCodes;
+        vector<vector<uint32_t> > planeOffsets;
+        Eliasg_encodePlanes(pixels.data(), width, height, format, transform, blockDim, planeCodes, planeOffsets);
+
+        int numBits = 0;
+        const uint8_t *planeCodesPtrs[EliasPlanes::maxNumPlanes];
+        int planeCodesNumBytes[EliasPlanes::maxNumPlanes];
+        const uint32_t *planeOffsetsPtrs[EliasPlanes::maxNumPlanes];
+        for (int planei = 0; planei < numPlanes; planei++) {
+            numBits += (int) (planeCodes[planei].size() - 2) * 8;
+            planeCodesPtrs[planei] = planeCodes[planei].data();
+            planeCodesNumBytes[planei] = (int) planeCodes[planei].size();
+            planeOffsetsPtrs[planei] = planeOffsets[planei].data();
+        }
+
+        vector<vector<uint8_t> > outPlaneCodes;
+        vector<vector<uint32_t> > outPlaneOffsets;
+        BenchResult encodeResult = newResult("encode.planes", true, numBits);
+        encodeResult.numSymbols = numSymbols * numPlanes;
+        runVariant(encodeResult, [&]() {
+            Eliasg_encodePlanes(pixels.data(), width, height, format, transform, blockDim, outPlaneCodes, outPlaneOffsets);
+        }, [&]() {
+            return outPlaneCodes == planeCodes && outPlaneOffsets == planeOffsets;
+        });
+
+        vector<uint8_t> outPixels(pixels.size());
+        BenchResult decodeResult = newResult("decode.planes", false, numBits);
+        decodeResult.numSymbols = numSymbols * numPlanes;
+        runVariant(decodeResult, [&]() {
+            Eliasg_decodePlanes(planeCodesPtrs, planeCodesNumBytes, planeOffsetsPtrs, width, height, format, transform, blockDim,
+                                outPixels.data(), width * numPlanes);
+        }, [&]() {
+            return outPixels == pixels;
+        });
+    }
+
+    // Container and sequence files are written to a temp path, the size
+    // is the whole file.
+
+    const string tempPath = string(P_tmpdir) + "/elias_benchmark_" + to_string(getpid());
+
+    {
+        // Write a container file and decode from the memory mapped file
+
+        const string path = tempPath + ".elgc";
+        const int numBlocks = numBlocksInWidth * numBlocksInHeight;
+
+        if (!Eliasg_writeContainerFile(path.c_str(), width, height, blockDim, codes.data(), (int) codes.size(), blockBitOffsets.data(), numBlocks)) {
+            fprintf(stderr, "%s : could not write %s\n", corpus.name.c_str(), path.c_str());
+            exit(1);
+        }
+        const int numBits = fileNumBits(path);
+
+        bool worked = false;
+        runVariant(newResult("encode.container", true, numBits), [&]() {
+            worked = Eliasg_writeContainerFile(path.c_str(), width, height, blockDim, codes.data(), (int) codes.size(), blockBitOffsets.data(), numBlocks);
+        }, [&]() {
+            return worked && Eliasg_decodeContainerFile(path.c_str(), decoded.data(), numSymbols) && decoded == blockPixels;
+        });
+
+        runVariant(newResult("decode.container", false, numBits), [&]() {
+            worked = Eliasg_decodeContainerFile(path.c_str(), decoded.data(), numSymbols);
+        }, [&]() {
+            return worked && decoded == blockPixels;
+        });
+
+        remove(path.c_str());
+    }
+
+    {
+        // Sequence of frames that pan one pixel to the left each frame.
+        // The frames are counted as one image of numFrames times the height.
+
+        const int numFrames = 4;
+        const string path = tempPath + ".elgs";
+
+        vector<vector<uint8_t> > frames(numFrames);
+        vector<const uint8_t *> framePtrs(numFrames);
+        vector<uint8_t> framesBlockPixels((size_t)numFrames * numSymbols);
+        vector<uint8_t> decodedFrames(framesBlockPixels.size());
+
+        for (int framei = 0; framei < numFrames; framei++) {
+            vector<uint8_t> & frame = frames[framei];
+            frame.resize((size_t)width * height);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    frame[((size_t)y * width) + x] = imageBytes[((size_t)y * width) + min(x + framei, width - 1)];
+                }
+            }
+            framePtrs[framei] = frame.data();
+
+            vector<uint8_t> frameCodes;
+            vector<uint32_t> frameOffsets;
+            uint8_t *frameBlockPixels = framesBlockPixels.data() + ((size_t)framei * numSymbols);
+            Eliasg_encodeImageBlocks(frame.data(), width, height, blockDim, numBlocksInWidth, numBlocksInHeight,
+                                     frameCodes, frameOffsets, frameBlockPixels);
+            EliasZerodDeltas::undoBlockDeltas(frameBlockPixels, numBlocksInWidth * numBlocksInHeight, blockDim * blockDim);
+        }
+
+        if (!Eliasg_encodeSequenceFile(path.c_str(), framePtrs.data(), numFrames, width, height, blockDim)) {
+            fprintf(stderr, "%s : could not write %s\n", corpus.name.c_str(), path.c_str());
+            exit(1);
+        }
+        const int numBits = fileNumBits(path);
+
+        auto frameSink = [&](int framei, const uint8_t *framePixels, int numFrameSymbols) {
+            memcpy(decodedFrames.data() + ((size_t)framei * numSymbols), framePixels, numFrameSymbols);
+        };
+
+        bool worked = false;
+        BenchResult encodeResult = newResult("encode.sequence", true, numBits);
+        encodeResult.height = height * numFrames;
+        encodeResult.numSymbols = numSymbols * numFrames;
+        runVariant(encodeResult, [&]() {
+            worked = Eliasg_encodeSequenceFile(path.c_str(), framePtrs.data(), numFrames, width, height, blockDim);
+        }, [&]() {
+            return worked && Eliasg_decodeSequenceFile(path.c_str(), frameSink) && decodedFrames == framesBlockPixels;
+        });
+
+        BenchResult decodeResult = newResult("decode.sequence", false, numBits);
+        decodeResult.height = height * numFrames;
+        decodeResult.numSymbols = numSymbols * numFrames;
+        runVariant(decodeResult, [&]() {
+            std::fill(decodedFrames.begin(), decodedFrames.end(), 0);
+            worked = Eliasg_decodeSequenceFile(path.c_str(), frameSink);
+        }, [&]() {
+            return worked && decodedFrames == framesBlockPixels;
+        });
+
+        remove(path.c_str());
+    }
+
+    // Block decoders, all read the codes from Eliasg_encodeImageBlocks
+
+    uint8_t *bitBuff = codes.data();
+    const int bitBuffN = (int) codes.size();
+    uint32_t *offsetsPtr = blockBitOffsets.data();
+
+    auto checkBlockPixels = [&]() {
+        return decoded == blockPixels;
+    };
+
+    runVariant(newResult("decode.shaderSim", false, numCodeBits), [&]() {
+        Eliasg_decodeBlockSymbols(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+    }, checkBlockPixels);
+
+    runVariant(newResult("decode.opt64", false, numCodeBits), [&]() {
+        Eliasg_decodeBlockSymbolsOpt64(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+    }, checkBlockPixels);
+
+    runVariant(newResult("decode.table", false, numCodeBits), [&]() {
+        Eliasg_decodeBlockSymbolsTable(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+    }, checkBlockPixels);
+
+    {
+        // Two level block index in place of the flat offset table
+
+        EliasBlockIndex blockIndex;
+        if (!blockIndex.build(offsetsPtr, numBlocksInWidth * numBlocksInHeight, blockDim)) {
+            fprintf(stderr, "%s : block offsets do not fit in the block index\n", corpus.name.c_str());
+            exit(1);
+        }
+
+        runVariant(newResult("decode.indexed", false, numCodeBits), [&]() {
+            Eliasg_decodeBlockSymbolsIndexed(numSymbols, bitBuff, bitBuffN, decoded.data(), blockIndex);
+        }, checkBlockPixels);
+    }
+
+    runVariant(newResult("decode.simd", false, numCodeBits), [&]() {
+        Eliasg_decodeBlockSymbolsSIMD(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+    }, checkBlockPixels);
+
+    runVariant(newResult("decode.parallel", false, numCodeBits), [&]() {
+        Eliasg_decodeBlockSymbolsParallel(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, 0, blockDim);
+    }, checkBlockPixels);
+
+    // Scaling curve with one row for each thread count up to the number of cores
+
+    const int numCores = max(1, (int) std::thread::hardware_concurrency());
+
+    for (int numThreads = 1; numThreads <= numCores; numThreads++) {
+        runVariant(newResult(("decode.parallel.x" + to_string(numThreads)).c_str(), false, numCodeBits), [&]() {
+            Eliasg_decodeBlockSymbolsParallel(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, numThreads, blockDim);
+        }, checkBlockPixels);
+    }
+
+    {
+        // Full frame region decode writes raster pixels
+
+        vector<uint8_t> raster((size_t)width * height);
+        runVariant(newResult("decode.region", false, numCodeBits), [&]() {
+            Eliasg_decodeRegion(bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                0, 0, width, height, raster.data(), width);
+        }, [&]() {
+            return raster == corpus.pixels;
+        });
+    }
+
+    {
+        // Table decode to block order followed by a separate deblock pass,
+        // the raster, slices and morton variants write the final layout directly.
+
+        vector<uint8_t> raster((size_t)width * height);
+        runVariant(newResult("decode.deblock", false, numCodeBits), [&]() {
+            Eliasg_decodeBlockSymbolsTable(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+            for (int y = 0; y < height; y++) {
+                const int blockY = y / blockDim;
+                for (int blockX = 0; blockX < numBlocksInWidth; blockX++) {
+                    const int x = blockX * blockDim;
+                    const uint8_t *blockRowPtr = decoded.data() + ((size_t)((blockY * numBlocksInWidth) + blockX) * (blockDim * blockDim)) + ((y - (blockY * blockDim)) * blockDim);
+                    memcpy(raster.data() + ((size_t)y * width) + x, blockRowPtr, min(blockDim, width - x));
+                }
+            }
+        }, [&]() {
+            return raster == corpus.pixels;
+        });
+
+        const int rasterRowStride = width;
+        runVariant(newResult("decode.raster", false, numCodeBits), [&]() {
+            Eliasg_decodeToLayout(bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                  EliasOutputLayoutRaster, raster.data(), rasterRowStride, 1);
+        }, [&]() {
+            return raster == corpus.pixels;
+        });
+
+        runVariant(newResult("decode.rasterThreads", false, numCodeBits), [&]() {
+            Eliasg_decodeToLayout(bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                  EliasOutputLayoutRaster, raster.data(), rasterRowStride, 0);
+        }, [&]() {
+            return raster == corpus.pixels;
+        });
+
+        // Combined slices texture, the expected texels are built from
+        // the block order pixels.
+
+        const int numSlices = (blockDim * blockDim) / 4;
+        const int slicesRowStride = EliasOutputLayout::minRowStride(EliasOutputLayoutSlices, width, blockDim);
+        vector<uint8_t> slices(EliasOutputLayout::numBytes(EliasOutputLayoutSlices, width, height, blockDim, slicesRowStride));
+        vector<uint8_t> expectedSlices(slices.size());
+        for (int blocki = 0; blocki < numBlocksInWidth * numBlocksInHeight; blocki++) {
+            for (int slice = 0; slice < numSlices; slice++) {
+                const int x = ((slice % EliasOutputLayout::maxNumSlicesInRow) * numBlocksInWidth) + (blocki % numBlocksInWidth);
+                const int y = ((slice / EliasOutputLayout::maxNumSlicesInRow) * numBlocksInHeight) + (blocki / numBlocksInWidth);
+                memcpy(&expectedSlices[((size_t)y * slicesRowStride) + (x * 4)], &blockPixels[((size_t)blocki * blockDim * blockDim) + (slice * 4)], 4);
+            }
+        }
+        runVariant(newResult("decode.slices", false, numCodeBits), [&]() {
+            Eliasg_decodeToLayout(bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                  EliasOutputLayoutSlices, slices.data(), slicesRowStride, 1);
+        }, [&]() {
+            return slices == expectedSlices;
+        });
+
+        // Morton tiles, the expected order sorts blocks by square row,
+        // square column and then morton index in the square. There must
+        // be exactly one tile for each block.
+
+        const int numBlocks = numBlocksInWidth * numBlocksInHeight;
+        const int squareDim = EliasOutputLayout::mortonSquareDim(numBlocksInWidth, numBlocksInHeight);
+        vector<pair<uint64_t, int>> mortonKeys(numBlocks);
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const int blockX = blocki % numBlocksInWidth;
+            const int blockY = blocki / numBlocksInWidth;
+            mortonKeys[blocki].first = (((uint64_t) (blockY / squareDim)) << 48) | (((uint64_t) (blockX / squareDim)) << 32) |
+                EliasOutputLayout::mortonIndex(blockX % squareDim, blockY % squareDim);
+            mortonKeys[blocki].second = blocki;
+        }
+        sort(mortonKeys.begin(), mortonKeys.end());
+
+        vector<uint8_t> tiles(EliasOutputLayout::numBytes(EliasOutputLayoutMorton, width, height, blockDim, 0));
+        vector<uint8_t> expectedTiles((size_t)numBlocks * blockDim * blockDim);
+        for (int tilei = 0; tilei < numBlocks; tilei++) {
+            const int blocki = mortonKeys[tilei].second;
+            memcpy(&expectedTiles[(size_t)tilei * blockDim * blockDim], &blockPixels[(size_t)blocki * blockDim * blockDim], blockDim * blockDim);
+        }
+        runVariant(newResult("decode.morton", false, numCodeBits), [&]() {
+            Eliasg_decodeToLayout(bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                  EliasOutputLayoutMorton, tiles.data(), 0, 1);
+        }, [&]() {
+            return tiles.size() == expectedTiles.size() && tiles == expectedTiles;
+        });
+    }
+
+    {
+        // CPU emulation of the GPU render passes, the block order symbols
+        // must also match the shader decode loop simulation.
+
+        vector<uint8_t> raster((size_t)width * height);
+        BenchRenderPasses passes;
+        passes.corpus = corpus.name;
+        runVariant(newResult("decode.renderPasses", false, numCodeBits), [&]() {
+            Eliasg_emulateRenderPasses(options.schedule, bitBuff, bitBuffN, offsetsPtr, width, height, blockDim,
+                                       raster.data(), width, passes.passes);
+        }, [&]() {
+            vector<uint8_t> emulated(numSymbols);
+            vector<EliasRenderPassStats> stats;
+            EliasRenderPassEmulator::decode(options.schedule, bitBuff, offsetsPtr, width, height, blockDim,
+                                            raster.data(), width, emulated.data(), stats);
+            Eliasg_decodeBlockSymbols(numSymbols, bitBuff, bitBuffN, decoded.data(), offsetsPtr, blockDim);
+            return raster == corpus.pixels && emulated == decoded;
+        });
+        if (!passes.passes.empty()) {
+            renderPasses.push_back(passes);
+        }
+    }
+}
+
+// Output
+
+static
+void printResults(const BenchOptions & options, const vector<BenchResult> & results)
+{
+    // Name columns are as wide as the longest name
+
+    int corpusWidth = (int) strlen("corpus");
+    int variantWidth = (int) strlen("variant");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        corpusWidth = max(corpusWidth, (int) results[i].corpus.size());
+        variantWidth = max(variantWidth, (int) results[i].variant.size());
+    }
+
+    printf("block dim %d, %d worker threads\n", options.blockDim, EliasWorkerPool::sharedPool().concurrency());
+    printf("%-*s %-*s %11s %9s %9s %10s %10s %7s\n",
+           corpusWidth, "corpus", variantWidth, "variant", "size", "MB/s", "Msym/s", "p50 ms", "p99 ms", "bpp");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult & result = results[i];
+        const double numPixels = result.width * (double) result.height;
+        char sizeStr[32];
+        snprintf(sizeStr, sizeof(sizeStr), "%dx%d", result.width, result.height);
+        printf("%-*s %-*s %11s %9.1f %9.1f %10.3f %10.3f %7.3f\n",
+               corpusWidth, result.corpus.c_str(),
+               variantWidth, result.variant.c_str(),
+               sizeStr,
+               numPixels / result.p50Seconds / 1e6,
+               result.numSymbols / result.p50Seconds / 1e6,
+               result.p50Seconds * 1e3,
+               result.p99Seconds * 1e3,
+               result.numBits / numPixels);
+    }
+}
+
+static
+const char * renderPassKindName(EliasRenderPassKind kind)
+{
+    return (kind == EliasRenderPassDecode) ? "decode" : (kind == EliasRenderPassBlit) ? "blit" : "crop";
+}
+
+static
+void printRenderPasses(const BenchOptions & options, const vector<BenchRenderPasses> & renderPasses)
+{
+    printf("\nrender passes, %d render targets, %s\n", options.schedule.maxRenderTargets,
+           options.schedule.combineSlices ? "combined slices" : "crop reads slices");
+    printf("%-20s %4s %-6s %7s %7s %12s %12s %12s\n",
+           "corpus", "pass", "kind", "symbols", "targets", "tex read", "buf read", "tex written");
+
+    for (size_t i = 0; i < renderPasses.size(); i++) {
+        const vector<EliasRenderPassStats> & passes = renderPasses[i].passes;
+        uint64_t totalRead = 0;
+        uint64_t totalWritten = 0;
+
+        for (size_t passi = 0; passi < passes.size(); passi++) {
+            const EliasRenderPassStats & pass = passes[passi];
+            printf("%-20s %4d %-6s %7d %7d %12llu %12llu %12llu\n",
+                   renderPasses[i].corpus.c_str(),
+                   (int) passi,
+                   renderPassKindName(pass.kind),
+                   pass.numSymbols,
+                   pass.numRenderTargets,
+                   (unsigned long long) pass.textureBytesRead,
+                   (unsigned long long) pass.bufferBytesRead,
+                   (unsigned long long) pass.textureBytesWritten);
+            totalRead += pass.textureBytesRead + pass.bufferBytesRead;
+            totalWritten += pass.textureBytesWritten;
+        }
+
+        printf("%-20s %-4s %-6s %7s %7s %25llu %12llu\n", renderPasses[i].corpus.c_str(), "", "total", "", "",
+               (unsigned long long) totalRead, (unsigned long long) totalWritten);
+    }
+}
+
+static
+bool writeJSON(const BenchOptions & options, const vector<BenchResult> & results, const vector<BenchRenderPasses> & renderPasses)
+{
+    FILE *fp = fopen(options.jsonPath.c_str(), "w");
+    if (fp == NULL) {
+        return false;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"blockDim\": %d,\n", options.blockDim);
+    fprintf(fp, "  \"numThreads\": %d,\n", EliasWorkerPool::sharedPool().concurrency());
+    fprintf(fp, "  \"seed\": %u,\n", options.seed);
+    fprintf(fp, "  \"results\": [\n");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult & result = results[i];
+        const double numPixels = result.width * (double) result.height;
+        fprintf(fp, "    {\"corpus\": \"%s\", \"variant\": \"%s\", \"kind\": \"%s\", "
+                "\"width\": %d, \"height\": %d, \"numSymbols\": %d, \"numBits\": %d, "
+                "\"iterations\": %d, \"mbPerSec\": %.3f, \"symbolsPerSec\": %.0f, "
+                "\"bitsPerPixel\": %.4f, \"p50Ms\": %.4f, \"p99Ms\": %.4f}%s\n",
+                result.corpus.c_str(),
+                result.variant.c_str(),
+                result.isEncode ? "encode" : "decode",
+                result.width,
+                result.height,
+                result.numSymbols,
+                result.numBits,
+                result.numIterations,
+                numPixels / result.p50Seconds / 1e6,
+                result.numSymbols / result.p50Seconds,
+                result.numBits / numPixels,
+                result.p50Seconds * 1e3,
+                result.p99Seconds * 1e3,
+                ((i + 1) < results.size()) ? "," : "");
+    }
+
+    fprintf(fp, "  ],\n");
+    fprintf(fp, "  \"renderPassSchedule\": {\"maxRenderTargets\": %d, \"combineSlices\": %s, \"symbolsPerPass\": [",
+            options.schedule.maxRenderTargets, options.schedule.combineSlices ? "true" : "false");
+    for (size_t passi = 0; passi < options.schedule.symbolsPerPass.size(); passi++) {
+        fprintf(fp, "%s%d", (passi == 0) ? "" : ", ", options.schedule.symbolsPerPass[passi]);
+    }
+    fprintf(fp, "]},\n");
+    fprintf(fp, "  \"renderPasses\": [\n");
+
+    for (size_t i = 0; i < renderPasses.size(); i++) {
+        const vector<EliasRenderPassStats> & passes = renderPasses[i].passes;
+        fprintf(fp, "    {\"corpus\": \"%s\", \"passes\": [\n", renderPasses[i].corpus.c_str());
+        for (size_t passi = 0; passi < passes.size(); passi++) {
+            const EliasRenderPassStats & pass = passes[passi];
+            fprintf(fp, "      {\"kind\": \"%s\", \"numSymbols\": %d, \"numRenderTargets\": %d, "
+                    "\"textureBytesRead\": %llu, \"bufferBytesRead\": %llu, \"textureBytesWritten\": %llu}%s\n",
+                    renderPassKindName(pass.kind),
+                    pass.numSymbols,
+                    pass.numRenderTargets,
+                    (unsigned long long) pass.textureBytesRead,
+                    (unsigned long long) pass.bufferBytesRead,
+                    (unsigned long long) pass.textureBytesWritten,
+                    ((passi + 1) < passes.size()) ? "," : "");
+        }
+        fprintf(fp, "    ]}%s\n", ((i + 1) < renderPasses.size()) ? "," : "");
+    }
+
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    return fclose(fp) == 0;
+}
+
+static
+void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--data DIR] [--json FILE] [--corpus NAME] [--variant NAME]\n"
+                    "          [--block-dim 4|8|16|32] [--min-iterations N] [--max-iterations N]\n"
+                    "          [--budget SECONDS] [--seed N]\n"
+                    "          [--render-targets N] [--render-passes N,N,...] [--combine-slices 0|1]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    options.dataDir = "../Shared";
+    options.blockDim = 8;
+    options.minIterations = 5;
+    options.maxIterations = 1000;
+    options.budgetSeconds = 0.25;
+    options.seed = 1;
+
+    int maxRenderTargets = 4;
+    string symbolsPerPass;
+    bool combineSlices = true;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if ((i + 1) == argc) {
+            usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (arg == "--data") {
+            options.dataDir = value;
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--corpus") {
+            options.corpusFilter = value;
+        } else if (arg == "--variant") {
+            options.variantFilter = value;
+        } else if (arg == "--block-dim") {
+            options.blockDim = atoi(value);
+        } else if (arg == "--min-iterations") {
+            options.minIterations = max(1, atoi(value));
+        } else if (arg == "--max-iterations") {
+            options.maxIterations = atoi(value);
+        } else if (arg == "--budget") {
+            options.budgetSeconds = atof(value);
+        } else if (arg == "--seed") {
+            options.seed = (unsigned int) strtoul(value, NULL, 10);
+        } else if (arg == "--render-targets") {
+            maxRenderTargets = atoi(value);
+        } else if (arg == "--render-passes") {
+            symbolsPerPass = value;
+        } else if (arg == "--combine-slices") {
+            combineSlices = atoi(value) != 0;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (options.blockDim != 4 && options.blockDim != 8 && options.blockDim != 16 && options.blockDim != 32) {
+        usage(argv[0]);
+    }
+
+    // The default schedule has the fewest passes, 12 12 12 12 16 for
+    // 8x8 blocks and 4 render targets like the app.
+
+    if (symbolsPerPass.empty()) {
+        options.schedule = EliasRenderPassSchedule::fewestPasses(options.blockDim * options.blockDim, maxRenderTargets);
+    } else {
+        options.schedule.maxRenderTargets = maxRenderTargets;
+        for (const char *ptr = symbolsPerPass.c_str(); *ptr != '\0'; ptr++) {
+            options.schedule.symbolsPerPass.push_back((int) strtol(ptr, (char **) &ptr, 10));
+            if (*ptr == '\0') {
+                break;
+            }
+        }
+    }
+    options.schedule.combineSlices = combineSlices;
+
+    if (!options.schedule.isValid(options.blockDim * options.blockDim)) {
+        fprintf(stderr, "render passes must decode %d symbols, with multiples of 4 symbols in each pass and at most %d render targets\n",
+                options.blockDim * options.blockDim, maxRenderTargets);
+        return 2;
+    }
+
+    vector<BenchCorpus> corpora;
+    appendIdentCorpora(corpora);
+    corpora.push_back(makeLargeRandomCorpus(options.seed));
+    appendImageCorpora(corpora, options.dataDir);
+
+    vector<BenchResult> results;
+    vector<BenchRenderPasses> renderPasses;
+
+    for (size_t i = 0; i < corpora.size(); i++) {
+        if (matchesFilter(options.corpusFilter, corpora[i].name)) {
+            benchmarkCorpus(options, corpora[i], results, renderPasses);
+        }
+    }
+
+    printResults(options, results);
+    printRenderPasses(options, renderPasses);
+
+    if (!options.jsonPath.empty() && !writeJSON(options, results, renderPasses)) {
+        fprintf(stderr, "could not write %s\n", options.jsonPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
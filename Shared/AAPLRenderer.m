@@ -406,6 +406,25 @@ const static unsigned int blockDim = HUFF_BLOCK_DIM;
   
   int outBlockOrderSymbolsNumBytes = (blockDim * blockDim) * (blockWidth * blockHeight);
   
+#if !defined(IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING)
+  // Split into blocks, calculate zerod deltas and encode in a single
+  // pass over the image without creating intermediate block buffers.
+  
+  [Eliasg encodeImageBlocks:(const uint8_t*)_imageInputBytes.bytes
+                      width:width
+                     height:height
+                   blockDim:blockDim
+           numBlocksInWidth:blockWidth
+          numBlocksInHeight:blockHeight
+                   outCodes:outCodes
+         outBlockBitOffsets:outBlockBitOffsets
+             outBlockDeltas:nil];
+#endif // IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING
+  
+  // The block order symbols are only needed by the DEBUG decode
+  // checks and the block init encoding.
+
+#if defined(DEBUG) || defined(IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING)
   // Generate input that is zero padded out to the number of blocks needed
   NSMutableData *outBlockOrderSymbolsData = [NSMutableData dataWithLength:outBlockOrderSymbolsNumBytes];
   uint8_t *outBlockOrderSymbolsPtr = (uint8_t *) outBlockOrderSymbolsData.bytes;
@@ -446,7 +465,9 @@ const static unsigned int blockDim = HUFF_BLOCK_DIM;
     
     printf("block order done\n");
   }
+#endif // DEBUG || IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING
   
+#if defined(IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING)
   if ((1)) @autoreleasepool {
     // byte deltas
     
@@ -592,23 +613,78 @@ const static unsigned int blockDim = HUFF_BLOCK_DIM;
   
   assert((outBlockOrderSymbolsNumBytes % (blockDim * blockDim)) == 0);
   
-  [Eliasg encodeBits:outBlockOrderSymbolsPtr
-          inNumBytes:outBlockOrderSymbolsNumBytes
-            outCodes:outCodes
-  outBlockBitOffsets:outBlockBitOffsets
-               width:blockWidth*blockDim
-              height:blockHeight*blockDim
-            blockDim:blockDim];
+  BOOL worked = [Eliasg encodeBits:outBlockOrderSymbolsPtr
+                        inNumBytes:outBlockOrderSymbolsNumBytes
+                          outCodes:outCodes
+                outBlockBitOffsets:outBlockBitOffsets
+                             width:blockWidth*blockDim
+                            height:blockHeight*blockDim
+                          blockDim:blockDim];
+  
+  if (!worked) {
+    NSLog(@"encodeBits failed, codes do not fit in 2^32 bits");
+  }
+  assert(worked);
+#endif // IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING
   
   if ((1)) {
     printf("inNumBytes   %8d\n", outBlockOrderSymbolsNumBytes);
     printf("outNumBytes  %8d\n", (int)outCodes.length);
   }
+  
+  if ((0)) {
+    NSMutableData *blockDeltas = [NSMutableData data];
     
+    [Eliasg encodeImageBlocks:(const uint8_t*)_imageInputBytes.bytes
+                        width:width
+                       height:height
+                     blockDim:blockDim
+             numBlocksInWidth:blockWidth
+            numBlocksInHeight:blockHeight
+                     outCodes:[NSMutableData data]
+           outBlockBitOffsets:[NSMutableData data]
+               outBlockDeltas:blockDeltas];
+    
+    [Eliasg benchmarkInterleaved:(const uint8_t*)blockDeltas.bytes
+                      numSymbols:outBlockOrderSymbolsNumBytes
+               numSymbolsInChunk:blockDim*blockDim];
+  }
+    
+  if ((0)) {
+    // Pan a viewport across the image, select TEST_IMAGE2 to
+    // benchmark with ImageHuge.png.
+    
+    [Eliasg benchmarkRegion:(uint8_t*)outCodes.bytes
+                   bitBuffN:(int)outCodes.length
+    blockStartBitOffsetsPtr:(uint32_t*)outBlockBitOffsets.bytes
+                 imageWidth:width
+                imageHeight:height
+                   blockDim:blockDim
+                  viewWidth:512
+                 viewHeight:384];
+  }
+  
+  if ((0)) {
+    // Parallel decode scaling from 1 to N cores, select TEST_IMAGE2 to
+    // benchmark with ImageHuge.png.
+    
+    [Eliasg benchmarkParallel:(uint8_t*)outCodes.bytes
+                     bitBuffN:(int)outCodes.length
+      blockStartBitOffsetsPtr:(uint32_t*)outBlockBitOffsets.bytes
+           numSymbolsToDecode:outBlockOrderSymbolsNumBytes
+                     blockDim:blockDim];
+  }
+  
   if ((0)) {
         NSString *tmpDir = NSTemporaryDirectory();
-        NSString *path = [tmpDir stringByAppendingPathComponent:@"block_encoded_elias.bytes"];
-        [outCodes writeToFile:path atomically:TRUE];
+        NSString *path = [tmpDir stringByAppendingPathComponent:@"block_encoded_elias.elgc"];
+        BOOL worked = [Eliasg writeContainerFile:path
+                                           codes:outCodes
+                                 blockBitOffsets:outBlockBitOffsets
+                                           width:width
+                                          height:height
+                                        blockDim:blockDim];
+        assert(worked);
         NSLog(@"wrote %@", path);
   }
   
@@ -674,7 +750,8 @@ const static unsigned int blockDim = HUFF_BLOCK_DIM;
                            bitBuff:(uint8_t*)outCodes.bytes
                           bitBuffN:(int)outCodes.length
                          outBuffer:decodedSymbols
-           blockStartBitOffsetsPtr:blockOutPtr];
+           blockStartBitOffsetsPtr:blockOutPtr
+                          blockDim:blockDim];
 
         uint8_t *originalBlockOrderSymbolsPtr = (uint8_t *) blockOrderSymbolsCopy.bytes;
         
@@ -691,6 +768,789 @@ const static unsigned int blockDim = HUFF_BLOCK_DIM;
             }
         }
         
+        // Optimized CPU decoder must generate the same output
+        
+        memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+        
+        [Eliasg decodeBlockSymbolsOpt64:outBlockOrderSymbolsNumBytes
+                                bitBuff:(uint8_t*)outCodes.bytes
+                               bitBuffN:(int)outCodes.length
+                              outBuffer:decodedSymbols
+                blockStartBitOffsetsPtr:blockOutPtr
+                               blockDim:blockDim];
+        
+        {
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+        }
+        
+        memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+        
+        [Eliasg decodeBlockSymbolsTable:outBlockOrderSymbolsNumBytes
+                                bitBuff:(uint8_t*)outCodes.bytes
+                               bitBuffN:(int)outCodes.length
+                              outBuffer:decodedSymbols
+                blockStartBitOffsetsPtr:blockOutPtr
+                               blockDim:blockDim];
+
+        {
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+        }
+
+        // A block dim without a decoder specialization must fail
+
+        {
+            BOOL worked = [Eliasg decodeBlockSymbolsTable:outBlockOrderSymbolsNumBytes
+                                                  bitBuff:(uint8_t*)outCodes.bytes
+                                                 bitBuffN:(int)outCodes.length
+                                                outBuffer:decodedSymbols
+                                  blockStartBitOffsetsPtr:blockOutPtr
+                                                 blockDim:blockDim + 1];
+            assert(!worked);
+        }
+
+        memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+
+        [Eliasg decodeBlockSymbolsParallel:outBlockOrderSymbolsNumBytes
+                                   bitBuff:(uint8_t*)outCodes.bytes
+                                  bitBuffN:(int)outCodes.length
+                                 outBuffer:decodedSymbols
+                   blockStartBitOffsetsPtr:blockOutPtr
+                                numThreads:0
+                                  blockDim:blockDim];
+        
+        {
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+        }
+        
+        memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+        
+        [Eliasg decodeBlockSymbolsSIMD:outBlockOrderSymbolsNumBytes
+                               bitBuff:(uint8_t*)outCodes.bytes
+                              bitBuffN:(int)outCodes.length
+                             outBuffer:decodedSymbols
+               blockStartBitOffsetsPtr:blockOutPtr
+                              blockDim:blockDim];
+        
+        {
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+        }
+        
+        // Two level block index must expand to the flat offset table
+        // and decode to the same output.
+        
+        NSData *blockIndexData = [Eliasg encodeBlockIndex:blockOutPtr numBlocks:numBlocks blockDim:blockDim];
+        assert(blockIndexData != nil);
+        
+        {
+            NSMutableData *expandedData = [NSMutableData dataWithLength:numBlocks * sizeof(uint32_t)];
+            BOOL worked = [Eliasg expandBlockIndex:blockIndexData
+                           blockStartBitOffsetsPtr:(uint32_t*)expandedData.mutableBytes];
+            assert(worked);
+            int cmp = memcmp(expandedData.bytes, blockOutPtr, numBlocks * sizeof(uint32_t));
+            assert(cmp == 0);
+        }
+
+        // A corrupt block count or anchor shift must be rejected
+
+        {
+            NSMutableData *expandedData = [NSMutableData dataWithLength:numBlocks * sizeof(uint32_t)];
+            NSMutableData *corruptData = [NSMutableData dataWithData:blockIndexData];
+            uint8_t *corruptPtr = (uint8_t *) corruptData.mutableBytes;
+            memset(corruptPtr, 0xFF, 4);
+            BOOL worked = [Eliasg expandBlockIndex:corruptData
+                           blockStartBitOffsetsPtr:(uint32_t*)expandedData.mutableBytes];
+            assert(!worked);
+
+            memcpy(corruptPtr, blockIndexData.bytes, 4);
+            corruptPtr[4] = 16;
+            worked = [Eliasg expandBlockIndex:corruptData
+                      blockStartBitOffsetsPtr:(uint32_t*)expandedData.mutableBytes];
+            assert(!worked);
+        }
+
+        memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+        
+        {
+            BOOL worked = [Eliasg decodeBlockSymbolsIndexed:outBlockOrderSymbolsNumBytes
+                                                    bitBuff:(uint8_t*)outCodes.bytes
+                                                   bitBuffN:(int)outCodes.length
+                                                  outBuffer:decodedSymbols
+                                                 blockIndex:blockIndexData];
+            assert(worked);
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+        }
+
+        // A symbol count that is not whole blocks or has more blocks
+        // than the index must be rejected before any block is decoded
+
+        {
+            BOOL worked = [Eliasg decodeBlockSymbolsIndexed:outBlockOrderSymbolsNumBytes - 1
+                                                    bitBuff:(uint8_t*)outCodes.bytes
+                                                   bitBuffN:(int)outCodes.length
+                                                  outBuffer:decodedSymbols
+                                                 blockIndex:blockIndexData];
+            assert(!worked);
+
+            worked = [Eliasg decodeBlockSymbolsIndexed:outBlockOrderSymbolsNumBytes + (blockDim * blockDim)
+                                               bitBuff:(uint8_t*)outCodes.bytes
+                                              bitBuffN:(int)outCodes.length
+                                             outBuffer:decodedSymbols
+                                            blockIndex:blockIndexData];
+            assert(!worked);
+        }
+        
+        if ((1)) {
+            printf("offsetsNumBytes %8d\n", (int)(numBlocks * sizeof(uint32_t)));
+            printf("indexNumBytes   %8d\n", (int)blockIndexData.length);
+        }
+        
+        // Adaptive Exp-Golomb order encoding of the same block deltas
+        
+        {
+            NSMutableData *blockDeltas = [NSMutableData data];
+            
+            [Eliasg encodeImageBlocks:(const uint8_t*)_imageInputBytes.bytes
+                                width:width
+                               height:height
+                             blockDim:blockDim
+                     numBlocksInWidth:blockWidth
+                    numBlocksInHeight:blockHeight
+                             outCodes:[NSMutableData data]
+                   outBlockBitOffsets:[NSMutableData data]
+                       outBlockDeltas:blockDeltas];
+            
+            NSMutableData *expGolombCodes = [NSMutableData data];
+            NSMutableData *expGolombBlockBitOffsets = [NSMutableData data];
+            
+            [Eliasg encodeBitsExpGolomb:(uint8_t*)blockDeltas.bytes
+                             inNumBytes:outBlockOrderSymbolsNumBytes
+                               outCodes:expGolombCodes
+                     outBlockBitOffsets:expGolombBlockBitOffsets
+                               blockDim:blockDim];
+            
+            memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+            
+            [Eliasg decodeBlockSymbolsExpGolomb:outBlockOrderSymbolsNumBytes
+                                        bitBuff:(uint8_t*)expGolombCodes.bytes
+                                       bitBuffN:(int)expGolombCodes.length
+                                      outBuffer:decodedSymbols
+                        blockStartBitOffsetsPtr:(uint32_t*)expGolombBlockBitOffsets.bytes
+                                       blockDim:blockDim];
+            
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+            
+            if ((1)) {
+                printf("expGolombNumBytes %8d\n", (int)expGolombCodes.length);
+            }
+        }
+        
+        // Constant block and zero run encoding of the same block deltas
+        
+        {
+            NSMutableData *blockDeltas = [NSMutableData data];
+            
+            [Eliasg encodeImageBlocks:(const uint8_t*)_imageInputBytes.bytes
+                                width:width
+                               height:height
+                             blockDim:blockDim
+                     numBlocksInWidth:blockWidth
+                    numBlocksInHeight:blockHeight
+                             outCodes:[NSMutableData data]
+                   outBlockBitOffsets:[NSMutableData data]
+                       outBlockDeltas:blockDeltas];
+            
+            NSMutableData *runsCodes = [NSMutableData data];
+            NSMutableData *runsBlockBitOffsets = [NSMutableData data];
+            
+            [Eliasg encodeBitsRuns:(uint8_t*)blockDeltas.bytes
+                        inNumBytes:outBlockOrderSymbolsNumBytes
+                          outCodes:runsCodes
+                outBlockBitOffsets:runsBlockBitOffsets
+                          blockDim:blockDim];
+            
+            memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+            
+            [Eliasg decodeBlockSymbolsRuns:outBlockOrderSymbolsNumBytes
+                                   bitBuff:(uint8_t*)runsCodes.bytes
+                                  bitBuffN:(int)runsCodes.length
+                                 outBuffer:decodedSymbols
+                   blockStartBitOffsetsPtr:(uint32_t*)runsBlockBitOffsets.bytes
+                                  blockDim:blockDim];
+            
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+            
+            if ((1)) {
+                printf("runsNumBytes %8d\n", (int)runsCodes.length);
+            }
+            
+            // Hybrid blocks pick gamma, literal or constant for each block
+            
+            NSMutableData *hybridCodes = [NSMutableData data];
+            NSMutableData *hybridBlockEntries = [NSMutableData data];
+            
+            BOOL worked = [Eliasg encodeBitsHybrid:(uint8_t*)blockDeltas.bytes
+                                        inNumBytes:outBlockOrderSymbolsNumBytes
+                                          outCodes:hybridCodes
+                                   outBlockEntries:hybridBlockEntries
+                                          blockDim:blockDim];
+            assert(worked);
+            
+            // Never more than 8 bits for each pixel plus 7 bits for each block
+            assert(hybridCodes.length <= (outBlockOrderSymbolsNumBytes + (hybridBlockEntries.length / sizeof(uint32_t)) + 2));
+            
+            memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+            
+            [Eliasg decodeBlockSymbolsHybrid:outBlockOrderSymbolsNumBytes
+                                     bitBuff:(uint8_t*)hybridCodes.bytes
+                                    bitBuffN:(int)hybridCodes.length
+                                   outBuffer:decodedSymbols
+                             blockEntriesPtr:(uint32_t*)hybridBlockEntries.bytes
+                                    blockDim:blockDim];
+            
+            cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+            
+            if ((1)) {
+                printf("hybridNumBytes %8d\n", (int)hybridCodes.length);
+            }
+            
+            // Per block predictor and scan order, the input is pixels in block order
+            
+            NSMutableData *predictedCodes = [NSMutableData data];
+            NSMutableData *predictedBlockBitOffsets = [NSMutableData data];
+            
+            [Eliasg encodeBitsPredicted:(uint8_t*)originalBlockOrderSymbolsPtr
+                             inNumBytes:outBlockOrderSymbolsNumBytes
+                               outCodes:predictedCodes
+                     outBlockBitOffsets:predictedBlockBitOffsets
+                               blockDim:blockDim];
+            
+            memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+            
+            [Eliasg decodeBlockSymbolsPredicted:outBlockOrderSymbolsNumBytes
+                                        bitBuff:(uint8_t*)predictedCodes.bytes
+                                       bitBuffN:(int)predictedCodes.length
+                                      outBuffer:decodedSymbols
+                        blockStartBitOffsetsPtr:(uint32_t*)predictedBlockBitOffsets.bytes
+                                       blockDim:blockDim];
+            
+            cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+            
+            if ((1)) {
+                printf("predictedNumBytes %8d\n", (int)predictedCodes.length);
+            }
+        }
+        
+        // Region decode must match a crop of the input image
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            
+            int regions[][4] = {
+                { 0, 0, width, height },
+                { 0, 0, 1, 1 },
+                { width - 1, height - 1, 1, 1 },
+                { width / 3, height / 5, width / 2, height / 3 },
+                { 3, 5, min(width - 3, 37), min(height - 5, 19) },
+            };
+            
+            for ( int regioni = 0; regioni < (int)(sizeof(regions) / sizeof(regions[0])); regioni++ ) {
+                int *region = regions[regioni];
+                const int outRowStride = region[2] + 3;
+                NSMutableData *regionPixels = [NSMutableData dataWithLength:outRowStride * region[3]];
+                uint8_t *regionPtr = (uint8_t *) regionPixels.mutableBytes;
+                
+                BOOL worked = [Eliasg decodeRegionX:region[0]
+                                                  y:region[1]
+                                              width:region[2]
+                                             height:region[3]
+                                            bitBuff:(uint8_t*)outCodes.bytes
+                                           bitBuffN:(int)outCodes.length
+                            blockStartBitOffsetsPtr:blockOutPtr
+                                         imageWidth:width
+                                        imageHeight:height
+                                           blockDim:blockDim
+                                          outBuffer:regionPtr
+                                       outRowStride:outRowStride];
+                assert(worked);
+                
+                for ( int row = 0; row < region[3]; row++ ) {
+                    const uint8_t *imageRowPtr = imageBytesPtr + ((region[1] + row) * width) + region[0];
+                    int cmp = memcmp(regionPtr + (row * outRowStride), imageRowPtr, region[2]);
+                    assert(cmp == 0);
+                }
+            }
+        }
+        
+        // Decode to output layouts must match the image and the block order symbols
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            const int numSymbolsInBlock = blockDim * blockDim;
+            
+            {
+                const int outRowStride = width + 5;
+                NSMutableData *rasterPixels = [NSMutableData dataWithLength:outRowStride * height];
+                uint8_t *rasterPtr = (uint8_t *) rasterPixels.mutableBytes;
+                
+                BOOL worked = [Eliasg decodeToLayout:0
+                                             bitBuff:(uint8_t*)outCodes.bytes
+                                            bitBuffN:(int)outCodes.length
+                             blockStartBitOffsetsPtr:blockOutPtr
+                                          imageWidth:width
+                                         imageHeight:height
+                                            blockDim:blockDim
+                                              outPtr:rasterPtr
+                                        outRowStride:outRowStride
+                                          numThreads:0];
+                assert(worked);
+                
+                for ( int row = 0; row < height; row++ ) {
+                    int cmp = memcmp(rasterPtr + (row * outRowStride), imageBytesPtr + (row * width), width);
+                    assert(cmp == 0);
+                }
+            }
+            
+            {
+                // 8 slices in each row of the combined slices texture
+                const int numSlices = numSymbolsInBlock / 4;
+                const int numSliceRows = (numSlices + 7) / 8;
+                const int outRowStride = blockWidth * 8 * 4;
+                NSMutableData *slicePixels = [NSMutableData dataWithLength:outRowStride * blockHeight * numSliceRows];
+                uint8_t *slicePtr = (uint8_t *) slicePixels.mutableBytes;
+                
+                BOOL worked = [Eliasg decodeToLayout:1
+                                             bitBuff:(uint8_t*)outCodes.bytes
+                                            bitBuffN:(int)outCodes.length
+                             blockStartBitOffsetsPtr:blockOutPtr
+                                          imageWidth:width
+                                         imageHeight:height
+                                            blockDim:blockDim
+                                              outPtr:slicePtr
+                                        outRowStride:outRowStride
+                                          numThreads:0];
+                assert(worked);
+                
+                for ( int blocki = 0; blocki < (blockWidth * blockHeight); blocki++ ) {
+                    const int blockX = blocki % blockWidth;
+                    const int blockY = blocki / blockWidth;
+                    for ( int slice = 0; slice < numSlices; slice++ ) {
+                        const int x = ((slice % 8) * blockWidth) + blockX;
+                        const int y = ((slice / 8) * blockHeight) + blockY;
+                        int cmp = memcmp(slicePtr + (y * outRowStride) + (x * 4), originalBlockOrderSymbolsPtr + (blocki * numSymbolsInBlock) + (slice * 4), 4);
+                        assert(cmp == 0);
+                    }
+                }
+            }
+            
+            {
+                // One tile for each block, squares of blocks with a power
+                // of 2 size are in raster order and the tiles of a square
+                // are in morton order
+                int squareDim = 1;
+                while ((squareDim * 2) <= MIN(blockWidth, blockHeight)) {
+                    squareDim *= 2;
+                }
+                NSMutableData *tilePixels = [NSMutableData dataWithLength:(blockWidth * blockHeight) * numSymbolsInBlock];
+                uint8_t *tilePtr = (uint8_t *) tilePixels.mutableBytes;
+                
+                BOOL worked = [Eliasg decodeToLayout:2
+                                             bitBuff:(uint8_t*)outCodes.bytes
+                                            bitBuffN:(int)outCodes.length
+                             blockStartBitOffsetsPtr:blockOutPtr
+                                          imageWidth:width
+                                         imageHeight:height
+                                            blockDim:blockDim
+                                              outPtr:tilePtr
+                                        outRowStride:0
+                                          numThreads:0];
+                assert(worked);
+                
+                int tilei = 0;
+                for ( int squareY = 0; squareY < blockHeight; squareY += squareDim ) {
+                    for ( int squareX = 0; squareX < blockWidth; squareX += squareDim ) {
+                        for ( int m = 0; m < (squareDim * squareDim); m++ ) {
+                            int blockX = squareX;
+                            int blockY = squareY;
+                            for ( int bit = 0; bit < 16; bit++ ) {
+                                blockX += ((m >> (2 * bit)) & 0x1) << bit;
+                                blockY += ((m >> ((2 * bit) + 1)) & 0x1) << bit;
+                            }
+                            if (blockX >= blockWidth || blockY >= blockHeight) {
+                                continue;
+                            }
+                            const int blocki = (blockY * blockWidth) + blockX;
+                            int cmp = memcmp(tilePtr + (tilei * numSymbolsInBlock), originalBlockOrderSymbolsPtr + (blocki * numSymbolsInBlock), numSymbolsInBlock);
+                            assert(cmp == 0);
+                            tilei += 1;
+                        }
+                    }
+                }
+                assert(tilei == (blockWidth * blockHeight));
+            }
+        }
+        
+        // Container file written to disk must decode from the mapping
+        
+        {
+            NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"check_encoded_elias.elgc"];
+            
+            BOOL worked = [Eliasg writeContainerFile:path
+                                               codes:outCodes
+                                     blockBitOffsets:outBlockBitOffsets
+                                               width:width
+                                              height:height
+                                            blockDim:blockDim];
+            assert(worked);
+            
+            memset(decodedSymbols, 0, outBlockOrderSymbolsNumBytes);
+            
+            worked = [Eliasg decodeContainerFile:path
+                                       outBuffer:decodedSymbols
+                               outBufferNumBytes:outBlockOrderSymbolsNumBytes];
+            assert(worked);
+            
+            int cmp = memcmp(originalBlockOrderSymbolsPtr, decodedSymbols, outBlockOrderSymbolsNumBytes);
+            assert(cmp == 0);
+
+            // An unknown bit order or a block offset past the end of the
+            // bitstream must be rejected
+
+            NSData *fileData = [NSData dataWithContentsOfFile:path];
+
+            NSMutableData *corruptData = [NSMutableData dataWithData:fileData];
+            ((uint8_t *) corruptData.mutableBytes)[17] = 2;
+            [corruptData writeToFile:path atomically:TRUE];
+            worked = [Eliasg decodeContainerFile:path
+                                       outBuffer:decodedSymbols
+                               outBufferNumBytes:outBlockOrderSymbolsNumBytes];
+            assert(!worked);
+
+            corruptData = [NSMutableData dataWithData:fileData];
+            memset(((uint8_t *) corruptData.mutableBytes) + 64, 0xFF, 4);
+            [corruptData writeToFile:path atomically:TRUE];
+            worked = [Eliasg decodeContainerFile:path
+                                       outBuffer:decodedSymbols
+                               outBufferNumBytes:outBlockOrderSymbolsNumBytes];
+            assert(!worked);
+
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        }
+
+        // Sequence of frames with a changed area, a repeated frame and a
+        // small change to every pixel must decode to the original frames
+        
+        {
+            NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"check_encoded_elias.elgs"];
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            const int numPixels = width * height;
+            
+            NSMutableData *changedFrame = [NSMutableData dataWithBytes:imageBytesPtr length:numPixels];
+            uint8_t *changedPtr = (uint8_t *) changedFrame.mutableBytes;
+            for ( int y = 0; y < MIN(height, 40); y++ ) {
+                for ( int x = 0; x < MIN(width, 40); x++ ) {
+                    changedPtr[(y * width) + x] = ~changedPtr[(y * width) + x];
+                }
+            }
+            
+            NSMutableData *brighterFrame = [NSMutableData dataWithBytes:imageBytesPtr length:numPixels];
+            uint8_t *brighterPtr = (uint8_t *) brighterFrame.mutableBytes;
+            for ( int i = 0; i < numPixels; i++ ) {
+                brighterPtr[i] += 1;
+            }
+            
+            NSArray *frames = @[_imageInputBytes, changedFrame, changedFrame, brighterFrame];
+            
+            BOOL worked = [Eliasg encodeSequenceFile:path
+                                              frames:frames
+                                               width:width
+                                              height:height
+                                            blockDim:blockDim];
+            assert(worked);
+            
+            __block int numFramesDecoded = 0;
+            
+            worked = [Eliasg decodeSequenceFile:path
+                                      frameSink:^(int frameIndex, const uint8_t *blockPixels, int numSymbols) {
+                                          const uint8_t *framePtr = (const uint8_t *) ((NSData *) frames[frameIndex]).bytes;
+                                          assert(numSymbols == (numBlocks * blockDim * blockDim));
+                                          
+                                          for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+                                              const int x = (blocki % blockWidth) * blockDim;
+                                              const int y = (blocki / blockWidth) * blockDim;
+                                              for ( int i = 0; i < (blockDim * blockDim); i++ ) {
+                                                  const int col = x + (i % blockDim);
+                                                  const int row = y + (i / blockDim);
+                                                  uint8_t expected = (col < width && row < height) ? framePtr[(row * width) + col] : 0;
+                                                  assert(blockPixels[(blocki * blockDim * blockDim) + i] == expected);
+                                              }
+                                          }
+                                          
+                                          numFramesDecoded += 1;
+                                      }];
+            assert(worked);
+            assert(numFramesDecoded == (int) frames.count);
+            
+            if ((0)) {
+                NSDictionary *attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+                printf("sequence of %d frames : %d bytes\n", (int) frames.count, (int) [attrs fileSize]);
+            }
+
+            // An unknown bit order or a group offset of the first frame
+            // past the end of its bitstream must be rejected
+
+            NSData *fileData = [NSData dataWithContentsOfFile:path];
+
+            NSMutableData *corruptData = [NSMutableData dataWithData:fileData];
+            ((uint8_t *) corruptData.mutableBytes)[17] = 2;
+            [corruptData writeToFile:path atomically:TRUE];
+            worked = [Eliasg decodeSequenceFile:path
+                                      frameSink:^(int frameIndex, const uint8_t *blockPixels, int numSymbols) {
+                                          assert(0);
+                                      }];
+            assert(!worked);
+
+            corruptData = [NSMutableData dataWithData:fileData];
+            memset(((uint8_t *) corruptData.mutableBytes) + 64, 0xFF, 4);
+            [corruptData writeToFile:path atomically:TRUE];
+            worked = [Eliasg decodeSequenceFile:path
+                                      frameSink:^(int frameIndex, const uint8_t *blockPixels, int numSymbols) {
+                                          assert(0);
+                                      }];
+            assert(!worked);
+
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        }
+        
+        // 12 bit depth map with a full range 16 bit area must decode
+        // to the same block order 16 bit symbols
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            const int numPixels = width * height;
+            
+            NSMutableData *depthData = [NSMutableData dataWithLength:numPixels * sizeof(uint16_t)];
+            uint16_t *depthPtr = (uint16_t *) depthData.mutableBytes;
+            
+            for ( int y = 0; y < height; y++ ) {
+                for ( int x = 0; x < width; x++ ) {
+                    uint16_t depth = (uint16_t) ((imageBytesPtr[(y * width) + x] << 4) | (x & 0xF));
+                    if (x < 16 && y < 16) {
+                        depth = (uint16_t) (((x + y) & 0x1) ? 0xFFFF : 0);
+                    }
+                    depthPtr[(y * width) + x] = depth;
+                }
+            }
+            
+            NSMutableData *codes16 = [NSMutableData data];
+            NSMutableData *blockBitOffsets16 = [NSMutableData data];
+            
+            [Eliasg encodeImageBlocks16:depthPtr
+                                  width:width
+                                 height:height
+                               blockDim:blockDim
+                               outCodes:codes16
+                     outBlockBitOffsets:blockBitOffsets16];
+            
+            NSMutableData *decoded16 = [NSMutableData dataWithLength:outBlockOrderSymbolsNumBytes * sizeof(uint16_t)];
+            uint16_t *decoded16Ptr = (uint16_t *) decoded16.mutableBytes;
+            
+            [Eliasg decodeBlockSymbols16:outBlockOrderSymbolsNumBytes
+                                 bitBuff:(uint8_t*)codes16.bytes
+                                bitBuffN:(int)codes16.length
+                               outBuffer:decoded16Ptr
+                 blockStartBitOffsetsPtr:(uint32_t*)blockBitOffsets16.bytes
+                                blockDim:blockDim];
+            
+            for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+                const int x = (blocki % blockWidth) * blockDim;
+                const int y = (blocki / blockWidth) * blockDim;
+                for ( int i = 0; i < (blockDim * blockDim); i++ ) {
+                    const int col = x + (i % blockDim);
+                    const int row = y + (i / blockDim);
+                    uint16_t expected = (col < width && row < height) ? depthPtr[(row * width) + col] : 0;
+                    assert(decoded16Ptr[(blocki * blockDim * blockDim) + i] == expected);
+                }
+            }
+            
+            if ((0)) {
+                printf("16 bit depth : %d bytes\n", (int) codes16.length);
+            }
+        }
+        
+        // CPU emulation of the render passes must crop to the input image
+        // with the 4 render target schedule and with 8 render targets
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            NSMutableData *emulatedPixels = [NSMutableData dataWithLength:width * height];
+            
+            for ( int numRenderTargets = 4; numRenderTargets <= 8; numRenderTargets += 4 ) {
+                NSMutableArray *passStats = [NSMutableArray array];
+                
+                BOOL worked = [Eliasg emulateRenderPasses:(uint8_t*)outCodes.bytes
+                                                 bitBuffN:(int)outCodes.length
+                                  blockStartBitOffsetsPtr:blockOutPtr
+                                                    width:width
+                                                   height:height
+                                                 blockDim:blockDim
+                                         numRenderTargets:numRenderTargets
+                                            combineSlices:TRUE
+                                                outPixels:(uint8_t*)emulatedPixels.mutableBytes
+                                             outRowStride:width
+                                             outPassStats:passStats];
+                assert(worked);
+                
+                int cmp = memcmp(imageBytesPtr, emulatedPixels.bytes, width * height);
+                assert(cmp == 0);
+                
+                if ((0)) {
+                    for ( NSDictionary *stats in passStats ) {
+                        printf("render targets %d : pass %s\n", numRenderTargets, [[stats description] UTF8String]);
+                    }
+                }
+            }
+        }
+        
+        // Planar BGRA and RGB encoding with and without the YCoCg-R
+        // transform must decode to the original interleaved pixels
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            
+            for ( int numChannels = 3; numChannels <= 4; numChannels++ ) {
+                const int rowStride = width * numChannels;
+                NSMutableData *colorPixels = [NSMutableData dataWithLength:rowStride * height];
+                uint8_t *colorPtr = (uint8_t *) colorPixels.mutableBytes;
+                
+                for ( int y = 0; y < height; y++ ) {
+                    for ( int x = 0; x < width; x++ ) {
+                        uint8_t gray = imageBytesPtr[(y * width) + x];
+                        uint8_t *pixelPtr = colorPtr + (y * rowStride) + (x * numChannels);
+                        pixelPtr[0] = gray;
+                        pixelPtr[1] = gray + x;
+                        pixelPtr[2] = gray ^ y;
+                        if (numChannels == 4) {
+                            pixelPtr[3] = (x < (width / 2)) ? 0xFF : gray;
+                        }
+                    }
+                }
+                
+                for ( int ycocg = 0; ycocg <= 1; ycocg++ ) {
+                    NSMutableArray *planeCodes = [NSMutableArray array];
+                    NSMutableArray *planeBlockBitOffsets = [NSMutableArray array];
+                    
+                    [Eliasg encodePlanes:colorPtr
+                                   width:width
+                                  height:height
+                             numChannels:numChannels
+                                   ycocg:ycocg
+                                blockDim:blockDim
+                           outPlaneCodes:planeCodes
+                 outPlaneBlockBitOffsets:planeBlockBitOffsets];
+                    
+                    NSMutableData *decodedPixels = [NSMutableData dataWithLength:rowStride * height];
+                    
+                    BOOL worked = [Eliasg decodePlanes:planeCodes
+                                  planeBlockBitOffsets:planeBlockBitOffsets
+                                                 width:width
+                                                height:height
+                                           numChannels:numChannels
+                                                 ycocg:ycocg
+                                              blockDim:blockDim
+                                             outPixels:(uint8_t*)decodedPixels.mutableBytes
+                                          outRowStride:rowStride];
+                    assert(worked);
+                    
+                    int cmp = memcmp(colorPtr, decodedPixels.bytes, rowStride * height);
+                    assert(cmp == 0);
+                    
+                    // A short row stride, a channel count that does not match
+                    // the planes or truncated block offsets must be rejected
+                    
+                    worked = [Eliasg decodePlanes:planeCodes
+                             planeBlockBitOffsets:planeBlockBitOffsets
+                                            width:width
+                                           height:height
+                                      numChannels:numChannels
+                                            ycocg:ycocg
+                                         blockDim:blockDim
+                                        outPixels:(uint8_t*)decodedPixels.mutableBytes
+                                     outRowStride:rowStride - 1];
+                    assert(!worked);
+                    
+                    worked = [Eliasg decodePlanes:planeCodes
+                             planeBlockBitOffsets:planeBlockBitOffsets
+                                            width:width
+                                           height:height
+                                      numChannels:(numChannels == 4) ? 3 : 4
+                                            ycocg:ycocg
+                                         blockDim:blockDim
+                                        outPixels:(uint8_t*)decodedPixels.mutableBytes
+                                     outRowStride:rowStride];
+                    assert(!worked);
+                    
+                    NSMutableArray *truncatedOffsets = [NSMutableArray arrayWithArray:planeBlockBitOffsets];
+                    truncatedOffsets[0] = [planeBlockBitOffsets[0] subdataWithRange:NSMakeRange(0, [planeBlockBitOffsets[0] length] - sizeof(uint32_t))];
+                    
+                    worked = [Eliasg decodePlanes:planeCodes
+                             planeBlockBitOffsets:truncatedOffsets
+                                            width:width
+                                           height:height
+                                      numChannels:numChannels
+                                            ycocg:ycocg
+                                         blockDim:blockDim
+                                        outPixels:(uint8_t*)decodedPixels.mutableBytes
+                                     outRowStride:rowStride];
+                    assert(!worked);
+                    
+                    if ((0)) {
+                        int numBytes = 0;
+                        for ( NSData *codes in planeCodes ) {
+                            numBytes += (int) codes.length;
+                        }
+                        printf("planes %d ycocg %d : %d bytes\n", numChannels, ycocg, numBytes);
+                    }
+                }
+            }
+        }
+        
+        // Strip streaming encode must generate the same codes and offsets
+        
+        {
+            const uint8_t *imageBytesPtr = (const uint8_t *) _imageInputBytes.bytes;
+            const int imageWidth = width;
+            
+            NSMutableData *stripCodes = [NSMutableData data];
+            NSMutableData *stripBlockBitOffsets = [NSMutableData data];
+            
+            BOOL worked = [Eliasg encodeImageStrips:width
+                                             height:height
+                                           blockDim:blockDim
+                                          rowSource:^BOOL(int y, uint8_t *rowPtr) {
+                                              memcpy(rowPtr, imageBytesPtr + (y * imageWidth), imageWidth);
+                                              return TRUE;
+                                          }
+                                               sink:^(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks) {
+                                                   [stripCodes appendBytes:codesPtr length:numBytes];
+                                                   [stripBlockBitOffsets appendBytes:blockBitOffsetsPtr length:numBlocks * sizeof(uint32_t)];
+                                               }];
+            assert(worked);
+            
+            assert([stripCodes isEqualToData:outCodes]);
+            assert(stripBlockBitOffsets.length == (numBlocks * sizeof(uint32_t)));
+            int cmp = memcmp(stripBlockBitOffsets.bytes, blockOutPtr, stripBlockBitOffsets.length);
+            assert(cmp == 0);
+        }
+        
         free(decodedSymbols);
     }
 #endif // DEBUG
@@ -108,6 +108,9 @@ typedef enum AAPLHuffmanTextureIndex
 
 //#define IMPL_DELTAS_AND_INIT_ZERO_DELTA_BEFORE_HUFF_ENCODING
 
+// The fragment shaders decode a block as 16 slices of 4 symbols, so
+// the Metal path requires 8. CPU decoders accept 4, 8, 16 or 32.
+
 #define HUFF_BLOCK_DIM 8
 
 // On both an A7 and A10 device, a primary table of 8 bits
@@ -10,8 +10,9 @@
 
 // Given an input buffer, encode the input values and generate
 // output that corresponds to elias gamma encoded var length symbols.
+// Returns FALSE if the codes do not fit in 2^32 bits.
 
-+ (void) encodeBits:(uint8_t*)inBytes
++ (BOOL) encodeBits:(uint8_t*)inBytes
          inNumBytes:(int)inNumBytes
            outCodes:(NSMutableData*)outCodes
  outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
@@ -19,6 +20,43 @@
              height:(int)height
            blockDim:(int)blockDim;
 
+// Split image into blocks, encode deltas and calculate block bit
+// offsets with a single pass over the image. Pass nil for
+// outBlockDeltas unless the block order deltas are needed.
+
++ (void) encodeImageBlocks:(const uint8_t*)inBytes
+                     width:(int)width
+                    height:(int)height
+                  blockDim:(int)blockDim
+          numBlocksInWidth:(int)numBlocksInWidth
+         numBlocksInHeight:(int)numBlocksInHeight
+                  outCodes:(NSMutableData*)outCodes
+        outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+            outBlockDeltas:(NSMutableData*)outBlockDeltas;
+
+// Streaming encode that pulls the image one strip of blockDim rows
+// at a time from rowSource, which fills in width pixels for row y.
+// The sink gets the encoded bytes and block bit offsets for each
+// strip, then a final call with zero blocks and the trailing bytes.
+// Memory use is O(width). Returns NO if rowSource returns NO or the
+// codes might not fit in the 2^32 bits of the uint32 block offsets.
+
++ (BOOL) encodeImageStrips:(int)width
+                    height:(int)height
+                  blockDim:(int)blockDim
+                 rowSource:(BOOL (^)(int y, uint8_t *rowPtr))rowSource
+                      sink:(void (^)(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks))sink;
+
+// 16 bit symbol version of encodeImageBlocks for high bit depth
+// images, each delta is coded with up to 33 bits.
+
++ (void) encodeImageBlocks16:(const uint16_t*)inSymbols
+                       width:(int)width
+                      height:(int)height
+                    blockDim:(int)blockDim
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets;
+
 // Unoptimized serial decode logic. Note that this logic
 // assumes that huffBuff contains +2 bytes at the end
 // of the buffer to account for read ahead.
@@ -40,12 +78,315 @@
 
 + (NSData*) decodeSignedByteDeltas:(NSData*)deltas;
 
-// Shader simulation entry point.
+// Shader simulation entry point. This and the other block decoders
+// return NO when blockDim is not one of 4, 8, 16, 32.
 
-+ (void) decodeBlockSymbols:(int)numSymbolsToDecode
++ (BOOL) decodeBlockSymbols:(int)numSymbolsToDecode
             bitBuff:(uint8_t*)bitBuff
            bitBuffN:(int)bitBuffN
           outBuffer:(uint8_t*)outBuffer
-     blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr;
+     blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                    blockDim:(int)blockDim;
+
+// Optimized CPU block decode with a 64 bit refill bit reader,
+// generates the same output as decodeBlockSymbols.
+
++ (BOOL) decodeBlockSymbolsOpt64:(int)numSymbolsToDecode
+                         bitBuff:(uint8_t*)bitBuff
+                        bitBuffN:(int)bitBuffN
+                       outBuffer:(uint8_t*)outBuffer
+         blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                        blockDim:(int)blockDim;
+
+// Decode blocks encoded with encodeImageBlocks16 to block order
+// 16 bit symbols.
+
++ (BOOL) decodeBlockSymbols16:(int)numSymbolsToDecode
+                      bitBuff:(uint8_t*)bitBuff
+                     bitBuffN:(int)bitBuffN
+                    outBuffer:(uint16_t*)outBuffer
+      blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                     blockDim:(int)blockDim;
+
+// Emulate the decode, blit and crop render passes of the renderer on
+// the CPU with the fewest passes that fit numRenderTargets, writing the
+// cropped gray pixels to outPixels. For each pass, the bytes read from
+// textures and buffers and the bytes written to render targets are
+// added to outPassStats. Returns NO if numRenderTargets is too small.
+
++ (BOOL) emulateRenderPasses:(uint8_t*)bitBuff
+                    bitBuffN:(int)bitBuffN
+     blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       width:(int)width
+                      height:(int)height
+                    blockDim:(int)blockDim
+            numRenderTargets:(int)numRenderTargets
+               combineSlices:(BOOL)combineSlices
+                   outPixels:(uint8_t*)outPixels
+                outRowStride:(int)outRowStride
+                outPassStats:(NSMutableArray<NSDictionary*>*)outPassStats;
+
+// Optimized CPU block decode with a multiple symbol lookup table,
+// generates the same output as decodeBlockSymbols.
+
++ (BOOL) decodeBlockSymbolsTable:(int)numSymbolsToDecode
+                         bitBuff:(uint8_t*)bitBuff
+                        bitBuffN:(int)bitBuffN
+                       outBuffer:(uint8_t*)outBuffer
+         blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                        blockDim:(int)blockDim;
+
+// Multi-threaded CPU block decode, blocks are split into ranges with
+// about the same number of encoded bits and each range is decoded on
+// a worker thread. Pass 0 as numThreads to use all cores.
+
++ (BOOL) decodeBlockSymbolsParallel:(int)numSymbolsToDecode
+                            bitBuff:(uint8_t*)bitBuff
+                           bitBuffN:(int)bitBuffN
+                          outBuffer:(uint8_t*)outBuffer
+            blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                         numThreads:(int)numThreads
+                           blockDim:(int)blockDim;
+
+// SIMD CPU block decode where each vector lane decodes its own block,
+// the instruction set is detected at runtime.
+
++ (BOOL) decodeBlockSymbolsSIMD:(int)numSymbolsToDecode
+                        bitBuff:(uint8_t*)bitBuff
+                       bitBuffN:(int)bitBuffN
+                      outBuffer:(uint8_t*)outBuffer
+        blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       blockDim:(int)blockDim;
+
+// Encode block deltas with an Exp-Golomb order header for each
+// block, the order in (0, 3) is chosen to minimize the block size.
+
++ (void) encodeBitsExpGolomb:(uint8_t*)inBytes
+                  inNumBytes:(int)inNumBytes
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+                    blockDim:(int)blockDim;
+
+// Decode blocks encoded with encodeBitsExpGolomb.
+
++ (BOOL) decodeBlockSymbolsExpGolomb:(int)numSymbolsToDecode
+                             bitBuff:(uint8_t*)bitBuff
+                            bitBuffN:(int)bitBuffN
+                           outBuffer:(uint8_t*)outBuffer
+             blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                            blockDim:(int)blockDim;
+
+// Encode block deltas with a mode header for each block, constant
+// blocks store one pixel value and long runs of zero deltas are
+// coded as an escape and a run length.
+
++ (void) encodeBitsRuns:(uint8_t*)inBytes
+             inNumBytes:(int)inNumBytes
+               outCodes:(NSMutableData*)outCodes
+     outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+               blockDim:(int)blockDim;
+
+// Decode blocks encoded with encodeBitsRuns.
+
++ (BOOL) decodeBlockSymbolsRuns:(int)numSymbolsToDecode
+                        bitBuff:(uint8_t*)bitBuff
+                       bitBuffN:(int)bitBuffN
+                      outBuffer:(uint8_t*)outBuffer
+        blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       blockDim:(int)blockDim;
+
+// Encode block deltas as elias gamma codes, 8 bit literal pixels or
+// a constant, whichever is smallest, so that no block is larger than
+// its raw pixels plus 7 bits. Each 32 bit block entry holds the bit
+// offset shifted left by 2 and the block mode in the low 2 bits.
+// Returns NO if a block starts at a bit offset of 2^30 or more.
+
++ (BOOL) encodeBitsHybrid:(uint8_t*)inBytes
+               inNumBytes:(int)inNumBytes
+                 outCodes:(NSMutableData*)outCodes
+          outBlockEntries:(NSMutableData*)outBlockEntries
+                 blockDim:(int)blockDim;
+
+// Decode blocks encoded with encodeBitsHybrid, literal blocks are
+// copied with memcpy.
+
++ (BOOL) decodeBlockSymbolsHybrid:(int)numSymbolsToDecode
+                          bitBuff:(uint8_t*)bitBuff
+                         bitBuffN:(int)bitBuffN
+                        outBuffer:(uint8_t*)outBuffer
+                  blockEntriesPtr:(uint32_t*)blockEntriesPtr
+                         blockDim:(int)blockDim;
+
+// Encode pixels in block order with the predictor and scan order
+// that give the fewest bits for each block, left, up, average, MED
+// or gradient predictors with row major or serpentine scans, or the
+// previous pixel in hilbert order. A 4 bit header holds the choice.
+
++ (void) encodeBitsPredicted:(uint8_t*)inBytes
+                  inNumBytes:(int)inNumBytes
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+                    blockDim:(int)blockDim;
+
+// Decode blocks encoded with encodeBitsPredicted to pixels in block order.
+
++ (BOOL) decodeBlockSymbolsPredicted:(int)numSymbolsToDecode
+                             bitBuff:(uint8_t*)bitBuff
+                            bitBuffN:(int)bitBuffN
+                           outBuffer:(uint8_t*)outBuffer
+             blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                            blockDim:(int)blockDim;
+
+// Serialize block start bit offsets as a two level index with a
+// 32 bit anchor for each group of blocks and a 16 bit relative offset
+// for each block, the block dimension is stored in the index header.
+// Returns nil if a relative offset does not fit.
+
++ (NSData*) encodeBlockIndex:(const uint32_t*)blockStartBitOffsetsPtr
+                   numBlocks:(int)numBlocks
+                    blockDim:(int)blockDim;
+
+// Expand a serialized block index into the flat 32 bit offset
+// table used by the shader.
+
++ (BOOL) expandBlockIndex:(NSData*)blockIndexData
+  blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr;
+
+// Table decode of blocks where block offsets are looked up in
+// a serialized block index. Returns FALSE if the index is not valid
+// or numSymbolsToDecode is not whole blocks covered by the index.
+
++ (BOOL) decodeBlockSymbolsIndexed:(int)numSymbolsToDecode
+                           bitBuff:(uint8_t*)bitBuff
+                          bitBuffN:(int)bitBuffN
+                         outBuffer:(uint8_t*)outBuffer
+                        blockIndex:(NSData*)blockIndexData;
+
+// Write codes and block bit offsets to a versioned container file
+// with aligned sections, the codes must include the padding bytes.
+
++ (BOOL) writeContainerFile:(NSString*)path
+                      codes:(NSData*)codes
+            blockBitOffsets:(NSData*)blockBitOffsets
+                      width:(int)width
+                     height:(int)height
+                   blockDim:(int)blockDim;
+
+// Memory map a container file and decode the block order symbols
+// directly from the mapping without reading the file into a buffer.
+
++ (BOOL) decodeContainerFile:(NSString*)path
+                   outBuffer:(uint8_t*)outBuffer
+           outBufferNumBytes:(int)outBufferNumBytes;
+
+// Encode frames of width x height pixels to a sequence file where
+// each block is coded as unchanged, as a delta from the previous
+// frame or as a plain block, whichever is smallest.
+
++ (BOOL) encodeSequenceFile:(NSString*)path
+                     frames:(NSArray<NSData*>*)frames
+                      width:(int)width
+                     height:(int)height
+                   blockDim:(int)blockDim;
+
+// Decode a sequence file frame by frame, the block order pixels of
+// the previous frame are updated in place and passed to frameSink.
+
++ (BOOL) decodeSequenceFile:(NSString*)path
+                  frameSink:(void (^)(int frameIndex, const uint8_t *blockPixels, int numSymbols))frameSink;
+
+// Split 4 channel BGRA or 3 channel RGB pixels into planes and
+// encode each plane as its own block stream with its own block
+// bit offsets. With ycocg set, the colour channels are converted
+// to Y Co Cg planes with the reversible YCoCg-R transform.
+
++ (void) encodePlanes:(const uint8_t*)pixels
+                width:(int)width
+               height:(int)height
+          numChannels:(int)numChannels
+                ycocg:(BOOL)ycocg
+             blockDim:(int)blockDim
+        outPlaneCodes:(NSMutableArray<NSData*>*)outPlaneCodes
+outPlaneBlockBitOffsets:(NSMutableArray<NSData*>*)outPlaneBlockBitOffsets;
+
+// Decode planes in parallel and write interleaved pixels in the
+// input channel order with outRowStride bytes per row. Returns NO if
+// numChannels does not match the planes, a plane has too few block
+// offsets or outRowStride is smaller than width * numChannels.
+
++ (BOOL) decodePlanes:(NSArray<NSData*>*)planeCodes
+planeBlockBitOffsets:(NSArray<NSData*>*)planeBlockBitOffsets
+                width:(int)width
+               height:(int)height
+          numChannels:(int)numChannels
+                ycocg:(BOOL)ycocg
+             blockDim:(int)blockDim
+            outPixels:(uint8_t*)outPixels
+         outRowStride:(int)outRowStride;
+
+// Decode only the blocks that intersect a region of the image and
+// write the cropped pixels to outBuffer with outRowStride bytes per
+// row. Returns NO if the region is empty or not inside the image.
+
++ (BOOL) decodeRegionX:(int)regionX
+                     y:(int)regionY
+                 width:(int)regionWidth
+                height:(int)regionHeight
+               bitBuff:(uint8_t*)bitBuff
+              bitBuffN:(int)bitBuffN
+blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+            imageWidth:(int)imageWidth
+           imageHeight:(int)imageHeight
+              blockDim:(int)blockDim
+             outBuffer:(uint8_t*)outBuffer
+          outRowStride:(int)outRowStride;
+
+// Decode all blocks straight to an output layout without a deblock
+// pass. Layout 0 is the cropped image with outRowStride bytes per row,
+// 1 is the BGRA combined slices texture of drawInMTKView with
+// outRowStride bytes per texel row and 2 is one tile for each block in
+// morton order within power of 2 squares of blocks, outRowStride is not
+// used. Pass 0 as numThreads to use one
+// thread for each core. Returns NO if the layout is not known or
+// outRowStride is too small, see elias_layout.hpp.
+
++ (BOOL) decodeToLayout:(int)layout
+                bitBuff:(uint8_t*)bitBuff
+               bitBuffN:(int)bitBuffN
+blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+             imageWidth:(int)imageWidth
+            imageHeight:(int)imageHeight
+               blockDim:(int)blockDim
+                 outPtr:(uint8_t*)outPtr
+           outRowStride:(int)outRowStride
+             numThreads:(int)numThreads;
+
+// Print decode speed for single stream and interleaved stream
+// encodings of the symbols.
+
++ (void) benchmarkInterleaved:(const uint8_t*)symbols
+                   numSymbols:(int)numSymbols
+            numSymbolsInChunk:(int)numSymbolsInChunk;
+
+// Print region decode time for a viewport panned across the image
+// compared to a full image decode.
+
++ (void) benchmarkRegion:(uint8_t*)bitBuff
+                bitBuffN:(int)bitBuffN
+ blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+              imageWidth:(int)imageWidth
+             imageHeight:(int)imageHeight
+                blockDim:(int)blockDim
+               viewWidth:(int)viewWidth
+              viewHeight:(int)viewHeight;
+
+// Print parallel decode throughput for 1 to N threads where N is the
+// number of hardware cores.
+
++ (void) benchmarkParallel:(uint8_t*)bitBuff
+                  bitBuffN:(int)bitBuffN
+   blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+        numSymbolsToDecode:(int)numSymbolsToDecode
+                  blockDim:(int)blockDim;
 
 @end
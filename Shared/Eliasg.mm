@@ -1,26 +1,346 @@
 // Objective C interface to elias gamma parsing functions
 //  MIT Licensed
 
+#if defined(__OBJC__)
 #import "Eliasg.h"
+#else
+// The C++ functions below also build as plain C++ without the Objective C
+// wrappers, see Benchmark/Makefile.
+#include <stdint.h>
+#include "VariableBitWidthSymbol.h"
+#endif // __OBJC__
 
 #include <assert.h>
 
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <cstdint>
 
-#import "elias.hpp"
+#include "elias.hpp"
+#include "elias_threads.hpp"
+#include "elias_simd.hpp"
+#include "elias_interleaved.hpp"
+#include "elias_deltas.hpp"
+#include "elias_block_index.hpp"
+#include "elias_expgolomb.hpp"
+#include "elias_runs.hpp"
+#include "elias_hybrid.hpp"
+#include "elias_predict.hpp"
+#include "elias_layout.hpp"
+#include "elias_container.hpp"
+#include "elias_sequence.hpp"
+#include "elias_planes.hpp"
+#include "elias_render_passes.hpp"
 
 using namespace std;
 
-void
+// Call the specialization of a block decode template for a block
+// dimension known at runtime, so that per block stride and modulo
+// math compiles to constants. Supported dimensions are 4, 8, 16, 32,
+// any other dimension makes the calling function return false.
+
+#define ELIASG_DISPATCH_BLOCK_DIM(blockDim, func, args) \
+  switch (blockDim) { \
+    case 4: func<4> args; break; \
+    case 8: func<8> args; break; \
+    case 16: func<16> args; break; \
+    case 32: func<32> args; break; \
+    default: return false; \
+  }
+
+bool
 Eliasg_decodeBlockSymbols(
                           int numSymbolsToDecode,
                           uint8_t *bitBuff,
                           int bitBuffN,
                           uint8_t *outBuffer,
-                          uint32_t *blockStartBitOffsetsPtr);
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsOpt64(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsTable(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsParallel(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numThreads,
+                          int blockDim);
+
+bool
+Eliasg_decodeBlockSymbolsSIMD(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+void
+Eliasg_benchmarkInterleaved(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInChunk);
+
+bool
+Eliasg_encodeBlockSymbolsParallel(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          int numThreads);
+
+bool
+Eliasg_encodeImageStrips(
+                          int width,
+                          int height,
+                          int blockDim,
+                          const std::function<bool(int y, uint8_t *rowPtr)> & rowSource,
+                          const std::function<void(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks)> & sink);
+
+bool
+Eliasg_decodeRegion(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int regionX,
+                          int regionY,
+                          int regionWidth,
+                          int regionHeight,
+                          uint8_t *outPtr,
+                          int outRowStride);
+
+void
+Eliasg_benchmarkRegion(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int viewWidth,
+                          int viewHeight);
+
+void
+Eliasg_benchmarkParallel(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numSymbolsToDecode,
+                          int blockDim);
+
+bool
+Eliasg_writeContainerFile(
+                          const char *path,
+                          int width,
+                          int height,
+                          int blockDim,
+                          const uint8_t *codesPtr,
+                          int codesNumBytes,
+                          const uint32_t *blockBitOffsetsPtr,
+                          int numBlocks);
+
+bool
+Eliasg_decodeContainerFile(
+                          const char *path,
+                          uint8_t *outBuffer,
+                          int outBufferNumBytes);
+
+bool
+Eliasg_encodeSequenceFile(
+                          const char *path,
+                          const uint8_t * const *framePtrs,
+                          int numFrames,
+                          int width,
+                          int height,
+                          int blockDim);
+
+bool
+Eliasg_decodeSequenceFile(
+                          const char *path,
+                          const std::function<void(int frameIndex, const uint8_t *blockPixels, int numSymbols)> & frameSink);
+
+void
+Eliasg_encodePlanes(
+                          const uint8_t *pixels,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          vector<vector<uint8_t> > & outPlaneCodes,
+                          vector<vector<uint32_t> > & outPlaneBlockBitOffsets);
+
+bool
+Eliasg_decodePlanes(
+                          const uint8_t * const *planeCodesPtrs,
+                          const int *planeCodesNumBytes,
+                          const uint32_t * const *planeBlockBitOffsetsPtrs,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride);
+
+void
+Eliasg_encodeBlockSymbolsExpGolomb(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsExpGolomb(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+void
+Eliasg_encodeBlockSymbolsRuns(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsRuns(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_encodeBlockSymbolsHybrid(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockEntries);
+
+bool
+Eliasg_decodeBlockSymbolsHybrid(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockEntriesPtr,
+                          int blockDim);
+
+void
+Eliasg_encodeBlockSymbolsPredicted(
+                          const uint8_t *blockPixels,
+                          int numSymbols,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbolsPredicted(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_decodeToLayout(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          EliasOutputLayoutKind layout,
+                          uint8_t *outPtr,
+                          int outRowStride,
+                          int numThreads);
+
+bool
+Eliasg_decodeBlockSymbolsIndexed(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          const EliasBlockIndex & blockIndex);
+
+void
+Eliasg_encodeImageBlocks(
+                          const uint8_t *imageBytes,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int numBlocksInWidth,
+                          int numBlocksInHeight,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          uint8_t *outBlockDeltas);
+
+void
+Eliasg_encodeImageBlocks16(
+                          const uint16_t *imageSymbols,
+                          int width,
+                          int height,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets);
+
+bool
+Eliasg_decodeBlockSymbols16(
+                          int numSymbolsToDecode,
+                          const uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint16_t *outBuffer,
+                          const uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim);
+
+bool
+Eliasg_emulateRenderPasses(
+                          const EliasRenderPassSchedule & schedule,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride,
+                          vector<EliasRenderPassStats> & outStats);
 
 // Invoke huffman util module functions
 
@@ -28,56 +348,43 @@ static inline
 vector<uint8_t> encode(const uint8_t * bytes,
             const int numBytes)
 {
-    EliasGammaEncoder encoder;
+    EliasGammaEncoderOpt64 encoder;
     
     encoder.emitPaddingZeros = true;
     encoder.emitMSB = true;
     encoder.encode(bytes, numBytes);
+
+#if defined(DEBUG)
+    {
+        // Table driven output must be byte identical to bit by bit encoder
+        EliasGammaEncoder bitEncoder;
+        bitEncoder.emitPaddingZeros = true;
+        bitEncoder.emitMSB = true;
+        bitEncoder.encode(bytes, numBytes);
+        assert(bitEncoder.bytes == encoder.bytes);
+        assert(bitEncoder.numEncodedBits == encoder.numEncodedBits);
+    }
+#endif // DEBUG
     
     return std::move(encoder.bytes);
 }
 
 static inline
 bool decode(const uint8_t *encodedBitsPtr,
+            const unsigned int numEncodedBytes,
             const unsigned int numSymbols,
             vector<uint8_t> & symbols)
 {
-    EliasGammaDecoderOpt16 decoder;
+    EliasGammaDecoderOpt64 decoder;
     
     decoder.decode(encodedBitsPtr,
+                   numEncodedBytes,
                    numSymbols,
                    symbols);
     
     return true;
 }
 
-// Generate a table of bit width offsets for N symbols, this is
-// the symbol width added to a running counter of the offset
-// into a buffer.
-
-// FIXME: would be more optimal to generate a table of just the block
-// offsets instead of all of the symbols in a table.
-
-static inline
-vector<uint32_t> generateBitOffsets(const uint8_t * symbols, int numSymbols)
-{
-    vector<uint32_t> bitOffsets;
-    bitOffsets.reserve(numSymbols);
-    
-    unsigned int offset = 0;
-    
-    EliasGammaEncoder encoder;
-    
-    for ( int i = 0; i < numSymbols; i++ ) {
-        bitOffsets.push_back(offset);
-        uint8_t symbol = symbols[i];
-        uint32_t bitWidth = encoder.numBits(symbol);
-        offset += bitWidth;
-    }
-    
-    return bitOffsets;
-}
-
 static inline
 string get_code_bits_as_string(uint32_t code, const int width)
 {
@@ -225,14 +532,271 @@ pixelpack_int8_to_offset_uint8(int8_t value)
     return offset8;
 }
 
+// Branch free zerod delta between two pixel values, the signed
+// byte delta is mapped so that 0 = 0, -1 = 1, 1 = 2, -2 = 3.
+
+static inline
+uint8_t Eliasg_zerodDelta(uint8_t cur, uint8_t prev)
+{
+    uint8_t zerodVal = EliasZerodDeltas::zerodDelta(cur, prev);
+#if defined(DEBUG)
+    assert(zerodVal == pixelpack_int8_to_offset_uint8((int8_t) (cur - prev)));
+#endif // DEBUG
+    return zerodVal;
+}
+
+// Convert one row of zero padded blocks to zerod deltas and elias gamma
+// encode the deltas. rowsPtr points at the first of numRows image rows
+// in the block row, rows past numRows and columns past the right edge
+// of the image are zero padding. Returns the advanced outBlockDeltas.
+
+static inline
+uint8_t *
+Eliasg_encodeBlockRow(
+                          EliasGammaEncoderOpt64 & encoder,
+                          const uint8_t *rowsPtr,
+                          int width,
+                          int numRows,
+                          int blockDim,
+                          int numBlocksInWidth,
+                          uint32_t *blockOffsetPtr,
+                          uint8_t *outBlockDeltas)
+{
+    const EliasGammaCode *table = EliasGamma_codeTable(true);
+    
+    for (int blockX = 0; blockX < numBlocksInWidth; blockX++) {
+        *blockOffsetPtr++ = encoder.numEncodedBits;
+        
+        const int x = blockX * blockDim;
+        const int numImageCols = max(0, min(blockDim, width - x));
+        
+        uint8_t prev = 0;
+        
+        for (int row = 0; row < blockDim; row++) {
+            const int numCols = (row < numRows) ? numImageCols : 0;
+            const uint8_t *rowPtr = rowsPtr + ((size_t)row * width) + x;
+            
+            int col = 0;
+            
+            for ( ; col < numCols; col++) {
+                uint8_t cur = rowPtr[col];
+                uint8_t zerodVal = Eliasg_zerodDelta(cur, prev);
+                prev = cur;
+                encoder.encodeCode(table[zerodVal]);
+                if (outBlockDeltas) {
+                    *outBlockDeltas++ = zerodVal;
+                }
+            }
+            
+            for ( ; col < blockDim; col++) {
+                uint8_t zerodVal = Eliasg_zerodDelta(0, prev);
+                prev = 0;
+                encoder.encodeCode(table[zerodVal]);
+                if (outBlockDeltas) {
+                    *outBlockDeltas++ = zerodVal;
+                }
+            }
+        }
+    }
+    
+    return outBlockDeltas;
+}
+
+// Split the image into zero padded blocks, convert each block to
+// zerod deltas and elias gamma encode the deltas in one pass over
+// the image. The bit offset of each block is recorded as the block
+// is encoded so that no per symbol offset table is needed. When
+// outBlockDeltas is not NULL, the block order deltas are also written.
+
+void
+Eliasg_encodeImageBlocks(
+                          const uint8_t *imageBytes,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int numBlocksInWidth,
+                          int numBlocksInHeight,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          uint8_t *outBlockDeltas)
+{
+    const int numBlocks = numBlocksInWidth * numBlocksInHeight;
+    
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    encoder.reserveSymbols(numBlocks * (blockDim * blockDim));
+    
+    outBlockBitOffsets.resize(numBlocks);
+    
+    for (int blockY = 0; blockY < numBlocksInHeight; blockY++) {
+        const int y = blockY * blockDim;
+        
+        outBlockDeltas = Eliasg_encodeBlockRow(encoder,
+                                               imageBytes + ((size_t)y * width),
+                                               width,
+                                               max(0, min(blockDim, height - y)),
+                                               blockDim,
+                                               numBlocksInWidth,
+                                               outBlockBitOffsets.data() + (blockY * numBlocksInWidth),
+                                               outBlockDeltas);
+    }
+    
+    encoder.finish();
+    
+    outCodes = std::move(encoder.bytes);
+}
+
+// Streaming version of Eliasg_encodeImageBlocks that reads the image one
+// strip of blockDim rows at a time. rowSource fills in the width pixels of
+// row y and returns false to stop. After each strip, sink gets the whole
+// encoded bytes written since the previous strip and the bit offsets of
+// the blocks in the strip. The final call has zero blocks, it passes the
+// remaining bits and the padding bytes. Memory use is O(width), the
+// concatenated output is the same as Eliasg_encodeImageBlocks. Block
+// offsets are uint32, so a strip is only encoded when every block in it
+// would still end below 2^32 bits at the worst case of 17 bits for each
+// symbol. Returns false at the first strip that might not fit.
+
+bool
+Eliasg_encodeImageStrips(
+                          int width,
+                          int height,
+                          int blockDim,
+                          const std::function<bool(int y, uint8_t *rowPtr)> & rowSource,
+                          const std::function<void(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks)> & sink)
+{
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    vector<uint8_t> stripRows((size_t)width * blockDim);
+    vector<uint32_t> stripBlockBitOffsets(numBlocksInWidth);
+    
+    const uint64_t maxStripNumBits = (uint64_t) numBlocksInWidth * (blockDim * blockDim) * EliasGammaSymbol<uint8_t>::maxBitsPerSymbol;
+    
+    for (int blockY = 0; blockY < numBlocksInHeight; blockY++) {
+        const int y = blockY * blockDim;
+        const int numRows = min(blockDim, height - y);
+        
+        if (((uint64_t) encoder.numEncodedBits + maxStripNumBits) > 0xFFFFFFFF) {
+            return false;
+        }
+        
+        for (int row = 0; row < numRows; row++) {
+            if (!rowSource(y + row, stripRows.data() + ((size_t)row * width))) {
+                return false;
+            }
+        }
+        
+        encoder.reserveSymbols(numBlocksInWidth * (blockDim * blockDim));
+        
+        Eliasg_encodeBlockRow(encoder,
+                              stripRows.data(),
+                              width,
+                              numRows,
+                              blockDim,
+                              numBlocksInWidth,
+                              stripBlockBitOffsets.data(),
+                              NULL);
+        
+        sink(encoder.bytes.data(), encoder.byteOffset, stripBlockBitOffsets.data(), numBlocksInWidth);
+        encoder.drain();
+    }
+    
+    encoder.finish();
+    
+    sink(encoder.bytes.data(), (int) encoder.bytes.size(), NULL, 0);
+    
+    return true;
+}
+
+// 16 bit version of Eliasg_encodeImageBlocks for high bit depth images
+// like 10, 12 or 16 bit depth maps. Each zero padded block is converted
+// to 16 bit zerod deltas and the deltas are MSB first elias gamma codes
+// of up to 33 bits.
+
+void
+Eliasg_encodeImageBlocks16(
+                          const uint16_t *imageSymbols,
+                          int width,
+                          int height,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets)
+{
+    const int numSymbolsInBlock = blockDim * blockDim;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    const int numBlocks = numBlocksInWidth * numBlocksInHeight;
+    
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    outBlockBitOffsets.resize(numBlocks);
+    
+    vector<uint16_t> blockDeltas(numSymbolsInBlock);
+    
+#if defined(DEBUG)
+    vector<uint16_t> allBlockDeltas;
+#endif // DEBUG
+    
+    for (int blockY = 0; blockY < numBlocksInHeight; blockY++) {
+        for (int blockX = 0; blockX < numBlocksInWidth; blockX++) {
+            const int x = blockX * blockDim;
+            const int y = blockY * blockDim;
+            const int numCols = min(blockDim, width - x);
+            const int numRows = min(blockDim, height - y);
+            
+            std::fill(blockDeltas.begin(), blockDeltas.end(), 0);
+            
+            for (int row = 0; row < numRows; row++) {
+                memcpy(blockDeltas.data() + (row * blockDim),
+                       imageSymbols + ((size_t)(y + row) * width) + x,
+                       numCols * sizeof(uint16_t));
+            }
+            
+            EliasZerodDeltas::doDeltas(blockDeltas.data(), numSymbolsInBlock);
+            
+            outBlockBitOffsets[(blockY * numBlocksInWidth) + blockX] = encoder.numEncodedBits;
+            encoder.encodeSymbols(blockDeltas.data(), numSymbolsInBlock);
+            
+#if defined(DEBUG)
+            allBlockDeltas.insert(allBlockDeltas.end(), blockDeltas.begin(), blockDeltas.end());
+#endif // DEBUG
+        }
+    }
+    
+    encoder.finish();
+    
+#if defined(DEBUG)
+    {
+        // Output must be byte identical to the bit at a time encoder
+        EliasGammaEncoder serialEncoder;
+        serialEncoder.emitPaddingZeros = true;
+        serialEncoder.emitMSB = true;
+        serialEncoder.encode(allBlockDeltas.data(), (int) allBlockDeltas.size());
+        assert(serialEncoder.bytes == encoder.bytes);
+    }
+#endif // DEBUG
+    
+    outCodes = std::move(encoder.bytes);
+}
+
 // Main class performing the rendering
 
+#if defined(__OBJC__)
+
 @implementation Eliasg
 
 // Given an input buffer, huffman encode the input values and generate
 // output that corresponds to
 
-+ (void) encodeBits:(uint8_t*)inBytes
++ (BOOL) encodeBits:(uint8_t*)inBytes
          inNumBytes:(int)inNumBytes
            outCodes:(NSMutableData*)outCodes
  outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
@@ -240,7 +804,28 @@ pixelpack_int8_to_offset_uint8(int8_t value)
              height:(int)height
            blockDim:(int)blockDim
 {
-  vector<uint8_t> outBytesVec = encode(inBytes, inNumBytes);
+  // The outBlockBitOffsets output contains bit offsets of the start
+  // of each block, these are calculated from the block bit widths
+  // and then each block is encoded in parallel at its offset.
+  
+  const int blockN = (blockDim * blockDim);
+  
+  assert(inNumBytes == (width * height));
+  
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  if (!Eliasg_encodeBlockSymbolsParallel(inBytes, inNumBytes, blockN, outBytesVec, blockStartOffsetsVec, 0)) {
+      return FALSE;
+  }
+
+#if defined(DEBUG)
+  {
+      // Parallel output must be byte identical to the serial encoder
+      vector<uint8_t> serialBytesVec = encode(inBytes, inNumBytes);
+      assert(serialBytesVec == outBytesVec);
+  }
+#endif // DEBUG
     
   {
       // Copy from outBytesVec to outCodes
@@ -249,25 +834,58 @@ pixelpack_int8_to_offset_uint8(int8_t value)
       [mData setLength:numBytes];
       memcpy(mData.mutableBytes, outBytesVec.data(), numBytes);
   }
-    
-  // Generate bit width lookup table from original input symbols
-  vector<uint32_t> offsetsVec = generateBitOffsets(inBytes, inNumBytes);
 
-  // The outBlockBitOffsets output contains bit offsets of the start
-  // of each block, so skip over (blockDim * blockDim) offsets on
-  // each lookup.
+  {
+      int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
+      if ((int)outBlockBitOffsets.length != numBytes) {
+          [outBlockBitOffsets setLength:numBytes];
+      }
+      memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
+  }
+  
+  return TRUE;
+}
 
-  const int maxOffset = (width * height);
-  const int blockN = (blockDim * blockDim);
-    
-  vector<uint32_t> blockStartOffsetsVec;
-  blockStartOffsetsVec.reserve(maxOffset / blockN);
+// Split image into blocks, encode deltas and calculate block bit
+// offsets with a single pass over the image.
 
-  for (int offset = 0; offset < maxOffset; offset += blockN ) {
-      int blockStartBitOffset = offsetsVec[offset];
-      blockStartOffsetsVec.push_back(blockStartBitOffset);
++ (void) encodeImageBlocks:(const uint8_t*)inBytes
+                     width:(int)width
+                    height:(int)height
+                  blockDim:(int)blockDim
+          numBlocksInWidth:(int)numBlocksInWidth
+         numBlocksInHeight:(int)numBlocksInHeight
+                  outCodes:(NSMutableData*)outCodes
+        outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+            outBlockDeltas:(NSMutableData*)outBlockDeltas
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  uint8_t *outBlockDeltasPtr = NULL;
+  
+  if (outBlockDeltas != nil) {
+    int numDeltas = (numBlocksInWidth * numBlocksInHeight) * (blockDim * blockDim);
+    [outBlockDeltas setLength:numDeltas];
+    outBlockDeltasPtr = (uint8_t *) outBlockDeltas.mutableBytes;
   }
-
+  
+  Eliasg_encodeImageBlocks(inBytes,
+                           width,
+                           height,
+                           blockDim,
+                           numBlocksInWidth,
+                           numBlocksInHeight,
+                           outBytesVec,
+                           blockStartOffsetsVec,
+                           outBlockDeltasPtr);
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
+  
   {
       int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
       if ((int)outBlockBitOffsets.length != numBytes) {
@@ -275,8 +893,55 @@ pixelpack_int8_to_offset_uint8(int8_t value)
       }
       memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
   }
+}
+
++ (BOOL) encodeImageStrips:(int)width
+                    height:(int)height
+                  blockDim:(int)blockDim
+                 rowSource:(BOOL (^)(int y, uint8_t *rowPtr))rowSource
+                      sink:(void (^)(const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks))sink
+{
+  bool worked = Eliasg_encodeImageStrips(width, height, blockDim,
+                                         [&](int y, uint8_t *rowPtr) -> bool {
+                                           return rowSource(y, rowPtr);
+                                         },
+                                         [&](const uint8_t *codesPtr, int numBytes, const uint32_t *blockBitOffsetsPtr, int numBlocks) {
+                                           sink(codesPtr, numBytes, blockBitOffsetsPtr, numBlocks);
+                                         });
+  
+  return worked ? TRUE : FALSE;
+}
+
++ (void) encodeImageBlocks16:(const uint16_t*)inSymbols
+                       width:(int)width
+                      height:(int)height
+                    blockDim:(int)blockDim
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  Eliasg_encodeImageBlocks16(inSymbols,
+                             width,
+                             height,
+                             blockDim,
+                             outBytesVec,
+                             blockStartOffsetsVec);
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
   
-  return;
+  {
+      int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
+      if ((int)outBlockBitOffsets.length != numBytes) {
+          [outBlockBitOffsets setLength:numBytes];
+      }
+      memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
+  }
 }
 
 // Unoptimized serial decode logic. Note that this logic
@@ -292,7 +957,7 @@ pixelpack_int8_to_offset_uint8(int8_t value)
     vector<uint8_t> outVec;
     outVec.reserve(numSymbolsToDecode);
     
-    decode(bitBuff, numSymbolsToDecode, outVec);
+    decode(bitBuff, bitBuffN, numSymbolsToDecode, outVec);
     // FIXME: how should decode method return the result data?
     // Since size of buffer is know, this module can assume
     // that allocated buffer is large enough to handle known
@@ -334,38 +999,503 @@ pixelpack_int8_to_offset_uint8(int8_t value)
 + (NSData*) decodeSignedByteDeltas:(NSData*)deltas
 {
   const int maxNumBytes = (int) deltas.length;
-
-  vector<uint8_t> signedDeltaBytes;
-  signedDeltaBytes.resize(maxNumBytes);
-  const uint8_t *zerodDeltasPtr = (uint8_t *) deltas.bytes;
   
-  for (int i = 0; i < maxNumBytes; i++) {
-    uint8_t zerodVal = zerodDeltasPtr[i];
-    int8_t sVal = pixelpack_offset_uint8_to_int8(zerodVal);
-    signedDeltaBytes[i] = (uint8_t) sVal;
-  }
-
-  // Apply signed deltas
-  vector<uint8_t> outSymbols = decodeDelta(signedDeltaBytes);
-    
-  NSMutableData *mData = [NSMutableData data];
-  [mData setLength:maxNumBytes];
-  memcpy((void*)mData.mutableBytes, (void*)outSymbols.data(), maxNumBytes);
-    
+  NSMutableData *mData = [NSMutableData dataWithData:deltas];
+  
+  // Undo zerod mapping and apply signed deltas in place
+  EliasZerodDeltas::undoDeltas((uint8_t *) mData.mutableBytes, maxNumBytes);
+  
   return [NSData dataWithData:mData];
 }
 
-+ (void) decodeBlockSymbols:(int)numSymbolsToDecode
++ (BOOL) decodeBlockSymbols:(int)numSymbolsToDecode
                     bitBuff:(uint8_t*)bitBuff
                    bitBuffN:(int)bitBuffN
                   outBuffer:(uint8_t*)outBuffer
     blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                   blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbols(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (BOOL) decodeBlockSymbolsOpt64:(int)numSymbolsToDecode
+                         bitBuff:(uint8_t*)bitBuff
+                        bitBuffN:(int)bitBuffN
+                       outBuffer:(uint8_t*)outBuffer
+         blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                        blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsOpt64(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (BOOL) decodeBlockSymbols16:(int)numSymbolsToDecode
+                      bitBuff:(uint8_t*)bitBuff
+                     bitBuffN:(int)bitBuffN
+                    outBuffer:(uint16_t*)outBuffer
+      blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                     blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbols16(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (BOOL) emulateRenderPasses:(uint8_t*)bitBuff
+                    bitBuffN:(int)bitBuffN
+     blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       width:(int)width
+                      height:(int)height
+                    blockDim:(int)blockDim
+            numRenderTargets:(int)numRenderTargets
+               combineSlices:(BOOL)combineSlices
+                   outPixels:(uint8_t*)outPixels
+                outRowStride:(int)outRowStride
+                outPassStats:(NSMutableArray<NSDictionary*>*)outPassStats
+{
+    EliasRenderPassSchedule schedule = EliasRenderPassSchedule::fewestPasses(blockDim * blockDim, numRenderTargets);
+    schedule.combineSlices = combineSlices;
+    
+    vector<EliasRenderPassStats> stats;
+    
+    if (!Eliasg_emulateRenderPasses(schedule, bitBuff, bitBuffN, blockStartBitOffsetsPtr, width, height, blockDim, outPixels, outRowStride, stats)) {
+        return FALSE;
+    }
+    
+    for ( int passi = 0; passi < (int) stats.size(); passi++ ) {
+        const EliasRenderPassStats & passStats = stats[passi];
+        [outPassStats addObject:@{
+                                  @"kind": @(passStats.kind),
+                                  @"numSymbols": @(passStats.numSymbols),
+                                  @"numRenderTargets": @(passStats.numRenderTargets),
+                                  @"textureBytesRead": @(passStats.textureBytesRead),
+                                  @"bufferBytesRead": @(passStats.bufferBytesRead),
+                                  @"textureBytesWritten": @(passStats.textureBytesWritten),
+                                  }];
+    }
+    
+    return TRUE;
+}
+
++ (BOOL) decodeBlockSymbolsTable:(int)numSymbolsToDecode
+                         bitBuff:(uint8_t*)bitBuff
+                        bitBuffN:(int)bitBuffN
+                       outBuffer:(uint8_t*)outBuffer
+         blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                        blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsTable(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (BOOL) decodeBlockSymbolsParallel:(int)numSymbolsToDecode
+                            bitBuff:(uint8_t*)bitBuff
+                           bitBuffN:(int)bitBuffN
+                          outBuffer:(uint8_t*)outBuffer
+            blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                         numThreads:(int)numThreads
+                           blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsParallel(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, numThreads, blockDim);
+}
+
++ (BOOL) decodeBlockSymbolsSIMD:(int)numSymbolsToDecode
+                        bitBuff:(uint8_t*)bitBuff
+                       bitBuffN:(int)bitBuffN
+                      outBuffer:(uint8_t*)outBuffer
+        blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsSIMD(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (void) encodeBitsExpGolomb:(uint8_t*)inBytes
+                  inNumBytes:(int)inNumBytes
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+                    blockDim:(int)blockDim
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  Eliasg_encodeBlockSymbolsExpGolomb(inBytes, inNumBytes, blockDim * blockDim, outBytesVec, blockStartOffsetsVec);
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
+  
+  {
+      int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
+      [outBlockBitOffsets setLength:numBytes];
+      memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
+  }
+}
+
++ (BOOL) decodeBlockSymbolsExpGolomb:(int)numSymbolsToDecode
+                             bitBuff:(uint8_t*)bitBuff
+                            bitBuffN:(int)bitBuffN
+                           outBuffer:(uint8_t*)outBuffer
+             blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                            blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsExpGolomb(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (void) encodeBitsRuns:(uint8_t*)inBytes
+             inNumBytes:(int)inNumBytes
+               outCodes:(NSMutableData*)outCodes
+     outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+               blockDim:(int)blockDim
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  Eliasg_encodeBlockSymbolsRuns(inBytes, inNumBytes, blockDim * blockDim, outBytesVec, blockStartOffsetsVec);
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
+  
+  {
+      int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
+      [outBlockBitOffsets setLength:numBytes];
+      memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
+  }
+}
+
++ (BOOL) decodeBlockSymbolsRuns:(int)numSymbolsToDecode
+                        bitBuff:(uint8_t*)bitBuff
+                       bitBuffN:(int)bitBuffN
+                      outBuffer:(uint8_t*)outBuffer
+        blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                       blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsRuns(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (BOOL) encodeBitsHybrid:(uint8_t*)inBytes
+               inNumBytes:(int)inNumBytes
+                 outCodes:(NSMutableData*)outCodes
+          outBlockEntries:(NSMutableData*)outBlockEntries
+                 blockDim:(int)blockDim
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockEntriesVec;
+  
+  if (!Eliasg_encodeBlockSymbolsHybrid(inBytes, inNumBytes, blockDim * blockDim, outBytesVec, blockEntriesVec)) {
+      return FALSE;
+  }
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
+  
+  {
+      int numBytes = (int) (blockEntriesVec.size() * sizeof(uint32_t));
+      [outBlockEntries setLength:numBytes];
+      memcpy(outBlockEntries.mutableBytes, blockEntriesVec.data(), numBytes);
+  }
+  
+  return TRUE;
+}
+
++ (BOOL) decodeBlockSymbolsHybrid:(int)numSymbolsToDecode
+                          bitBuff:(uint8_t*)bitBuff
+                         bitBuffN:(int)bitBuffN
+                        outBuffer:(uint8_t*)outBuffer
+                  blockEntriesPtr:(uint32_t*)blockEntriesPtr
+                         blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsHybrid(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockEntriesPtr, blockDim);
+}
+
++ (void) encodeBitsPredicted:(uint8_t*)inBytes
+                  inNumBytes:(int)inNumBytes
+                    outCodes:(NSMutableData*)outCodes
+          outBlockBitOffsets:(NSMutableData*)outBlockBitOffsets
+                    blockDim:(int)blockDim
+{
+  vector<uint8_t> outBytesVec;
+  vector<uint32_t> blockStartOffsetsVec;
+  
+  Eliasg_encodeBlockSymbolsPredicted(inBytes, inNumBytes, blockDim, outBytesVec, blockStartOffsetsVec);
+  
+  {
+      int numBytes = (int)(outBytesVec.size() * sizeof(uint8_t));
+      [outCodes setLength:numBytes];
+      memcpy(outCodes.mutableBytes, outBytesVec.data(), numBytes);
+  }
+  
+  {
+      int numBytes = (int) (blockStartOffsetsVec.size() * sizeof(uint32_t));
+      [outBlockBitOffsets setLength:numBytes];
+      memcpy(outBlockBitOffsets.mutableBytes, blockStartOffsetsVec.data(), numBytes);
+  }
+}
+
++ (BOOL) decodeBlockSymbolsPredicted:(int)numSymbolsToDecode
+                             bitBuff:(uint8_t*)bitBuff
+                            bitBuffN:(int)bitBuffN
+                           outBuffer:(uint8_t*)outBuffer
+             blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+                            blockDim:(int)blockDim
+{
+    return Eliasg_decodeBlockSymbolsPredicted(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, blockDim);
+}
+
++ (NSData*) encodeBlockIndex:(const uint32_t*)blockStartBitOffsetsPtr
+                    numBlocks:(int)numBlocks
+                     blockDim:(int)blockDim
+{
+    EliasBlockIndex blockIndex;
+    
+    if (!blockIndex.build(blockStartBitOffsetsPtr, numBlocks, blockDim)) {
+        return nil;
+    }
+    
+    vector<uint8_t> bytes;
+    blockIndex.write(bytes);
+    
+    return [NSData dataWithBytes:bytes.data() length:bytes.size()];
+}
+
++ (BOOL) expandBlockIndex:(NSData*)blockIndexData
+  blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+{
+    EliasBlockIndex blockIndex;
+    
+    if (!blockIndex.read((const uint8_t *) blockIndexData.bytes, (unsigned int) blockIndexData.length)) {
+        return FALSE;
+    }
+    
+    blockIndex.expand(blockStartBitOffsetsPtr);
+    return TRUE;
+}
+
++ (BOOL) decodeBlockSymbolsIndexed:(int)numSymbolsToDecode
+                           bitBuff:(uint8_t*)bitBuff
+                          bitBuffN:(int)bitBuffN
+                         outBuffer:(uint8_t*)outBuffer
+                        blockIndex:(NSData*)blockIndexData
+{
+    EliasBlockIndex blockIndex;
+    
+    if (!blockIndex.read((const uint8_t *) blockIndexData.bytes, (unsigned int) blockIndexData.length)) {
+        return FALSE;
+    }
+    
+    return Eliasg_decodeBlockSymbolsIndexed(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockIndex);
+}
+
++ (BOOL) writeContainerFile:(NSString*)path
+                      codes:(NSData*)codes
+            blockBitOffsets:(NSData*)blockBitOffsets
+                      width:(int)width
+                     height:(int)height
+                   blockDim:(int)blockDim
+{
+    bool worked = Eliasg_writeContainerFile([path UTF8String],
+                                            width,
+                                            height,
+                                            blockDim,
+                                            (const uint8_t *) codes.bytes,
+                                            (int) codes.length,
+                                            (const uint32_t *) blockBitOffsets.bytes,
+                                            (int) (blockBitOffsets.length / sizeof(uint32_t)));
+    return worked ? TRUE : FALSE;
+}
+
++ (BOOL) decodeContainerFile:(NSString*)path
+                   outBuffer:(uint8_t*)outBuffer
+           outBufferNumBytes:(int)outBufferNumBytes
+{
+    bool worked = Eliasg_decodeContainerFile([path UTF8String], outBuffer, outBufferNumBytes);
+    return worked ? TRUE : FALSE;
+}
+
++ (BOOL) encodeSequenceFile:(NSString*)path
+                     frames:(NSArray<NSData*>*)frames
+                      width:(int)width
+                     height:(int)height
+                   blockDim:(int)blockDim
+{
+    vector<const uint8_t *> framePtrs;
+    for ( NSData *frame in frames ) {
+        assert(frame.length == (width * height));
+        framePtrs.push_back((const uint8_t *) frame.bytes);
+    }
+    
+    bool worked = Eliasg_encodeSequenceFile([path UTF8String],
+                                            framePtrs.data(),
+                                            (int) framePtrs.size(),
+                                            width,
+                                            height,
+                                            blockDim);
+    return worked ? TRUE : FALSE;
+}
+
++ (BOOL) decodeSequenceFile:(NSString*)path
+                  frameSink:(void (^)(int frameIndex, const uint8_t *blockPixels, int numSymbols))frameSink
+{
+    bool worked = Eliasg_decodeSequenceFile([path UTF8String],
+                                            [&](int frameIndex, const uint8_t *blockPixels, int numSymbols) {
+                                              frameSink(frameIndex, blockPixels, numSymbols);
+                                            });
+    return worked ? TRUE : FALSE;
+}
+
++ (void) encodePlanes:(const uint8_t*)pixels
+                width:(int)width
+               height:(int)height
+          numChannels:(int)numChannels
+                ycocg:(BOOL)ycocg
+             blockDim:(int)blockDim
+        outPlaneCodes:(NSMutableArray<NSData*>*)outPlaneCodes
+outPlaneBlockBitOffsets:(NSMutableArray<NSData*>*)outPlaneBlockBitOffsets
+{
+    assert(numChannels == 3 || numChannels == 4);
+    
+    vector<vector<uint8_t> > planeCodes;
+    vector<vector<uint32_t> > planeBlockBitOffsets;
+    
+    Eliasg_encodePlanes(pixels,
+                        width,
+                        height,
+                        (numChannels == 4) ? EliasPixelFormatBGRA : EliasPixelFormatRGB,
+                        ycocg ? EliasColorTransformYCoCgR : EliasColorTransformNone,
+                        blockDim,
+                        planeCodes,
+                        planeBlockBitOffsets);
+    
+    [outPlaneCodes removeAllObjects];
+    [outPlaneBlockBitOffsets removeAllObjects];
+    
+    for ( int planei = 0; planei < (int) planeCodes.size(); planei++ ) {
+        [outPlaneCodes addObject:[NSData dataWithBytes:planeCodes[planei].data()
+                                                length:planeCodes[planei].size()]];
+        [outPlaneBlockBitOffsets addObject:[NSData dataWithBytes:planeBlockBitOffsets[planei].data()
+                                                          length:planeBlockBitOffsets[planei].size() * sizeof(uint32_t)]];
+    }
+}
+
++ (BOOL) decodePlanes:(NSArray<NSData*>*)planeCodes
+planeBlockBitOffsets:(NSArray<NSData*>*)planeBlockBitOffsets
+                width:(int)width
+               height:(int)height
+          numChannels:(int)numChannels
+                ycocg:(BOOL)ycocg
+             blockDim:(int)blockDim
+            outPixels:(uint8_t*)outPixels
+         outRowStride:(int)outRowStride
+{
+    if ((numChannels != 3 && numChannels != 4) ||
+        (int) planeCodes.count != numChannels || (int) planeBlockBitOffsets.count != numChannels ||
+        !EliasBlockIndex::isValidBlockDim(blockDim) || width <= 0 || height <= 0) {
+        return FALSE;
+    }
+    
+    // The decoder reads one block offset for each block of each plane
+    
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    const NSUInteger offsetsNumBytes = (NSUInteger) numBlocksInWidth * numBlocksInHeight * sizeof(uint32_t);
+    
+    const uint8_t *codesPtrs[EliasPlanes::maxNumPlanes];
+    int codesNumBytes[EliasPlanes::maxNumPlanes];
+    const uint32_t *blockBitOffsetsPtrs[EliasPlanes::maxNumPlanes];
+    
+    for ( int planei = 0; planei < numChannels; planei++ ) {
+        if (planeBlockBitOffsets[planei].length < offsetsNumBytes) {
+            return FALSE;
+        }
+        codesPtrs[planei] = (const uint8_t *) planeCodes[planei].bytes;
+        codesNumBytes[planei] = (int) planeCodes[planei].length;
+        blockBitOffsetsPtrs[planei] = (const uint32_t *) planeBlockBitOffsets[planei].bytes;
+    }
+    
+    return Eliasg_decodePlanes(codesPtrs,
+                               codesNumBytes,
+                               blockBitOffsetsPtrs,
+                               width,
+                               height,
+                               (numChannels == 4) ? EliasPixelFormatBGRA : EliasPixelFormatRGB,
+                               ycocg ? EliasColorTransformYCoCgR : EliasColorTransformNone,
+                               blockDim,
+                               outPixels,
+                               outRowStride);
+}
+
++ (BOOL) decodeRegionX:(int)regionX
+                     y:(int)regionY
+                 width:(int)regionWidth
+                height:(int)regionHeight
+               bitBuff:(uint8_t*)bitBuff
+              bitBuffN:(int)bitBuffN
+blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+            imageWidth:(int)imageWidth
+           imageHeight:(int)imageHeight
+              blockDim:(int)blockDim
+             outBuffer:(uint8_t*)outBuffer
+          outRowStride:(int)outRowStride
+{
+    bool worked = Eliasg_decodeRegion(bitBuff, bitBuffN, blockStartBitOffsetsPtr,
+                                      imageWidth, imageHeight, blockDim,
+                                      regionX, regionY, regionWidth, regionHeight,
+                                      outBuffer, outRowStride);
+    return worked ? TRUE : FALSE;
+}
+
++ (BOOL) decodeToLayout:(int)layout
+                bitBuff:(uint8_t*)bitBuff
+               bitBuffN:(int)bitBuffN
+blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+             imageWidth:(int)imageWidth
+            imageHeight:(int)imageHeight
+               blockDim:(int)blockDim
+                 outPtr:(uint8_t*)outPtr
+           outRowStride:(int)outRowStride
+             numThreads:(int)numThreads
+{
+    bool worked = Eliasg_decodeToLayout(bitBuff, bitBuffN, blockStartBitOffsetsPtr,
+                                        imageWidth, imageHeight, blockDim,
+                                        (EliasOutputLayoutKind) layout, outPtr, outRowStride, numThreads);
+    return worked ? TRUE : FALSE;
+}
+
++ (void) benchmarkInterleaved:(const uint8_t*)symbols
+                   numSymbols:(int)numSymbols
+            numSymbolsInChunk:(int)numSymbolsInChunk
 {
-    Eliasg_decodeBlockSymbols(numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr);
+    Eliasg_benchmarkInterleaved(symbols, numSymbols, numSymbolsInChunk);
+}
+
++ (void) benchmarkRegion:(uint8_t*)bitBuff
+                bitBuffN:(int)bitBuffN
+ blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+              imageWidth:(int)imageWidth
+             imageHeight:(int)imageHeight
+                blockDim:(int)blockDim
+               viewWidth:(int)viewWidth
+              viewHeight:(int)viewHeight
+{
+    Eliasg_benchmarkRegion(bitBuff, bitBuffN, blockStartBitOffsetsPtr, imageWidth, imageHeight, blockDim, viewWidth, viewHeight);
+}
+
++ (void) benchmarkParallel:(uint8_t*)bitBuff
+                  bitBuffN:(int)bitBuffN
+   blockStartBitOffsetsPtr:(uint32_t*)blockStartBitOffsetsPtr
+        numSymbolsToDecode:(int)numSymbolsToDecode
+                  blockDim:(int)blockDim
+{
+    Eliasg_benchmarkParallel(bitBuff, bitBuffN, blockStartBitOffsetsPtr, numSymbolsToDecode, blockDim);
 }
 
 @end
 
+#endif // __OBJC__
+
 
 // Single byte clz table implementation with
 // special case for clz(0) -> 8 to support
@@ -429,6 +1559,19 @@ offset_to_num_neg(ushort value) {
     return ushort(valDiv2 * negOneIfOddOneIfEven);
 }
 
+// Convert positive deltas for one block back to signed byte values
+// in place, then apply each delta to the previous symbol and
+// constrain to byte range. The first delta in a block is from zero.
+// This is a separate stage run on symbols already extracted by an
+// entropy decoder, see EliasZerodDeltas.
+
+static inline
+void
+Eliasg_undoBlockDeltas(uint8_t *blockPtr, int numSymbolsInBlock)
+{
+    EliasZerodDeltas::undoDeltas(blockPtr, numSymbolsInBlock);
+}
+
 // Shader decode loop simulation that is able to decode
 // multiple symbols from a block by looking block start
 // offset up in a table. Note that this impl assumes
@@ -436,8 +1579,10 @@ offset_to_num_neg(ushort value) {
 // of huffBuff so that read ahead does not go past the
 // end of a buffer.
 
+template <int BlockDim>
+static
 void
-Eliasg_decodeBlockSymbols(
+Eliasg_decodeBlockSymbolsDim(
                                int numSymbolsToDecode,
                                uint8_t *bitBuff,
                                int bitBuffN,
@@ -455,7 +1600,7 @@ Eliasg_decodeBlockSymbols(
     
     int outOffseti = 0;
     
-    const int blockDim = 8;
+    const int blockDim = BlockDim;
     int blocki = 0;
     
     // Init first symbol to zero, will be reset to zero each time a block
@@ -614,4 +1759,1705 @@ Eliasg_decodeBlockSymbols(
     return;
 }
 
+bool
+Eliasg_decodeBlockSymbols(
+                               int numSymbolsToDecode,
+                               uint8_t *bitBuff,
+                               int bitBuffN,
+                               uint8_t *outBuffer,
+                               uint32_t *blockStartBitOffsetsPtr,
+                               int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Run the fragment shader render passes on the CPU with the pass
+// schedule, see EliasRenderPassEmulator. The cropped gray pixels are
+// written to outPixels and the bytes read and written by each pass are
+// returned in outStats. Returns false if the schedule does not decode
+// (blockDim * blockDim) symbols within the render target limit.
+
+bool
+Eliasg_emulateRenderPasses(
+                          const EliasRenderPassSchedule & schedule,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride,
+                          vector<EliasRenderPassStats> & outStats)
+{
+    uint8_t *outBlockSymbols = NULL;
+
+#if defined(DEBUG)
+    // The emulated passes must output the same block order symbols
+    // as the shader decode loop simulation
+    
+    const int numBlocks = ((width + blockDim - 1) / blockDim) * ((height + blockDim - 1) / blockDim);
+    const int numSymbols = numBlocks * (blockDim * blockDim);
+    vector<uint8_t> emulatedSymbols(numSymbols);
+    outBlockSymbols = emulatedSymbols.data();
+#endif // DEBUG
+    
+    bool worked = EliasRenderPassEmulator::decode(schedule,
+                                                  bitBuff,
+                                                  blockStartBitOffsetsPtr,
+                                                  width,
+                                                  height,
+                                                  blockDim,
+                                                  outPixels,
+                                                  outRowStride,
+                                                  outBlockSymbols,
+                                                  outStats);
+    
+#if defined(DEBUG)
+    if (worked) {
+        vector<uint8_t> expectedSymbols(numSymbols);
+        bool decoded = Eliasg_decodeBlockSymbols(numSymbols, bitBuff, bitBuffN, expectedSymbols.data(), blockStartBitOffsetsPtr, blockDim);
+        assert(decoded && emulatedSymbols == expectedSymbols);
+    }
+#else
+    (void) bitBuffN;
+#endif // DEBUG
+    
+    return worked;
+}
+
+// Optimized CPU block decode that reads each block with the 64 bit
+// refill decoder in EliasGammaDecoderOpt64 instead of gathering 3 bytes
+// for every symbol. The output is the same as Eliasg_decodeBlockSymbols.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsOpt64Dim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasGammaDecoderOpt64::decodeSymbols<true>(bitBuff,
+                                                                               bitBuffN,
+                                                                               blockStartBitOffsetsPtr[blocki],
+                                                                               numSymbolsInBlock,
+                                                                               blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+        
+        Eliasg_undoBlockDeltas(blockOutPtr, numSymbolsInBlock);
+    }
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsOpt64(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsOpt64Dim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// 16 bit symbol block decode with the 64 bit refill decoder, the output
+// is the block order symbols encoded by Eliasg_encodeImageBlocks16.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbols16Dim(
+                          int numSymbolsToDecode,
+                          const uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint16_t *outBuffer,
+                          const uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint16_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasGammaDecoderOpt64::decodeSymbols<true>(bitBuff,
+                                                                               bitBuffN,
+                                                                               blockStartBitOffsetsPtr[blocki],
+                                                                               numSymbolsInBlock,
+                                                                               blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+        
+        EliasZerodDeltas::undoDeltas(blockOutPtr, numSymbolsInBlock);
+    }
+    
+    return;
+}
 
+bool
+Eliasg_decodeBlockSymbols16(
+                          int numSymbolsToDecode,
+                          const uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint16_t *outBuffer,
+                          const uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbols16Dim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Table decode of the blocks in the range (startBlocki, endBlocki - 1),
+// each block is decoded starting from its own bit offset so that
+// ranges can be decoded independently.
+
+template <int BlockDim>
+static inline
+void
+Eliasg_decodeBlockRangeTable(
+                          int startBlocki,
+                          int endBlocki,
+                          int numBlocks,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    
+    for ( int blocki = startBlocki; blocki < endBlocki; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasGammaDecoderTable<>::decodeSymbols(bitBuff,
+                                                                           bitBuffN,
+                                                                           blockStartBitOffsetsPtr[blocki],
+                                                                           numSymbolsInBlock,
+                                                                           blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+        (void) numBlocks;
+        
+        Eliasg_undoBlockDeltas(blockOutPtr, numSymbolsInBlock);
+    }
+    
+    return;
+}
+
+// Optimized CPU block decode that looks up 11 bits at a time in a
+// multiple symbol table so that runs of short codes are decoded with
+// one lookup. The output is the same as Eliasg_decodeBlockSymbols.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsTableDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    Eliasg_decodeBlockRangeTable<BlockDim>(0, numBlocks, numBlocks, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr);
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsTable(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsTableDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Table decode where the start of each block is looked up in a two
+// level EliasBlockIndex instead of the flat 32 bit offset table.
+// The output is the same as Eliasg_decodeBlockSymbols.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsIndexedDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          const EliasBlockIndex & blockIndex)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasGammaDecoderTable<>::decodeSymbols(bitBuff,
+                                                                           bitBuffN,
+                                                                           blockIndex.blockBitOffset(blocki),
+                                                                           numSymbolsInBlock,
+                                                                           blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockIndex.blockBitOffset(blocki+1));
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+        
+        Eliasg_undoBlockDeltas(blockOutPtr, numSymbolsInBlock);
+    }
+    
+    return;
+}
+
+// Returns false if numSymbolsToDecode is not a whole number of blocks
+// or has more blocks than the index.
+
+bool
+Eliasg_decodeBlockSymbolsIndexed(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          const EliasBlockIndex & blockIndex)
+{
+    if (!EliasBlockIndex::isValidBlockDim(blockIndex.blockDim) || numSymbolsToDecode < 0) {
+        return false;
+    }
+    
+    const int numSymbolsInBlock = (int) (blockIndex.blockDim * blockIndex.blockDim);
+    
+    if ((numSymbolsToDecode % numSymbolsInBlock) != 0 ||
+        (unsigned int) (numSymbolsToDecode / numSymbolsInBlock) > blockIndex.numBlocks) {
+        return false;
+    }
+    
+    ELIASG_DISPATCH_BLOCK_DIM(blockIndex.blockDim, Eliasg_decodeBlockSymbolsIndexedDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockIndex));
+    
+    return true;
+}
+
+// Encode blocks with the Exp-Golomb order k (0, 3) that results in the
+// fewest bits for each block, see EliasExpGolomb.
+
+void
+Eliasg_encodeBlockSymbolsExpGolomb(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets)
+{
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    outBlockBitOffsets.clear();
+    
+    EliasExpGolomb::encodeBlocks(encoder, symbols, numSymbols, numSymbolsInBlock, outBlockBitOffsets);
+    
+    outCodes = std::move(encoder.bytes);
+}
+
+// Decode blocks encoded with a per block Exp-Golomb order, the header of
+// each block selects a decode kernel specialized for that order.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsExpGolombDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasExpGolomb::decodeBlock(bitBuff,
+                                                               bitBuffN,
+                                                               blockStartBitOffsetsPtr[blocki],
+                                                               numSymbolsInBlock,
+                                                               blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+        
+        Eliasg_undoBlockDeltas(blockOutPtr, numSymbolsInBlock);
+    }
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsExpGolomb(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsExpGolombDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Encode blocks with a mode header so that constant blocks are stored
+// as one pixel value and long runs of zero deltas as an escape and a
+// run length, see EliasGammaRunBlocks.
+
+void
+Eliasg_encodeBlockSymbolsRuns(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets)
+{
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    outBlockBitOffsets.clear();
+    
+    EliasGammaRunBlocks::encodeBlocks(encoder, symbols, numSymbols, numSymbolsInBlock, outBlockBitOffsets);
+    
+    outCodes = std::move(encoder.bytes);
+}
+
+// Decode blocks encoded with a mode header, constant blocks and zero
+// runs are filled with memset. Deltas are undone by decodeBlock.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsRunsDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasGammaRunBlocks::decodeBlock(bitBuff,
+                                                                    bitBuffN,
+                                                                    blockStartBitOffsetsPtr[blocki],
+                                                                    numSymbolsInBlock,
+                                                                    blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+    }
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsRuns(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsRunsDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Encode each block as elias gamma codes, 8 bit literal pixels or a
+// constant value, whichever is smallest. The mode of each block is in
+// the low 2 bits of its block entry, see EliasHybridBlocks. Returns
+// false if the bit offset of a block does not fit in an entry.
+
+bool
+Eliasg_encodeBlockSymbolsHybrid(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockEntries)
+{
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    outBlockEntries.clear();
+    
+    if (!EliasHybridBlocks::encodeBlocks(encoder, symbols, numSymbols, numSymbolsInBlock, outBlockEntries)) {
+        outBlockEntries.clear();
+        return false;
+    }
+    
+    outCodes = std::move(encoder.bytes);
+    
+    return true;
+}
+
+// Decode hybrid blocks, the mode in each block entry selects a memcpy
+// of literal pixels, a memset of a constant or a gamma decode.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsHybridDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockEntriesPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = EliasHybridBlocks::decodeBlock(bitBuff,
+                                                                  bitBuffN,
+                                                                  blockEntriesPtr[blocki],
+                                                                  numSymbolsInBlock,
+                                                                  blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            uint32_t nextEntry = blockEntriesPtr[blocki+1];
+            unsigned int numPaddingBits = 0;
+            if (EliasHybridBlocks::blockMode(nextEntry) == EliasHybridModeLiteral) {
+                numPaddingBits = EliasHybridBlocks::numLiteralPaddingBits(numBitsRead);
+            }
+            assert((numBitsRead + numPaddingBits) == EliasHybridBlocks::blockBitOffset(nextEntry));
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+    }
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsHybrid(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockEntriesPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsHybridDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockEntriesPtr));
+    
+    return true;
+}
+
+// Encode blocks of pixels in block order with the 2D predictor and
+// scan order that give the fewest bits for each block, the choice is
+// a 4 bit header at the start of the block, see EliasBlockPredictors.
+
+void
+Eliasg_encodeBlockSymbolsPredicted(
+                          const uint8_t *blockPixels,
+                          int numSymbols,
+                          int blockDim,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets)
+{
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitPaddingZeros = true;
+    encoder.emitMSB = true;
+    
+    outBlockBitOffsets.clear();
+    
+    EliasBlockPredictors predictors(blockDim);
+    predictors.encodeBlocks(encoder, blockPixels, numSymbols, outBlockBitOffsets);
+    
+    outCodes = std::move(encoder.bytes);
+}
+
+// Decode predicted blocks, the residuals of each block are table
+// decoded and then the mode header selects the reconstruction.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsPredictedDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    EliasBlockPredictors predictors(blockDim);
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint8_t *blockOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+        
+        unsigned int numBitsRead = predictors.decodeBlock(bitBuff,
+                                                          bitBuffN,
+                                                          blockStartBitOffsetsPtr[blocki],
+                                                          blockOutPtr);
+
+#if defined(DEBUG)
+        if ((blocki + 1) < numBlocks) {
+            assert(numBitsRead == blockStartBitOffsetsPtr[blocki+1]);
+        }
+#endif // DEBUG
+        (void) numBitsRead;
+    }
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsPredicted(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsPredictedDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Write MSB first codes that end with padding zeros and their block
+// offsets to a container file, see EliasContainer.
+
+bool
+Eliasg_writeContainerFile(
+                          const char *path,
+                          int width,
+                          int height,
+                          int blockDim,
+                          const uint8_t *codesPtr,
+                          int codesNumBytes,
+                          const uint32_t *blockBitOffsetsPtr,
+                          int numBlocks)
+{
+    EliasContainer container;
+    container.width = width;
+    container.height = height;
+    container.blockDim = blockDim;
+    container.bitOrder = EliasBitOrderMSB;
+    container.numBlocks = numBlocks;
+    
+    return container.writeFile(path, codesPtr, codesNumBytes, blockBitOffsetsPtr);
+}
+
+// Map a container file and table decode the block order symbols
+// directly from the mapping. Returns false if the file is not a valid
+// MSB first container or outBuffer is too small.
+
+bool
+Eliasg_decodeContainerFile(
+                          const char *path,
+                          uint8_t *outBuffer,
+                          int outBufferNumBytes)
+{
+    EliasContainerMapping mapping;
+    
+    if (!mapping.open(path)) {
+        return false;
+    }
+    
+    const EliasContainer & container = mapping.container;
+    
+    if (container.bitOrder != EliasBitOrderMSB || container.numSymbols() > (unsigned int) outBufferNumBytes) {
+        return false;
+    }
+    
+    // Decoders only read from the bitstream and offsets
+    
+    return Eliasg_decodeBlockSymbolsTable(container.numSymbols(),
+                                          (uint8_t *) mapping.codesPtr,
+                                          (int) container.codesNumBytes,
+                                          outBuffer,
+                                          (uint32_t *) mapping.blockBitOffsetsPtr,
+                                          container.blockDim);
+}
+
+// Copy the image into zero padded blocks of blockDim x blockDim pixels
+// in block order, the same order as the decoded block symbols.
+
+static
+void
+Eliasg_splitImageBlocks(
+                          const uint8_t *imageBytes,
+                          int width,
+                          int height,
+                          int blockDim,
+                          uint8_t *outBlockPixels)
+{
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    
+    for (int blockY = 0; blockY < numBlocksInHeight; blockY++) {
+        for (int blockX = 0; blockX < numBlocksInWidth; blockX++) {
+            const int x = blockX * blockDim;
+            const int y = blockY * blockDim;
+            const int numCols = min(blockDim, width - x);
+            const int numRows = min(blockDim, height - y);
+            
+            for (int row = 0; row < blockDim; row++) {
+                if (row < numRows) {
+                    memcpy(outBlockPixels, imageBytes + ((size_t)(y + row) * width) + x, numCols);
+                    memset(outBlockPixels + numCols, 0, blockDim - numCols);
+                } else {
+                    memset(outBlockPixels, 0, blockDim);
+                }
+                outBlockPixels += blockDim;
+            }
+        }
+    }
+}
+
+// Encode each frame as temporal block deltas against the previous frame
+// and append it to a sequence file, see EliasSequenceContainer. Only the
+// current and previous frame are held in block order.
+
+bool
+Eliasg_encodeSequenceFile(
+                          const char *path,
+                          const uint8_t * const *framePtrs,
+                          int numFrames,
+                          int width,
+                          int height,
+                          int blockDim)
+{
+    if (!EliasBlockIndex::isValidBlockDim(blockDim) || width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    EliasSequenceWriter writer;
+    
+    if (!writer.open(path, width, height, blockDim)) {
+        return false;
+    }
+    
+    const int numSymbolsInBlock = blockDim * blockDim;
+    const int numSymbols = writer.sequence.numSymbols();
+    
+    vector<uint8_t> blockPixels(numSymbols);
+    vector<uint8_t> prevBlockPixels(numSymbols);
+    vector<uint32_t> blockBitOffsets;
+    
+    for (int framei = 0; framei < numFrames; framei++) {
+        Eliasg_splitImageBlocks(framePtrs[framei], width, height, blockDim, blockPixels.data());
+        
+        EliasGammaEncoderOpt64 encoder;
+        encoder.emitPaddingZeros = true;
+        encoder.emitMSB = true;
+        
+        blockBitOffsets.clear();
+        
+        EliasTemporalBlocks::encodeFrame(encoder,
+                                         blockPixels.data(),
+                                         (framei == 0) ? NULL : prevBlockPixels.data(),
+                                         numSymbols,
+                                         numSymbolsInBlock,
+                                         blockBitOffsets);
+        
+        if (!writer.appendFrame(encoder.bytes.data(), encoder.bytes.size(), blockBitOffsets.data())) {
+            return false;
+        }
+        
+        blockPixels.swap(prevBlockPixels);
+    }
+    
+    return writer.finish();
+}
+
+// Map a sequence file and decode each frame in order by updating the
+// previous frame in place. frameSink gets the block order pixels of each
+// frame, the buffer is reused for the next frame. Returns false if the
+// file is not a valid sequence.
+
+bool
+Eliasg_decodeSequenceFile(
+                          const char *path,
+                          const std::function<void(int frameIndex, const uint8_t *blockPixels, int numSymbols)> & frameSink)
+{
+    EliasSequenceMapping mapping;
+    
+    if (!mapping.open(path)) {
+        return false;
+    }
+    
+    const EliasSequenceContainer & sequence = mapping.sequence;
+    const int numSymbols = sequence.numSymbols();
+    
+    vector<uint8_t> blockPixels(numSymbols);
+    
+    for (unsigned int framei = 0; framei < mapping.numFrames(); framei++) {
+        EliasTemporalBlocks::decodeFrame(mapping.codesPtr(framei),
+                                         (unsigned int) sequence.frames[framei].codesNumBytes,
+                                         mapping.groupBitOffsetsPtr(framei),
+                                         sequence.numBlocks,
+                                         sequence.groupShift,
+                                         sequence.blockDim * sequence.blockDim,
+                                         blockPixels.data());
+        
+        frameSink(framei, blockPixels.data(), numSymbols);
+    }
+    
+    return true;
+}
+
+// Split interleaved pixels into planes and encode each plane as its own
+// block stream with its own block bit offsets, see EliasPlanes. Planes
+// are encoded in parallel on the shared worker pool.
+
+void
+Eliasg_encodePlanes(
+                          const uint8_t *pixels,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          vector<vector<uint8_t> > & outPlaneCodes,
+                          vector<vector<uint32_t> > & outPlaneBlockBitOffsets)
+{
+    const int numPlanes = EliasPlanes::numPlanes(format);
+    const int numPixels = width * height;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    
+    vector<uint8_t> planeBytes((size_t)numPixels * numPlanes);
+    uint8_t *planes[EliasPlanes::maxNumPlanes];
+    
+    for (int planei = 0; planei < numPlanes; planei++) {
+        planes[planei] = planeBytes.data() + ((size_t)planei * numPixels);
+    }
+    
+    EliasPlanes::split(pixels, numPixels, format, transform, planes);
+    
+    outPlaneCodes.resize(numPlanes);
+    outPlaneBlockBitOffsets.resize(numPlanes);
+    
+    EliasWorkerPool::sharedPool().apply(numPlanes, [&](int planei) {
+        Eliasg_encodeImageBlocks(planes[planei],
+                                 width,
+                                 height,
+                                 blockDim,
+                                 numBlocksInWidth,
+                                 numBlocksInHeight,
+                                 outPlaneCodes[planei],
+                                 outPlaneBlockBitOffsets[planei],
+                                 NULL);
+    });
+}
+
+template <int BlockDim>
+static
+void
+Eliasg_decodePlanesDim(
+                          const uint8_t * const *planeCodesPtrs,
+                          const int *planeCodesNumBytes,
+                          const uint32_t * const *planeBlockBitOffsetsPtrs,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          uint8_t *outPixels,
+                          int outRowStride)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    const int numBlocks = numBlocksInWidth * numBlocksInHeight;
+    const int numPlanes = EliasPlanes::numPlanes(format);
+    const size_t numPlaneSymbols = (size_t)numBlocks * numSymbolsInBlock;
+    
+    vector<uint8_t> blockPlaneBytes(numPlaneSymbols * numPlanes);
+    
+    EliasWorkerPool & pool = EliasWorkerPool::sharedPool();
+    
+    pool.apply(numPlanes, [&](int planei) {
+        Eliasg_decodeBlockRangeTable<BlockDim>(0,
+                                               numBlocks,
+                                               numBlocks,
+                                               (uint8_t *) planeCodesPtrs[planei],
+                                               planeCodesNumBytes[planei],
+                                               blockPlaneBytes.data() + (planei * numPlaneSymbols),
+                                               (uint32_t *) planeBlockBitOffsetsPtrs[planei]);
+    });
+    
+    // Each row of blocks is deblocked, colour transformed and
+    // interleaved into the output rows in one pass
+    
+    pool.apply(numBlocksInHeight, [&](int blockY) {
+        const uint8_t *blockPlanes[EliasPlanes::maxNumPlanes];
+        const size_t blockRowOffset = (size_t)blockY * numBlocksInWidth * numSymbolsInBlock;
+        
+        for (int planei = 0; planei < numPlanes; planei++) {
+            blockPlanes[planei] = blockPlaneBytes.data() + (planei * numPlaneSymbols) + blockRowOffset;
+        }
+        
+        const int y = blockY * blockDim;
+        
+        EliasPlanes::mergeBlockRow<BlockDim>(blockPlanes,
+                                             width,
+                                             min(blockDim, height - y),
+                                             numBlocksInWidth,
+                                             format,
+                                             transform,
+                                             outPixels + ((size_t)y * outRowStride),
+                                             outRowStride);
+    });
+}
+
+// Decode each plane in parallel and write interleaved pixels with
+// outRowStride bytes per row, the inverse of Eliasg_encodePlanes.
+// Returns false if the image is empty or outRowStride is smaller than
+// a row of interleaved pixels.
+
+bool
+Eliasg_decodePlanes(
+                          const uint8_t * const *planeCodesPtrs,
+                          const int *planeCodesNumBytes,
+                          const uint32_t * const *planeBlockBitOffsetsPtrs,
+                          int width,
+                          int height,
+                          EliasPixelFormat format,
+                          EliasColorTransform transform,
+                          int blockDim,
+                          uint8_t *outPixels,
+                          int outRowStride)
+{
+    if (width <= 0 || height <= 0 ||
+        outRowStride < ((int64_t) width * EliasPlanes::numPlanes(format))) {
+        return false;
+    }
+    
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodePlanesDim, (planeCodesPtrs, planeCodesNumBytes, planeBlockBitOffsetsPtrs, width, height, format, transform, outPixels, outRowStride));
+    
+    return true;
+}
+
+// Table decode the blocks in rows (startBlockY, endBlockY - 1) of the
+// writer block range and hand each block of pixels to the writer, so
+// that pixels are stored in the output layout without a deblock pass.
+
+template <int BlockDim, class Writer>
+static inline
+void
+Eliasg_decodeBlockRowsToWriter(
+                          int startBlockY,
+                          int endBlockY,
+                          const Writer & writer,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numBlocksInWidth)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    
+    uint8_t blockPixels[numSymbolsInBlock];
+    
+    for ( int blockY = startBlockY; blockY < endBlockY; blockY++ ) {
+        for ( int blockX = writer.startBlockX; blockX < writer.endBlockX; blockX++ ) {
+            const int blocki = (blockY * numBlocksInWidth) + blockX;
+            
+            EliasGammaDecoderTable<>::decodeSymbols(bitBuff,
+                                                    bitBuffN,
+                                                    blockStartBitOffsetsPtr[blocki],
+                                                    numSymbolsInBlock,
+                                                    blockPixels);
+            
+            Eliasg_undoBlockDeltas(blockPixels, numSymbolsInBlock);
+            
+            writer.writeBlock(blockX, blockY, blockPixels);
+        }
+    }
+    
+    return;
+}
+
+// Decode the writer block range with block rows split evenly between
+// numThreads threads on the shared worker pool, 0 uses one thread for
+// each core.
+
+template <int BlockDim, class Writer>
+static
+void
+Eliasg_decodeToWriter(
+                          const Writer & writer,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numBlocksInWidth,
+                          int numThreads)
+{
+    const int numBlockRows = writer.endBlockY - writer.startBlockY;
+    
+    EliasWorkerPool & pool = EliasWorkerPool::sharedPool();
+    
+    if (numThreads == 0) {
+        numThreads = pool.concurrency();
+    }
+    if (numThreads > numBlockRows) {
+        numThreads = numBlockRows;
+    }
+    
+    if (numThreads <= 1) {
+        Eliasg_decodeBlockRowsToWriter<BlockDim>(writer.startBlockY, writer.endBlockY, writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth);
+        return;
+    }
+    
+    pool.apply(numThreads, [&](int rangei) {
+        const int startBlockY = writer.startBlockY + (int) (((int64_t) numBlockRows * rangei) / numThreads);
+        const int endBlockY = writer.startBlockY + (int) (((int64_t) numBlockRows * (rangei + 1)) / numThreads);
+        Eliasg_decodeBlockRowsToWriter<BlockDim>(startBlockY, endBlockY, writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth);
+    });
+    
+    return;
+}
+
+// Decode only the blocks that intersect the region and copy the cropped
+// pixels so that row r of the region starts at outPtr + (r * outRowStride).
+// Each block is decoded from its own bit offset, so the cost scales with
+// the region area instead of the image area. The region must already be
+// inside the image, only the width is needed to find the block offsets.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeRegionDim(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int regionX,
+                          int regionY,
+                          int regionWidth,
+                          int regionHeight,
+                          uint8_t *outPtr,
+                          int outRowStride)
+{
+    const int blockDim = BlockDim;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    
+    EliasRasterWriter<BlockDim> writer(outPtr, outRowStride, regionX, regionY, regionWidth, regionHeight);
+    
+    Eliasg_decodeBlockRowsToWriter<BlockDim>(writer.startBlockY, writer.endBlockY, writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth);
+    
+    return;
+}
+
+// Returns false if the region is empty, not inside the image, or
+// wider than outRowStride.
+
+bool
+Eliasg_decodeRegion(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int regionX,
+                          int regionY,
+                          int regionWidth,
+                          int regionHeight,
+                          uint8_t *outPtr,
+                          int outRowStride)
+{
+    if (regionX < 0 || regionY < 0 || regionWidth <= 0 || regionHeight <= 0 ||
+        (regionX + regionWidth) > width || (regionY + regionHeight) > height ||
+        outRowStride < regionWidth) {
+        return false;
+    }
+    
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeRegionDim, (bitBuff, bitBuffN, blockStartBitOffsetsPtr, width, regionX, regionY, regionWidth, regionHeight, outPtr, outRowStride));
+    
+    return true;
+}
+
+// Decode all blocks straight to an output layout, see elias_layout.hpp.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeToLayoutDim(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          EliasOutputLayoutKind layout,
+                          uint8_t *outPtr,
+                          int outRowStride,
+                          int numThreads)
+{
+    const int blockDim = BlockDim;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    
+    switch (layout) {
+        case EliasOutputLayoutRaster: {
+            EliasRasterWriter<BlockDim> writer(outPtr, outRowStride, 0, 0, width, height);
+            Eliasg_decodeToWriter<BlockDim>(writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth, numThreads);
+            break;
+        }
+        case EliasOutputLayoutSlices: {
+            EliasSliceWriter<BlockDim> writer(outPtr, outRowStride, numBlocksInWidth, numBlocksInHeight);
+            Eliasg_decodeToWriter<BlockDim>(writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth, numThreads);
+            break;
+        }
+        default: {
+            EliasMortonWriter<BlockDim> writer(outPtr, numBlocksInWidth, numBlocksInHeight);
+            Eliasg_decodeToWriter<BlockDim>(writer, bitBuff, bitBuffN, blockStartBitOffsetsPtr, numBlocksInWidth, numThreads);
+            break;
+        }
+    }
+    
+    return;
+}
+
+// Decode a width x height image to the raster, slices or morton layout
+// with numThreads threads, 0 uses one thread for each core. Returns false
+// if the layout is not known or outRowStride is smaller than
+// EliasOutputLayout::minRowStride(). The size of the output is
+// EliasOutputLayout::numBytes().
+
+bool
+Eliasg_decodeToLayout(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          EliasOutputLayoutKind layout,
+                          uint8_t *outPtr,
+                          int outRowStride,
+                          int numThreads)
+{
+    if (width <= 0 || height <= 0 || numThreads < 0 ||
+        (layout != EliasOutputLayoutRaster && layout != EliasOutputLayoutSlices && layout != EliasOutputLayoutMorton) ||
+        outRowStride < EliasOutputLayout::minRowStride(layout, width, blockDim)) {
+        return false;
+    }
+    
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeToLayoutDim, (bitBuff, bitBuffN, blockStartBitOffsetsPtr, width, height, layout, outPtr, outRowStride, numThreads));
+    
+    return true;
+}
+
+// SIMD CPU block decode where each vector lane decodes one block, the
+// instruction set is selected at runtime. Blocks that are not decoded
+// with SIMD, including all blocks when the CPU has no supported vector
+// unit, are table decoded. The output is the same as
+// Eliasg_decodeBlockSymbols.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsSIMDDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+    int endBlocki = 0;
+    
+    // The vector kernels are written for 8x8 blocks
+    
+    if (BlockDim == EliasGammaBlockDecoderSIMD::blockDim) {
+        endBlocki = EliasGammaBlockDecoderSIMD::decodeBlocks(EliasGammaBlockDecoderSIMD::level(),
+                                                         bitBuff,
+                                                         bitBuffN,
+                                                         blockStartBitOffsetsPtr,
+                                                         0,
+                                                         numBlocks,
+                                                         outBuffer);
+    }
+    
+    Eliasg_decodeBlockRangeTable<BlockDim>(endBlocki, numBlocks, numBlocks, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr);
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsSIMD(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsSIMDDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr));
+    
+    return true;
+}
+
+// Split blocks into numRanges contiguous ranges that each contain about
+// the same number of encoded bits. Decode time tracks the number of bits
+// more closely than the number of blocks, since flat blocks encode to
+// 1 bit per symbol while noisy blocks can be 10x larger. The range
+// boundaries are written to rangeStartBlocks as (numRanges + 1) values.
+// totalNumBits is 64 bit since a stream of bitBuffN bytes can be longer
+// than the uint32 bit offsets of its blocks.
+
+void
+Eliasg_partitionBlocksByBits(
+                          int numBlocks,
+                          uint64_t totalNumBits,
+                          const uint32_t *blockStartBitOffsetsPtr,
+                          int numRanges,
+                          int *rangeStartBlocks)
+{
+    const uint32_t *offsetsEnd = blockStartBitOffsetsPtr + numBlocks;
+    
+    rangeStartBlocks[0] = 0;
+    
+    for ( int rangei = 1; rangei < numRanges; rangei++ ) {
+        uint64_t splitBitOffset = (totalNumBits * rangei) / numRanges;
+        const uint32_t *splitPtr = std::lower_bound(blockStartBitOffsetsPtr, offsetsEnd, splitBitOffset);
+        int splitBlocki = (int) (splitPtr - blockStartBitOffsetsPtr);
+        
+        // Ranges never overlap, an empty range is possible when one
+        // block is larger than the per thread bit count.
+        
+        if (splitBlocki < rangeStartBlocks[rangei-1]) {
+            splitBlocki = rangeStartBlocks[rangei-1];
+        }
+        
+        rangeStartBlocks[rangei] = splitBlocki;
+    }
+    
+    rangeStartBlocks[numRanges] = numBlocks;
+    
+    return;
+}
+
+// Multi-threaded CPU block decode, blocks are split into one contiguous
+// range per thread with about the same number of encoded bits in each
+// range and then each range is table decoded on the shared worker pool.
+// Pass 0 as numThreads to use one thread for each core. The output is
+// the same as Eliasg_decodeBlockSymbols.
+
+template <int BlockDim>
+static
+void
+Eliasg_decodeBlockSymbolsParallelDim(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numThreads)
+{
+    const int blockDim = BlockDim;
+    const int numSymbolsInBlock = (blockDim * blockDim);
+    const int numBlocks = numSymbolsToDecode / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbolsToDecode % numSymbolsInBlock) == 0);
+    assert(numThreads >= 0);
+#endif // DEBUG
+    
+    EliasWorkerPool & pool = EliasWorkerPool::sharedPool();
+    
+    if (numThreads == 0) {
+        numThreads = pool.concurrency();
+    }
+    if (numThreads > numBlocks) {
+        numThreads = numBlocks;
+    }
+    
+    if (numThreads <= 1) {
+        Eliasg_decodeBlockRangeTable<BlockDim>(0, numBlocks, numBlocks, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr);
+        return;
+    }
+    
+    const uint64_t totalNumBits = (uint64_t) bitBuffN * 8;
+    
+    vector<int> rangeStartBlocks(numThreads + 1);
+    
+    Eliasg_partitionBlocksByBits(numBlocks, totalNumBits, blockStartBitOffsetsPtr, numThreads, rangeStartBlocks.data());
+    
+    pool.apply(numThreads, [&](int rangei) {
+        Eliasg_decodeBlockRangeTable<BlockDim>(rangeStartBlocks[rangei],
+                                     rangeStartBlocks[rangei+1],
+                                     numBlocks,
+                                     bitBuff,
+                                     bitBuffN,
+                                     outBuffer,
+                                     blockStartBitOffsetsPtr);
+    });
+    
+    return;
+}
+
+bool
+Eliasg_decodeBlockSymbolsParallel(
+                          int numSymbolsToDecode,
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint8_t *outBuffer,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numThreads,
+                          int blockDim)
+{
+    ELIASG_DISPATCH_BLOCK_DIM(blockDim, Eliasg_decodeBlockSymbolsParallelDim, (numSymbolsToDecode, bitBuff, bitBuffN, outBuffer, blockStartBitOffsetsPtr, numThreads));
+    
+    return true;
+}
+
+// MSB first encode of the blocks in the range (startBlocki, endBlocki - 1)
+// directly into bitBuff at the known bit offset of startBlocki. The first
+// output byte can share bits with the last block of the previous range,
+// so it is returned instead of written and the caller must OR it into
+// bitBuff once every range has been encoded. The last byte is written
+// since the following range never writes its own first byte.
+
+static inline
+uint8_t
+Eliasg_encodeBlockRange(
+                          const uint8_t *symbols,
+                          int numSymbolsInBlock,
+                          int startBlocki,
+                          int endBlocki,
+                          const uint32_t *blockStartBitOffsetsPtr,
+                          uint8_t *bitBuff)
+{
+    const EliasGammaCode *table = EliasGamma_codeTable(true);
+    
+    const uint32_t startBitOffset = blockStartBitOffsetsPtr[startBlocki];
+    uint8_t * const firstBytePtr = bitBuff + (startBitOffset >> 3);
+    uint8_t *outPtr = firstBytePtr;
+    uint8_t firstByte = 0;
+    
+    // Bits already used in the first byte are left as zeros in accum
+    
+    uint64_t accum = 0;
+    unsigned int accumNumBits = (startBitOffset & 0x7);
+    
+    const uint8_t *symbolsPtr = symbols + (startBlocki * numSymbolsInBlock);
+    const uint8_t *symbolsEndPtr = symbols + (endBlocki * numSymbolsInBlock);
+    
+    for ( ; symbolsPtr < symbolsEndPtr; symbolsPtr++ ) {
+        const EliasGammaCode & egc = table[*symbolsPtr];
+        accum |= ((uint64_t)egc.code) << (64 - accumNumBits - egc.bitWidth);
+        accumNumBits += egc.bitWidth;
+        
+        if (accumNumBits >= 32) {
+            uint32_t word = (uint32_t) (accum >> 32);
+            if (outPtr == firstBytePtr) {
+                firstByte = (uint8_t) (word >> 24);
+            } else {
+                outPtr[0] = (uint8_t) (word >> 24);
+            }
+            outPtr[1] = (uint8_t) (word >> 16);
+            outPtr[2] = (uint8_t) (word >> 8);
+            outPtr[3] = (uint8_t) word;
+            outPtr += 4;
+            accum <<= 32;
+            accumNumBits -= 32;
+        }
+    }
+    
+    for ( ; accumNumBits > 0; outPtr++ ) {
+        if (outPtr == firstBytePtr) {
+            firstByte = (uint8_t) (accum >> 56);
+        } else {
+            *outPtr = (uint8_t) (accum >> 56);
+        }
+        accum <<= 8;
+        accumNumBits = (accumNumBits > 8) ? (accumNumBits - 8) : 0;
+    }
+    
+    return firstByte;
+}
+
+// Two pass block encoder. The first pass sums the code widths of each
+// block and a prefix sum of the block widths gives the block start bit
+// offsets, so no per symbol offset table is needed. The second pass
+// encodes ranges of blocks with about the same number of bits in parallel,
+// each directly into its final bit position in the output. The output
+// is identical to the serial MSB encoder with zero padding enabled. Pass
+// 0 as numThreads to use one thread for each core. Returns false if the
+// codes do not fit in 2^32 bits, the limit of the uint32 block offsets.
+
+bool
+Eliasg_encodeBlockSymbolsParallel(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInBlock,
+                          vector<uint8_t> & outCodes,
+                          vector<uint32_t> & outBlockBitOffsets,
+                          int numThreads)
+{
+    const int numBlocks = numSymbols / numSymbolsInBlock;
+
+#if defined(DEBUG)
+    assert((numSymbols % numSymbolsInBlock) == 0);
+    assert(numThreads >= 0);
+#endif // DEBUG
+    
+    EliasWorkerPool & pool = EliasWorkerPool::sharedPool();
+    
+    if (numThreads == 0) {
+        numThreads = pool.concurrency();
+    }
+    if (numThreads > numBlocks) {
+        numThreads = numBlocks;
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    
+    // Pass 1 : number of bits in each block, split evenly by block count
+    
+    const EliasGammaCode *table = EliasGamma_codeTable(true);
+    
+    outBlockBitOffsets.resize(numBlocks);
+    uint32_t *blockOffsetsPtr = outBlockBitOffsets.data();
+    
+    pool.apply(numThreads, [&](int rangei) {
+        int startBlocki = (int) (((int64_t) numBlocks * rangei) / numThreads);
+        int endBlocki = (int) (((int64_t) numBlocks * (rangei + 1)) / numThreads);
+        
+        for ( int blocki = startBlocki; blocki < endBlocki; blocki++ ) {
+            const uint8_t *blockPtr = symbols + (blocki * numSymbolsInBlock);
+            uint32_t numBlockBits = 0;
+            for ( int i = 0; i < numSymbolsInBlock; i++ ) {
+                numBlockBits += table[blockPtr[i]].bitWidth;
+            }
+            blockOffsetsPtr[blocki] = numBlockBits;
+        }
+    });
+    
+    // Exclusive prefix sum converts block widths to block start offsets
+    
+    uint64_t totalNumBits = 0;
+    
+    for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+        uint32_t numBlockBits = blockOffsetsPtr[blocki];
+        blockOffsetsPtr[blocki] = (uint32_t) totalNumBits;
+        totalNumBits += numBlockBits;
+    }
+    
+    if (totalNumBits > 0xFFFFFFFF) {
+        outCodes.clear();
+        outBlockBitOffsets.clear();
+        return false;
+    }
+    
+    // Pass 2 : encode ranges with about the same number of bits, the
+    // output includes the two zero padding bytes of the serial encoder.
+    
+    const int numCodeBytes = (int) ((totalNumBits + 7) / 8);
+    
+    outCodes.assign(numCodeBytes + 2, 0);
+    uint8_t *bitBuff = outCodes.data();
+    
+    if (numBlocks == 0) {
+        return true;
+    }
+    
+    vector<int> rangeStartBlocks(numThreads + 1);
+    vector<uint8_t> rangeFirstBytes(numThreads);
+    
+    Eliasg_partitionBlocksByBits(numBlocks, totalNumBits, blockOffsetsPtr, numThreads, rangeStartBlocks.data());
+    
+    pool.apply(numThreads, [&](int rangei) {
+        int startBlocki = rangeStartBlocks[rangei];
+        int endBlocki = rangeStartBlocks[rangei+1];
+        if (startBlocki == endBlocki) {
+            return;
+        }
+        rangeFirstBytes[rangei] = Eliasg_encodeBlockRange(symbols,
+                                                          numSymbolsInBlock,
+                                                          startBlocki,
+                                                          endBlocki,
+                                                          blockOffsetsPtr,
+                                                          bitBuff);
+    });
+    
+    // Merge the first byte of each range with the bits already written
+    // by the previous range.
+    
+    for ( int rangei = 0; rangei < numThreads; rangei++ ) {
+        int startBlocki = rangeStartBlocks[rangei];
+        if (startBlocki == rangeStartBlocks[rangei+1]) {
+            continue;
+        }
+        bitBuff[blockOffsetsPtr[startBlocki] >> 3] |= rangeFirstBytes[rangei];
+    }
+    
+    return true;
+}
+
+// Seconds elapsed for the fastest of numRuns invocations of func
+
+template <typename F>
+static inline
+double Eliasg_bestTime(int numRuns, F func)
+{
+    double bestSeconds = 0.0;
+    
+    for (int runi = 0; runi < numRuns; runi++) {
+        auto startTime = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        if (runi == 0 || elapsed.count() < bestSeconds) {
+            bestSeconds = elapsed.count();
+        }
+    }
+    
+    return bestSeconds;
+}
+
+// Compare single stream decode speed to the interleaved 2, 4 and 8
+// stream formats for the same symbols, typically block order deltas
+// with one chunk for each block. Decode speed and encoded size are
+// printed for each format.
+
+void
+Eliasg_benchmarkInterleaved(
+                          const uint8_t *symbols,
+                          int numSymbols,
+                          int numSymbolsInChunk)
+{
+    const int numRuns = 10;
+    
+    vector<uint8_t> decoded;
+    
+    EliasGammaEncoderOpt64 encoder;
+    encoder.emitMSB = true;
+    encoder.emitPaddingZeros = true;
+    encoder.encode(symbols, numSymbols);
+    
+    {
+        EliasGammaDecoderOpt16 decoder;
+        double seconds = Eliasg_bestTime(numRuns, [&]() {
+            decoder.decode(encoder.bytes.data(), numSymbols, decoded);
+        });
+        assert(memcmp(decoded.data(), symbols, numSymbols) == 0);
+        printf("single Opt16    : %8d bytes : %7.1f Msym/s\n", (int)encoder.bytes.size(), numSymbols / seconds / 1e6);
+    }
+    
+    {
+        EliasGammaDecoderOpt64 decoder;
+        double seconds = Eliasg_bestTime(numRuns, [&]() {
+            decoder.decode(encoder.bytes.data(), (unsigned int)encoder.bytes.size(), numSymbols, decoded);
+        });
+        assert(memcmp(decoded.data(), symbols, numSymbols) == 0);
+        printf("single Opt64    : %8d bytes : %7.1f Msym/s\n", (int)encoder.bytes.size(), numSymbols / seconds / 1e6);
+    }
+    
+    for ( int numStreams = 1; numStreams <= 8; numStreams *= 2 ) {
+        EliasGammaInterleavedEncoder interleavedEncoder;
+        interleavedEncoder.numStreams = numStreams;
+        interleavedEncoder.numSymbolsInChunk = numSymbolsInChunk;
+        interleavedEncoder.encode(symbols, numSymbols);
+        
+        EliasGammaInterleavedDecoder decoder;
+        double seconds = Eliasg_bestTime(numRuns, [&]() {
+            decoder.decode(interleavedEncoder.bytes.data(), (unsigned int)interleavedEncoder.bytes.size(), decoded);
+        });
+        assert(memcmp(decoded.data(), symbols, numSymbols) == 0);
+        printf("interleaved x%d : %8d bytes : %7.1f Msym/s\n", numStreams, (int)interleavedEncoder.bytes.size(), numSymbols / seconds / 1e6);
+    }
+    
+    return;
+}
+
+// Pan a viewport of viewWidth x viewHeight pixels diagonally across the
+// image and compare region decode of each view to a full image decode
+// followed by a crop. Time per view and the decoded pixel rate are printed.
+
+void
+Eliasg_benchmarkRegion(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int width,
+                          int height,
+                          int blockDim,
+                          int viewWidth,
+                          int viewHeight)
+{
+    const int numRuns = 5;
+    const int numViews = 32;
+    const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+    const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+    const int numSymbols = (numBlocksInWidth * numBlocksInHeight) * (blockDim * blockDim);
+    
+    viewWidth = min(viewWidth, width);
+    viewHeight = min(viewHeight, height);
+    
+    vector<uint8_t> viewPixels((size_t)viewWidth * viewHeight);
+    vector<uint8_t> blockPixels(numSymbols);
+    
+    if (!Eliasg_decodeBlockSymbolsTable(numSymbols, bitBuff, bitBuffN, blockPixels.data(), blockStartBitOffsetsPtr, blockDim)) {
+        return;
+    }
+    
+    double fullSeconds = Eliasg_bestTime(numRuns, [&]() {
+        Eliasg_decodeBlockSymbolsTable(numSymbols, bitBuff, bitBuffN, blockPixels.data(), blockStartBitOffsetsPtr, blockDim);
+    });
+    
+    double regionSeconds = Eliasg_bestTime(numRuns, [&]() {
+        for ( int viewi = 0; viewi < numViews; viewi++ ) {
+            int x = (int) (((int64_t) (width - viewWidth) * viewi) / (numViews - 1));
+            int y = (int) (((int64_t) (height - viewHeight) * viewi) / (numViews - 1));
+            Eliasg_decodeRegion(bitBuff, bitBuffN, blockStartBitOffsetsPtr, width, height, blockDim,
+                                x, y, viewWidth, viewHeight, viewPixels.data(), viewWidth);
+        }
+    }) / numViews;
+    
+    printf("full decode     : %8.3f ms : %7.1f Mpix/s\n", fullSeconds * 1e3, (width * (double)height) / fullSeconds / 1e6);
+    printf("region %4dx%-4d : %8.3f ms : %7.1f Mpix/s : %.1fx faster per view\n", viewWidth, viewHeight, regionSeconds * 1e3, (viewWidth * (double)viewHeight) / regionSeconds / 1e6, fullSeconds / regionSeconds);
+    
+    return;
+}
+
+// Print the scaling curve of Eliasg_decodeBlockSymbolsParallel with one
+// line for each thread count from 1 to the number of hardware cores.
+
+void
+Eliasg_benchmarkParallel(
+                          uint8_t *bitBuff,
+                          int bitBuffN,
+                          uint32_t *blockStartBitOffsetsPtr,
+                          int numSymbolsToDecode,
+                          int blockDim)
+{
+    const int numRuns = 5;
+    const int numCores = max(1, (int) std::thread::hardware_concurrency());
+    
+    vector<uint8_t> decoded(numSymbolsToDecode);
+    
+    if (!Eliasg_decodeBlockSymbolsParallel(numSymbolsToDecode, bitBuff, bitBuffN, decoded.data(), blockStartBitOffsetsPtr, 1, blockDim)) {
+        return;
+    }
+    
+    double oneThreadSeconds = 0.0;
+    
+    for ( int numThreads = 1; numThreads <= numCores; numThreads++ ) {
+        double seconds = Eliasg_bestTime(numRuns, [&]() {
+            Eliasg_decodeBlockSymbolsParallel(numSymbolsToDecode, bitBuff, bitBuffN, decoded.data(), blockStartBitOffsetsPtr, numThreads, blockDim);
+        });
+        if (numThreads == 1) {
+            oneThreadSeconds = seconds;
+        }
+        printf("parallel x%-3d   : %8.3f ms : %7.1f Msym/s : %.2fx speedup\n", numThreads, seconds * 1e3, numSymbolsToDecode / seconds / 1e6, oneThreadSeconds / seconds);
+    }
+    
+    return;
+}
@@ -4,11 +4,15 @@
 #ifndef HuffLookupSymbol_hpp
 #define HuffLookupSymbol_hpp
 
+#include <stdint.h>
+
 typedef struct {
   uint8_t symbol;
   uint8_t bitWidth;
 } VariableBitWidthSymbol;
 
+#if defined(__APPLE__)
 #include "AAPLShaderTypes.h"
+#endif // __APPLE__
 
 #endif // HuffLookupSymbol_hpp
@@ -11,6 +11,7 @@
 #define elias_hpp
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <cinttypes>
@@ -134,15 +135,16 @@ class EliasGammaEncoder
     
     // Find the highest bit position that is on, return -1 when no on bit is found.
     // Note that this method cannot process the value zero and it supports the
-    // range (1, 256) which corresponds to bit positions (0, 8) or 9 bits max,
+    // range (1, 65536) which corresponds to bit positions (0, 16) or 17 bits max,
+    // so that both 8 bit and 16 bit symbols can be encoded.
     
     int highBitPosition(uint32_t number) {
         int highBitValue = -1;
         
-        // The maximum value that is acceptable is 256 or 2^8
-        // which falls outside the first byte.
+        // The maximum value that is acceptable is 65536 or 2^16
+        // which falls outside the first two bytes.
         
-        for (int i = 0; i < 9; i++) {
+        for (int i = 0; i < 17; i++) {
             if ((number >> i) & 0x1) {
                 highBitValue = i;
             }
@@ -156,7 +158,7 @@ class EliasGammaEncoder
 #if defined(DEBUG)
         // Verify that this result matches EliasGamma_bitWidth() output
         // by passing the original input numer.
-        {
+        if (number <= 256) {
             int bitWidth = (highBitValue * 2) + 1;
             int originalNumber = number - 1;
             int expectedBitWidth = EliasGamma_bitWidth(originalNumber);
@@ -171,6 +173,14 @@ class EliasGammaEncoder
     // elias gamma encoding that implicitly adds 1 before encoding.
     
     void encode(uint8_t inByteNumber)
+    {
+        encodeNumber(((uint32_t) inByteNumber) + 1);
+    }
+    
+    // Encode the number (1, 65536) of a symbol that has already
+    // been adjusted by adding 1.
+    
+    void encodeNumber(uint32_t number)
     {
         const bool debug = false;
         
@@ -181,10 +191,7 @@ class EliasGammaEncoder
         
         // The input value range is (0, 255) corresponding to (1, 256)
         // but since 0 is unused and 256 cannot be represented as uint8_t
-        // always implicitly add 1 before encoding.
-        
-        uint32_t number = inByteNumber;
-        number += 1;
+        // the caller implicitly adds 1 before encoding.
         
         // highBitValue is set to highest POT (bit that is on) in unsigned number n
         // Encode highBitValue in unary; that is, as N zeroes followed by a one.
@@ -276,6 +283,15 @@ class EliasGammaEncoder
         finish();
     }
     
+    // Encode N 16 bit symbols (0, 65535) and emit any leftover bits
+    
+    void encode(const uint16_t * symbols, int numSymbols) {
+        for (int i = 0; i < numSymbols; i++) {
+            encodeNumber(((uint32_t) symbols[i]) + 1);
+        }
+        finish();
+    }
+    
     // Query number of bits needed to store symbol
     // with the given k parameter. Note that this
     // size query logic does not need to actually copy
@@ -308,6 +324,308 @@ class EliasGammaEncoder
     
 };
 
+// Precomputed elias gamma code for each byte symbol. The code
+// bits are right justified in code and bitWidth is in the range
+// (1, 17). The MSB table stores the code bits in stream order
+// from the most significant bit, the LSB table stores the same
+// code with the bits reversed so that the first bit in the
+// stream is the least significant bit of code.
+
+typedef struct {
+    uint32_t code;
+    uint32_t bitWidth;
+} EliasGammaCode;
+
+class EliasGammaCodeTables
+{
+    public:
+    EliasGammaCode msbTable[256];
+    EliasGammaCode lsbTable[256];
+    
+    EliasGammaCodeTables() {
+        for (int symbol = 0; symbol < 256; symbol++) {
+            // Elias gamma code of (symbol + 1) is highBitPosition zeros
+            // followed by the binary digits of the number, so the
+            // numeric value of the MSB code is the number itself.
+            
+            uint32_t number = symbol + 1;
+            uint32_t bitWidth = EliasGamma_bitWidth(symbol);
+            
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < bitWidth; i++) {
+                uint32_t bit = (number >> (bitWidth - 1 - i)) & 0x1;
+                reversed |= (bit << i);
+            }
+            
+            msbTable[symbol].code = number;
+            msbTable[symbol].bitWidth = bitWidth;
+            lsbTable[symbol].code = reversed;
+            lsbTable[symbol].bitWidth = bitWidth;
+        }
+    }
+};
+
+// Tables are generated once on first use, static init is thread safe.
+
+static inline
+const EliasGammaCode *
+EliasGamma_codeTable(bool emitMSB)
+{
+    static const EliasGammaCodeTables tables;
+    return emitMSB ? tables.msbTable : tables.lsbTable;
+}
+
+// Properties of the symbol type an encoder or decoder is instantiated
+// with. The code for symbol S is the elias gamma code of (S + 1), so
+// a 16 bit symbol has up to 16 leading zeros and a 33 bit code. Byte
+// symbols use the precomputed code table, 16 bit symbols calculate the
+// code with a clz since a table would be 65536 entries. Only MSB first
+// codes are supported for 16 bit symbols, the code value of a 33 bit
+// LSB code would not fit in 32 bits.
+
+template <typename T>
+class EliasGammaSymbol;
+
+template <>
+class EliasGammaSymbol<uint8_t>
+{
+    public:
+    
+    static const unsigned int maxCountOfZeros = 8;
+    static const unsigned int maxBitsPerSymbol = (maxCountOfZeros * 2) + 1;
+    
+    static inline
+    int bitWidth(uint8_t symbol) {
+        return EliasGamma_bitWidth(symbol);
+    }
+    
+    static inline
+    EliasGammaCode codeMSB(uint8_t symbol) {
+        return EliasGamma_codeTable(true)[symbol];
+    }
+};
+
+template <>
+class EliasGammaSymbol<uint16_t>
+{
+    public:
+    
+    static const unsigned int maxCountOfZeros = 16;
+    static const unsigned int maxBitsPerSymbol = (maxCountOfZeros * 2) + 1;
+    
+    static inline
+    int bitWidth(uint16_t symbol) {
+        unsigned int highBitPosition = 31 - __builtin_clz(((unsigned int)symbol) + 1);
+        return (highBitPosition * 2) + 1;
+    }
+    
+    static inline
+    EliasGammaCode codeMSB(uint16_t symbol) {
+        EliasGammaCode egc;
+        egc.code = ((uint32_t)symbol) + 1;
+        egc.bitWidth = bitWidth(symbol);
+        return egc;
+    }
+};
+
+// This optimized encoder generates output that is byte identical to
+// EliasGammaEncoder for the same emitMSB and emitPaddingZeros settings.
+// Each symbol is looked up in a precomputed code table and OR'ed into
+// a 64 bit accumulator, then 32 bits are flushed at a time into an
+// output buffer that is presized before encoding begins. Since a code
+// is at most 17 bits, flushing whenever 32 bits are pending means the
+// accumulator never holds more than 48 bits. A 33 bit code for a 16 bit
+// symbol fills the accumulator to at most 64 bits.
+
+class EliasGammaEncoderOpt64
+{
+    public:
+    vector<uint8_t> bytes;
+    unsigned int numEncodedBits;
+    bool emitPaddingZeros;
+    bool emitMSB;
+    
+    // MSB : pending bits are left justified at bit 63
+    // LSB : pending bits are right justified at bit 0
+    uint64_t accum;
+    unsigned int accumNumBits;
+    
+    // Write offset into bytes, the vector is presized so that
+    // bytes.size() can be larger than the number of written bytes.
+    unsigned int byteOffset;
+    
+    EliasGammaEncoderOpt64()
+    : numEncodedBits(0), emitPaddingZeros(false), emitMSB(false), accum(0), accumNumBits(0), byteOffset(0) {
+    }
+    
+    void reset() {
+        bytes.clear();
+        numEncodedBits = 0;
+        accum = 0;
+        accumNumBits = 0;
+        byteOffset = 0;
+    }
+    
+    // Grow the output buffer so that numSymbols more symbols of
+    // the maximum 17 bit width can be written without a resize.
+    
+    void reserveSymbols(unsigned int numSymbols, unsigned int maxBitsPerSymbol = 17) {
+        // 4 bytes of slack accounts for a flush of 32 pending bits
+        size_t maxNumBytes = byteOffset + (((size_t)numSymbols * maxBitsPerSymbol) / 8) + 4 + 4;
+        if (bytes.size() < maxNumBytes) {
+            bytes.resize(maxNumBytes);
+        }
+    }
+    
+    // Flush 32 bits from the accumulator as 4 bytes
+    
+    inline
+    void flushWord() {
+        uint8_t *outPtr = bytes.data() + byteOffset;
+        
+        if (emitMSB) {
+            uint32_t word = (uint32_t) (accum >> 32);
+            outPtr[0] = (uint8_t) (word >> 24);
+            outPtr[1] = (uint8_t) (word >> 16);
+            outPtr[2] = (uint8_t) (word >> 8);
+            outPtr[3] = (uint8_t) word;
+            accum <<= 32;
+        } else {
+            uint32_t word = (uint32_t) accum;
+            outPtr[0] = (uint8_t) word;
+            outPtr[1] = (uint8_t) (word >> 8);
+            outPtr[2] = (uint8_t) (word >> 16);
+            outPtr[3] = (uint8_t) (word >> 24);
+            accum >>= 32;
+        }
+        
+        byteOffset += 4;
+        accumNumBits -= 32;
+    }
+    
+    // Encode a symbol with a code from the table, the caller must
+    // have already reserved enough space in bytes.
+    
+    inline
+    void encodeCode(const EliasGammaCode & egc) {
+        if (emitMSB) {
+            accum |= ((uint64_t)egc.code) << (64 - accumNumBits - egc.bitWidth);
+        } else {
+            accum |= ((uint64_t)egc.code) << accumNumBits;
+        }
+        accumNumBits += egc.bitWidth;
+        numEncodedBits += egc.bitWidth;
+        
+        if (accumNumBits >= 32) {
+            flushWord();
+        }
+    }
+    
+    // Encode unsigned byte range number (0, 255), note that the
+    // output buffer is resized as needed when invoked directly.
+    
+    void encode(uint8_t inByteNumber)
+    {
+        const EliasGammaCode *table = EliasGamma_codeTable(emitMSB);
+        
+        if (bytes.size() < (byteOffset + 8)) {
+            reserveSymbols(1024);
+        }
+        
+        encodeCode(table[inByteNumber]);
+    }
+    
+    // If any bits still need to be emitted, emit final bytes
+    // that are zero padded out to a whole byte.
+    
+    void finish() {
+        reserveSymbols(0);
+        
+        uint8_t *outPtr = bytes.data() + byteOffset;
+        
+        while (accumNumBits > 0) {
+            if (emitMSB) {
+                *outPtr++ = (uint8_t) (accum >> 56);
+                accum <<= 8;
+            } else {
+                *outPtr++ = (uint8_t) accum;
+                accum >>= 8;
+            }
+            byteOffset += 1;
+            accumNumBits = (accumNumBits > 8) ? (accumNumBits - 8) : 0;
+        }
+        
+        accum = 0;
+        
+        bytes.resize(byteOffset);
+        
+        // Emit two addition bytes that contain all zeros
+        // so that any byte read can always read 2 bytes ahead
+        // without going past the end of the valid buffer.
+        
+        if (emitPaddingZeros) {
+            bytes.push_back(0);
+            bytes.push_back(0);
+        }
+    }
+    
+    // Discard the whole bytes written so far, a streaming caller hands
+    // bytes (0, byteOffset) to a sink and then drains so that the same
+    // buffer is reused. Pending bits and numEncodedBits are kept.
+    
+    void drain() {
+        byteOffset = 0;
+    }
+    
+    // Encode N symbols and emit any leftover bits
+    
+    void encode(const uint8_t * byteVals, int numByteVals) {
+        const EliasGammaCode *table = EliasGamma_codeTable(emitMSB);
+        
+        reserveSymbols(numByteVals);
+        
+        for (int i = 0; i < numByteVals; i++) {
+            uint8_t byteVal = byteVals[i];
+            encodeCode(table[byteVal]);
+        }
+        finish();
+    }
+    
+    // Encode N 8 or 16 bit symbols MSB first without finishing, the
+    // output buffer is grown for the widest code of the symbol type.
+    
+    template <typename T>
+    void encodeSymbols(const T * symbols, int numSymbols) {
+#if defined(DEBUG)
+        assert(emitMSB);
+#endif // DEBUG
+        
+        reserveSymbols(numSymbols, EliasGammaSymbol<T>::maxBitsPerSymbol);
+        
+        for (int i = 0; i < numSymbols; i++) {
+            encodeCode(EliasGammaSymbol<T>::codeMSB(symbols[i]));
+        }
+    }
+    
+    // Query number of bits needed to store symbol
+    
+    int numBits(uint8_t inByteNumber) {
+        return EliasGamma_bitWidth(inByteNumber);
+    }
+    
+    // Query the number of bits needed to store these symbols
+    
+    int numBits(const uint8_t * byteVals, int numByteVals) {
+        int numBitsTotal = 0;
+        for (int i = 0; i < numByteVals; i++) {
+            uint8_t byteVal = byteVals[i];
+            numBitsTotal += numBits(byteVal);
+        }
+        return numBitsTotal;
+    }
+    
+};
+
 class EliasGammaDecoder
 {
     public:
@@ -427,7 +745,8 @@ class EliasGammaDecoder
 // be zero. The optimization is that since the special case can be
 // detected by a 16 bit buffer that contains 0x0100. This means the
 // 17th bit need not be read and so the entire test can be done with
-// a 16 bit register.
+// a 16 bit register. Only 8 bit symbols can be decoded, use
+// EliasGammaDecoderOpt64 for 16 bit symbols.
 
 class EliasGammaDecoderOpt16
 {
@@ -551,4 +870,355 @@ class EliasGammaDecoderOpt16
     
 };
 
+// Unaligned 64 bit loads from a byte stream. A big endian load
+// places the first byte in the most significant bits of the
+// register, a little endian load places it in the least.
+
+static inline
+uint64_t EliasGamma_load64BE(const uint8_t *bytePtr)
+{
+    uint64_t word;
+    memcpy(&word, bytePtr, sizeof(word));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return word;
+#else
+    return __builtin_bswap64(word);
+#endif
+}
+
+static inline
+uint64_t EliasGamma_load64LE(const uint8_t *bytePtr)
+{
+    uint64_t word;
+    memcpy(&word, bytePtr, sizeof(word));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return __builtin_bswap64(word);
+#else
+    return word;
+#endif
+}
+
+// Reverse the order of the low 9 bits in a value, this is used to
+// recover the number from a code stored LSB first in the stream.
+
+class EliasGammaReverse9Table
+{
+    public:
+    uint16_t table[512];
+    
+    EliasGammaReverse9Table() {
+        for (int i = 0; i < 512; i++) {
+            uint16_t reversed = 0;
+            for (int b = 0; b < 9; b++) {
+                if ((i >> b) & 0x1) {
+                    reversed |= (0x1 << (8 - b));
+                }
+            }
+            table[i] = reversed;
+        }
+    }
+};
+
+static inline
+const uint16_t *
+EliasGamma_reverse9Table()
+{
+    static const EliasGammaReverse9Table reverse9;
+    return reverse9.table;
+}
+
+// This optimized decoder keeps a 64 bit register of stream bits that
+// is refilled with a single unaligned 64 bit load. After a refill at
+// least 57 bits are valid and since each symbol is at most 17 bits,
+// every refill serves 3 or more symbols. A MSB first stream is decoded
+// with a count of leading zeros on the whole register while a LSB
+// first stream (EliasGammaEncoder with emitMSB = false) is decoded
+// with a count of trailing zeros.
+//
+// The symbol type is a template argument. A 16 bit symbol has a code
+// of up to 33 bits, which still fits in the 57 valid bits after a
+// refill, so the same register decodes either width and the 8 bit
+// instantiation is unchanged. 16 bit symbols must be MSB first.
+//
+// Unlike EliasGammaDecoderOpt16, the number of encoded bytes must be
+// passed so that refills near the end of the buffer do not read past
+// the end. Refills that would cross the end fall back to a byte copy.
+
+class EliasGammaDecoderOpt64
+{
+    public:
+    bool isMSB;
+    
+    EliasGammaDecoderOpt64()
+    : isMSB(true)
+    {
+    }
+    
+    // Load 64 bits starting at bit offset, returns the number of
+    // valid bits in the register which is in the range (57, 64).
+    
+    template <bool MSB>
+    static inline
+    unsigned int refill(const uint8_t * encodedBitsPtr,
+                        const unsigned int numEncodedBytes,
+                        const unsigned int bitOffset,
+                        uint64_t & bits)
+    {
+        const unsigned int byteOffset = bitOffset >> 3;
+        const unsigned int bitOffsetMod8 = bitOffset & 0x7;
+        
+        uint64_t word;
+        
+        if ((byteOffset + 8) <= numEncodedBytes) {
+            word = MSB ? EliasGamma_load64BE(encodedBitsPtr + byteOffset) : EliasGamma_load64LE(encodedBitsPtr + byteOffset);
+        } else {
+            uint8_t tail[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            for (unsigned int i = 0; (byteOffset + i) < numEncodedBytes && i < 8; i++) {
+                tail[i] = encodedBitsPtr[byteOffset + i];
+            }
+            word = MSB ? EliasGamma_load64BE(tail) : EliasGamma_load64LE(tail);
+        }
+        
+        if (MSB) {
+            bits = word << bitOffsetMod8;
+        } else {
+            bits = word >> bitOffsetMod8;
+        }
+        
+        return 64 - bitOffsetMod8;
+    }
+    
+    // Decode one symbol from the register and consume its bits.
+    // Note that the count of zeros is limited to 8 (16 for 16 bit
+    // symbols) so that an invalid stream of all zeros cannot shift
+    // past 64 bits.
+    
+    template <bool MSB, typename T = uint8_t>
+    static inline
+    T decodeSymbol(uint64_t & bits, unsigned int & bitsThisSymbol)
+    {
+        static_assert(MSB || sizeof(T) == 1, "LSB first streams only support 8 bit symbols");
+        
+        const unsigned int maxCountOfZeros = EliasGammaSymbol<T>::maxCountOfZeros;
+        unsigned int countOfZeros;
+        unsigned int number;
+        
+        if (MSB) {
+            countOfZeros = __builtin_clzll(bits | (0x1ULL << (63 - maxCountOfZeros)));
+            bitsThisSymbol = (countOfZeros << 1) + 1;
+            number = (unsigned int) (bits >> (64 - bitsThisSymbol));
+            bits <<= bitsThisSymbol;
+        } else {
+            countOfZeros = __builtin_ctzll(bits | (0x1ULL << 8));
+            bitsThisSymbol = (countOfZeros << 1) + 1;
+            unsigned int reversed = (unsigned int) (bits >> countOfZeros) & ((0x1 << (countOfZeros + 1)) - 1);
+            number = EliasGamma_reverse9Table()[reversed] >> (8 - countOfZeros);
+            bits >>= bitsThisSymbol;
+        }
+
+#if defined(DEBUG)
+        assert(number >= 1 && number <= (0x1U << maxCountOfZeros));
+#endif // DEBUG
+        
+        return (T) (number - 1);
+    }
+    
+    // Decode numSymbols starting at bitOffset and write to decodedBytesPtr,
+    // returns the bit offset just after the last decoded symbol.
+    
+    template <bool MSB, typename T = uint8_t>
+    static
+    unsigned int decodeSymbols(const uint8_t * encodedBitsPtr,
+                               const unsigned int numEncodedBytes,
+                               unsigned int bitOffset,
+                               unsigned int numSymbols,
+                               T * decodedBytesPtr)
+    {
+        const unsigned int maxBitsPerSymbol = EliasGammaSymbol<T>::maxBitsPerSymbol;
+        
+        while (numSymbols > 0) {
+            uint64_t bits;
+            unsigned int numBitsValid = refill<MSB>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+            
+            // Decode symbols until the register may not contain a whole symbol
+            
+            do {
+                unsigned int bitsThisSymbol;
+                *decodedBytesPtr++ = decodeSymbol<MSB, T>(bits, bitsThisSymbol);
+                bitOffset += bitsThisSymbol;
+                numBitsValid -= bitsThisSymbol;
+                numSymbols -= 1;
+            } while (numSymbols > 0 && numBitsValid >= maxBitsPerSymbol);
+        }
+        
+        return bitOffset;
+    }
+    
+    unsigned int decode(const uint8_t * encodedBitsPtr,
+                        const unsigned int numEncodedBytes,
+                        unsigned int bitOffset,
+                        unsigned int numSymbols,
+                        uint8_t * decodedBytesPtr)
+    {
+        if (isMSB) {
+            return decodeSymbols<true>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbols, decodedBytesPtr);
+        } else {
+            return decodeSymbols<false>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbols, decodedBytesPtr);
+        }
+    }
+    
+    // Decode a known number of symbols from the start of the buffer
+    
+    void decode(const uint8_t * encodedBitsPtr,
+                const unsigned int numEncodedBytes,
+                unsigned int numSymbols,
+                vector<uint8_t> & outBytesVec)
+    {
+        if (outBytesVec.size() != numSymbols) {
+            outBytesVec.resize(numSymbols);
+        }
+        decode(encodedBitsPtr, numEncodedBytes, 0, numSymbols, outBytesVec.data());
+    }
+    
+};
+
+// Multiple symbol decode table indexed by the next TableNumBits bits of
+// a MSB first stream. Each entry contains up to 8 symbols that are fully
+// contained in the window along with the total number of bits used by
+// those symbols. An entry with zero symbols indicates that the first code
+// is longer than the window and must be decoded with clz. Symbols are
+// stored in output byte order so that all 8 can be written with one store.
+
+typedef struct {
+    uint64_t symbols;
+    uint32_t numSymbols;
+    uint32_t numBits;
+} EliasGammaMultiSymbolEntry;
+
+template <unsigned int TableNumBits>
+class EliasGammaMultiSymbolTable
+{
+    public:
+    static const unsigned int maxSymbolsPerEntry = 8;
+    
+    EliasGammaMultiSymbolEntry entries[1 << TableNumBits];
+    
+    EliasGammaMultiSymbolTable() {
+        for (unsigned int window = 0; window < (1 << TableNumBits); window++) {
+            uint8_t symbols[maxSymbolsPerEntry] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            unsigned int numSymbols = 0;
+            unsigned int numBitsUsed = 0;
+            
+            while (numSymbols < maxSymbolsPerEntry) {
+                // Count zeros from the current position in the window
+                
+                unsigned int numBitsLeft = TableNumBits - numBitsUsed;
+                unsigned int countOfZeros = 0;
+                while (countOfZeros < numBitsLeft &&
+                       ((window >> (numBitsLeft - 1 - countOfZeros)) & 0x1) == 0) {
+                    countOfZeros++;
+                }
+                
+                unsigned int bitsThisSymbol = (countOfZeros << 1) + 1;
+                if (bitsThisSymbol > numBitsLeft) {
+                    break;
+                }
+                
+                unsigned int number = (window >> (numBitsLeft - bitsThisSymbol)) & ((0x1 << (countOfZeros + 1)) - 1);
+                symbols[numSymbols++] = (uint8_t) (number - 1);
+                numBitsUsed += bitsThisSymbol;
+            }
+            
+            memcpy(&entries[window].symbols, symbols, sizeof(symbols));
+            entries[window].numSymbols = numSymbols;
+            entries[window].numBits = numBitsUsed;
+        }
+    }
+};
+
+// This decoder looks up the next TableNumBits bits of a MSB first stream
+// in a multiple symbol table so that runs of short codes, like the 1 bit
+// code for a zero delta and the 3 bit codes for +-1, are decoded several
+// at a time. A code that is longer than the window falls back to the
+// clz logic in EliasGammaDecoderOpt64.
+
+template <unsigned int TableNumBits = 11>
+class EliasGammaDecoderTable
+{
+    public:
+    
+    EliasGammaDecoderTable()
+    {
+    }
+    
+    static inline
+    const EliasGammaMultiSymbolEntry * table()
+    {
+        static const EliasGammaMultiSymbolTable<TableNumBits> multiSymbolTable;
+        return multiSymbolTable.entries;
+    }
+    
+    // Decode numSymbols starting at bitOffset and write to decodedBytesPtr,
+    // returns the bit offset just after the last decoded symbol.
+    
+    static
+    unsigned int decodeSymbols(const uint8_t * encodedBitsPtr,
+                               const unsigned int numEncodedBytes,
+                               unsigned int bitOffset,
+                               unsigned int numSymbols,
+                               uint8_t * decodedBytesPtr)
+    {
+        const unsigned int maxBitsPerSymbol = 17;
+        const unsigned int maxSymbolsPerEntry = EliasGammaMultiSymbolTable<TableNumBits>::maxSymbolsPerEntry;
+        const EliasGammaMultiSymbolEntry *entries = table();
+        
+        // An entry always writes 8 bytes, so the table is only used while
+        // at least 8 symbols remain. The final symbols use clz decoding.
+        
+        while (numSymbols >= maxSymbolsPerEntry) {
+            uint64_t bits;
+            unsigned int numBitsValid = EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+            
+            do {
+                const EliasGammaMultiSymbolEntry & entry = entries[bits >> (64 - TableNumBits)];
+                unsigned int bitsThisEntry;
+                
+                if (entry.numSymbols != 0) {
+                    memcpy(decodedBytesPtr, &entry.symbols, sizeof(entry.symbols));
+                    decodedBytesPtr += entry.numSymbols;
+                    numSymbols -= entry.numSymbols;
+                    bitsThisEntry = entry.numBits;
+                    bits <<= bitsThisEntry;
+                } else {
+                    *decodedBytesPtr++ = EliasGammaDecoderOpt64::decodeSymbol<true>(bits, bitsThisEntry);
+                    numSymbols -= 1;
+                }
+                
+                bitOffset += bitsThisEntry;
+                numBitsValid -= bitsThisEntry;
+            } while (numSymbols >= maxSymbolsPerEntry && numBitsValid >= maxBitsPerSymbol);
+        }
+        
+        if (numSymbols > 0) {
+            bitOffset = EliasGammaDecoderOpt64::decodeSymbols<true>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbols, decodedBytesPtr);
+        }
+        
+        return bitOffset;
+    }
+    
+    // Decode a known number of symbols from the start of the buffer
+    
+    void decode(const uint8_t * encodedBitsPtr,
+                const unsigned int numEncodedBytes,
+                unsigned int numSymbols,
+                vector<uint8_t> & outBytesVec)
+    {
+        if (outBytesVec.size() != numSymbols) {
+            outBytesVec.resize(numSymbols);
+        }
+        decodeSymbols(encodedBitsPtr, numEncodedBytes, 0, numSymbols, outBytesVec.data());
+    }
+    
+};
+
 #endif // elias_hpp
@@ -0,0 +1,209 @@
+//
+//  elias_block_index.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Two level index of block start bit offsets. The flat table
+//  used by the shader stores a 32 bit offset for every block,
+//  this index stores a 32 bit absolute anchor once every
+//  (1 << anchorShift) blocks and a 16 bit offset relative to
+//  the anchor for each block. A lookup is one shift, two loads
+//  and an add.
+//
+//  Layout:
+//
+//  bytes 0-3  : number of blocks as little endian uint32
+//  byte 4     : anchorShift
+//  byte 5     : blockDim, one of 4, 8, 16, 32
+//  bytes 6-7  : zero
+//  anchors    : one little endian uint32 for each group of blocks
+//  relative   : one little endian uint16 for each block
+//
+//  An 8x8 block is at most (64 * 17) bits, so 16 bit relative
+//  offsets always fit when there are 32 blocks in a group. Larger
+//  blocks use smaller groups, see anchorShiftForBlockDim().
+
+#ifndef elias_block_index_hpp
+#define elias_block_index_hpp
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <vector>
+
+class EliasBlockIndex
+{
+    public:
+    
+    static const unsigned int headerNumBytes = 8;
+    static const unsigned int defaultAnchorShift = 5;
+    static const unsigned int defaultBlockDim = 8;
+    
+    std::vector<uint32_t> anchors;
+    std::vector<uint16_t> relativeOffsets;
+    unsigned int numBlocks;
+    unsigned int anchorShift;
+    unsigned int blockDim;
+    
+    EliasBlockIndex()
+    : numBlocks(0), anchorShift(defaultAnchorShift), blockDim(defaultBlockDim) {
+    }
+    
+    static bool isValidBlockDim(unsigned int blockDim) {
+        return blockDim == 4 || blockDim == 8 || blockDim == 16 || blockDim == 32;
+    }
+    
+    // Largest group of blocks where the relative offset of the last
+    // block always fits in 16 bits, a block is at most 17 bits per symbol.
+    
+    static unsigned int anchorShiftForBlockDim(unsigned int blockDim) {
+        const unsigned int maxBlockNumBits = blockDim * blockDim * 17;
+        unsigned int shift = 0;
+        while (((2u << shift) - 1) * maxBlockNumBits <= 0xFFFF) {
+            shift++;
+        }
+        return shift;
+    }
+    
+    // Build the index from a flat table of block start bit offsets,
+    // returns false if a relative offset does not fit in 16 bits.
+    
+    bool build(const uint32_t *blockBitOffsets, unsigned int inNumBlocks, unsigned int inBlockDim = defaultBlockDim)
+    {
+        numBlocks = inNumBlocks;
+        blockDim = inBlockDim;
+        anchorShift = anchorShiftForBlockDim(blockDim);
+
+#if defined(DEBUG)
+        assert(isValidBlockDim(blockDim));
+#endif // DEBUG
+        
+        const unsigned int numAnchors = (numBlocks + (1 << anchorShift) - 1) >> anchorShift;
+        
+        anchors.resize(numAnchors);
+        relativeOffsets.resize(numBlocks);
+        
+        for (unsigned int blocki = 0; blocki < numBlocks; blocki++) {
+            const unsigned int anchori = blocki >> anchorShift;
+            
+            if ((blocki & ((1 << anchorShift) - 1)) == 0) {
+                anchors[anchori] = blockBitOffsets[blocki];
+            }
+            
+            uint32_t relativeOffset = blockBitOffsets[blocki] - anchors[anchori];
+            if (relativeOffset > 0xFFFF) {
+                return false;
+            }
+            relativeOffsets[blocki] = (uint16_t) relativeOffset;
+        }
+        
+        return true;
+    }
+    
+    // O(1) lookup of the bit offset where block i starts
+    
+    inline
+    uint32_t blockBitOffset(unsigned int blocki) const {
+#if defined(DEBUG)
+        assert(blocki < numBlocks);
+#endif // DEBUG
+        return anchors[blocki >> anchorShift] + relativeOffsets[blocki];
+    }
+    
+    // Expand to the flat table of 32 bit offsets used by the shader
+    
+    void expand(uint32_t *blockBitOffsets) const
+    {
+        for (unsigned int blocki = 0; blocki < numBlocks; blocki++) {
+            blockBitOffsets[blocki] = blockBitOffset(blocki);
+        }
+    }
+    
+    // Size of the serialized index in bytes
+    
+    unsigned int numBytes() const {
+        return headerNumBytes + ((unsigned int) anchors.size() * 4) + (numBlocks * 2);
+    }
+    
+    // Append the serialized index to bytes
+    
+    void write(std::vector<uint8_t> & bytes) const
+    {
+        bytes.reserve(bytes.size() + numBytes());
+        
+        appendLE(bytes, numBlocks, 4);
+        bytes.push_back((uint8_t) anchorShift);
+        bytes.push_back((uint8_t) blockDim);
+        bytes.push_back(0);
+        bytes.push_back(0);
+        
+        for ( uint32_t anchor : anchors ) {
+            appendLE(bytes, anchor, 4);
+        }
+        for ( uint16_t relativeOffset : relativeOffsets ) {
+            appendLE(bytes, relativeOffset, 2);
+        }
+    }
+    
+    // Parse a serialized index, returns false if the header is not
+    // valid or the buffer is too small. The anchorShift must not be
+    // larger than the one build() uses for blockDim, otherwise the
+    // relative offsets in a group could overflow 16 bits.
+    
+    bool read(const uint8_t *bytesPtr, unsigned int bytesN)
+    {
+        if (bytesN < headerNumBytes) {
+            return false;
+        }
+        
+        numBlocks = (unsigned int) readLE(bytesPtr, 4);
+        anchorShift = bytesPtr[4];
+        blockDim = bytesPtr[5];
+        
+        if (!isValidBlockDim(blockDim) || anchorShift > anchorShiftForBlockDim(blockDim)) {
+            return false;
+        }
+        
+        // Sizes are computed in 64 bits so a corrupt numBlocks cannot wrap
+        
+        const uint64_t numAnchors = (((uint64_t) numBlocks) + (1 << anchorShift) - 1) >> anchorShift;
+        
+        if ((uint64_t) bytesN < (headerNumBytes + (numAnchors * 4) + (((uint64_t) numBlocks) * 2))) {
+            return false;
+        }
+        
+        const uint8_t *anchorsPtr = bytesPtr + headerNumBytes;
+        const uint8_t *relativePtr = anchorsPtr + (numAnchors * 4);
+        
+        anchors.resize((size_t) numAnchors);
+        for (unsigned int anchori = 0; anchori < numAnchors; anchori++) {
+            anchors[anchori] = (uint32_t) readLE(anchorsPtr + (anchori * 4), 4);
+        }
+        
+        relativeOffsets.resize(numBlocks);
+        for (unsigned int blocki = 0; blocki < numBlocks; blocki++) {
+            relativeOffsets[blocki] = (uint16_t) readLE(relativePtr + (blocki * 2), 2);
+        }
+        
+        return true;
+    }
+    
+    private:
+    
+    static void appendLE(std::vector<uint8_t> & bytes, uint32_t value, int numBytes) {
+        for (int i = 0; i < numBytes; i++) {
+            bytes.push_back((uint8_t) (value >> (i * 8)));
+        }
+    }
+    
+    static uint32_t readLE(const uint8_t *ptr, int numBytes) {
+        uint32_t value = 0;
+        for (int i = 0; i < numBytes; i++) {
+            value |= ((uint32_t) ptr[i]) << (i * 8);
+        }
+        return value;
+    }
+};
+
+#endif // elias_block_index_hpp
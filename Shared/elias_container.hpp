@@ -0,0 +1,361 @@
+//
+//  elias_container.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Versioned file container for an encoded image. The file is laid
+//  out so that a memory mapping can be handed to the block decoders
+//  directly, both sections start at a 64 byte aligned file offset and
+//  the bitstream section already ends with the zero padding bytes that
+//  decoders read ahead into. All values are little endian.
+//
+//  Header (64 bytes):
+//
+//  bytes 0-3   : magic "ELGC"
+//  bytes 4-5   : version
+//  bytes 6-7   : header size in bytes
+//  bytes 8-11  : image width
+//  bytes 12-15 : image height
+//  byte 16     : blockDim, one of 4, 8, 16, 32
+//  byte 17     : bit order, 0 = MSB first, 1 = LSB first
+//  byte 18     : number of zero padding bytes at the end of the bitstream
+//  byte 19     : zero
+//  bytes 20-23 : number of blocks
+//  bytes 24-31 : file offset of the block offsets section
+//  bytes 32-39 : file offset of the bitstream section
+//  bytes 40-47 : size of the bitstream section including padding
+//  bytes 48-63 : zero
+//
+//  Block offsets section : one uint32 block start bit offset per block
+//  Bitstream section     : encoded codes followed by the padding bytes
+
+#ifndef elias_container_hpp
+#define elias_container_hpp
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+typedef enum {
+  EliasBitOrderMSB = 0,
+  EliasBitOrderLSB = 1
+} EliasBitOrder;
+
+class EliasContainer
+{
+    public:
+    
+    static const unsigned int version = 1;
+    static const unsigned int headerNumBytes = 64;
+    static const unsigned int sectionAlignment = 64;
+    static const unsigned int minPaddingNumBytes = 2;
+    
+    unsigned int width;
+    unsigned int height;
+    unsigned int blockDim;
+    EliasBitOrder bitOrder;
+    unsigned int paddingNumBytes;
+    unsigned int numBlocks;
+    uint64_t blockOffsetsFileOffset;
+    uint64_t codesFileOffset;
+    uint64_t codesNumBytes;
+    
+    EliasContainer()
+    : width(0), height(0), blockDim(8), bitOrder(EliasBitOrderMSB), paddingNumBytes(minPaddingNumBytes),
+    numBlocks(0), blockOffsetsFileOffset(0), codesFileOffset(0), codesNumBytes(0) {
+    }
+    
+    static uint64_t alignSection(uint64_t offset) {
+        return (offset + sectionAlignment - 1) & ~((uint64_t) sectionAlignment - 1);
+    }
+    
+    // Serialize the header and both sections to bytes. The codes must
+    // already end with paddingNumBytes zero bytes, as emitted by an
+    // encoder with emitPaddingZeros set.
+    
+    void write(std::vector<uint8_t> & bytes,
+               const uint8_t *codesPtr,
+               uint64_t inCodesNumBytes,
+               const uint32_t *blockBitOffsetsPtr)
+    {
+#if defined(DEBUG)
+        assert(inCodesNumBytes >= paddingNumBytes);
+        for (unsigned int i = 0; i < paddingNumBytes; i++) {
+            assert(codesPtr[inCodesNumBytes - 1 - i] == 0);
+        }
+#endif // DEBUG
+        
+        codesNumBytes = inCodesNumBytes;
+        blockOffsetsFileOffset = alignSection(headerNumBytes);
+        codesFileOffset = alignSection(blockOffsetsFileOffset + ((uint64_t) numBlocks * 4));
+        
+        bytes.clear();
+        bytes.resize((size_t) (codesFileOffset + codesNumBytes));
+        
+        uint8_t *headerPtr = bytes.data();
+        memcpy(headerPtr, "ELGC", 4);
+        storeLE(headerPtr + 4, version, 2);
+        storeLE(headerPtr + 6, headerNumBytes, 2);
+        storeLE(headerPtr + 8, width, 4);
+        storeLE(headerPtr + 12, height, 4);
+        headerPtr[16] = (uint8_t) blockDim;
+        headerPtr[17] = (uint8_t) bitOrder;
+        headerPtr[18] = (uint8_t) paddingNumBytes;
+        storeLE(headerPtr + 20, numBlocks, 4);
+        storeLE(headerPtr + 24, blockOffsetsFileOffset, 8);
+        storeLE(headerPtr + 32, codesFileOffset, 8);
+        storeLE(headerPtr + 40, codesNumBytes, 8);
+        
+        uint8_t *offsetsPtr = bytes.data() + blockOffsetsFileOffset;
+        for (unsigned int blocki = 0; blocki < numBlocks; blocki++) {
+            storeLE(offsetsPtr + (blocki * 4), blockBitOffsetsPtr[blocki], 4);
+        }
+        
+        memcpy(bytes.data() + codesFileOffset, codesPtr, (size_t) codesNumBytes);
+    }
+    
+    // Write the container to a file, returns false on an IO error
+    
+    bool writeFile(const char *path,
+                   const uint8_t *codesPtr,
+                   uint64_t inCodesNumBytes,
+                   const uint32_t *blockBitOffsetsPtr)
+    {
+        std::vector<uint8_t> bytes;
+        write(bytes, codesPtr, inCodesNumBytes, blockBitOffsetsPtr);
+        
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL) {
+            return false;
+        }
+        size_t numWritten = fwrite(bytes.data(), 1, bytes.size(), fp);
+        int closeResult = fclose(fp);
+        
+        return (numWritten == bytes.size()) && (closeResult == 0);
+    }
+    
+    // Parse and validate the header and the block offsets, returns false
+    // if the sections do not fit in bytesN, any field is out of range or
+    // the block offsets decrease or point past the end of the bitstream.
+    
+    bool read(const uint8_t *bytesPtr, uint64_t bytesN)
+    {
+        if (bytesN < headerNumBytes || memcmp(bytesPtr, "ELGC", 4) != 0) {
+            return false;
+        }
+        if (loadLE(bytesPtr + 4, 2) != version || loadLE(bytesPtr + 6, 2) != headerNumBytes) {
+            return false;
+        }
+        
+        width = (unsigned int) loadLE(bytesPtr + 8, 4);
+        height = (unsigned int) loadLE(bytesPtr + 12, 4);
+        blockDim = bytesPtr[16];
+        const unsigned int bitOrderByte = bytesPtr[17];
+        paddingNumBytes = bytesPtr[18];
+        numBlocks = (unsigned int) loadLE(bytesPtr + 20, 4);
+        blockOffsetsFileOffset = loadLE(bytesPtr + 24, 8);
+        codesFileOffset = loadLE(bytesPtr + 32, 8);
+        codesNumBytes = loadLE(bytesPtr + 40, 8);
+        
+        if (blockDim != 4 && blockDim != 8 && blockDim != 16 && blockDim != 32) {
+            return false;
+        }
+        if (bitOrderByte != EliasBitOrderMSB && bitOrderByte != EliasBitOrderLSB) {
+            return false;
+        }
+        bitOrder = (EliasBitOrder) bitOrderByte;
+        if (paddingNumBytes < minPaddingNumBytes || codesNumBytes < paddingNumBytes) {
+            return false;
+        }
+        
+        const uint64_t numBlocksInWidth = (width + blockDim - 1) / blockDim;
+        const uint64_t numBlocksInHeight = (height + blockDim - 1) / blockDim;
+        
+        if (numBlocks != (numBlocksInWidth * numBlocksInHeight)) {
+            return false;
+        }
+        if ((blockOffsetsFileOffset % sectionAlignment) != 0 || (codesFileOffset % sectionAlignment) != 0) {
+            return false;
+        }
+        if (blockOffsetsFileOffset < headerNumBytes ||
+            (blockOffsetsFileOffset + ((uint64_t) numBlocks * 4)) > codesFileOffset ||
+            codesFileOffset > bytesN ||
+            codesNumBytes > (bytesN - codesFileOffset)) {
+            return false;
+        }
+        
+        // Decoders read ahead into the padding, so it must be zero
+        
+        const uint8_t *paddingPtr = bytesPtr + codesFileOffset + codesNumBytes - paddingNumBytes;
+        for (unsigned int i = 0; i < paddingNumBytes; i++) {
+            if (paddingPtr[i] != 0) {
+                return false;
+            }
+        }
+        
+        // Decoders start a block at each offset without a range check
+        
+        const uint8_t *offsetsPtr = bytesPtr + blockOffsetsFileOffset;
+        const uint64_t codesNumBits = codesNumBytes * 8;
+        uint64_t prevBitOffset = 0;
+        for (unsigned int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint64_t bitOffset = loadLE(offsetsPtr + (blocki * 4), 4);
+            if (bitOffset < prevBitOffset || bitOffset > codesNumBits) {
+                return false;
+            }
+            prevBitOffset = bitOffset;
+        }
+        
+        return true;
+    }
+    
+    // Number of block order symbols the bitstream decodes to
+    
+    unsigned int numSymbols() const {
+        return numBlocks * (blockDim * blockDim);
+    }
+    
+    static bool hostIsLittleEndian() {
+        const uint16_t value = 1;
+        return *((const uint8_t *) &value) == 1;
+    }
+    
+    static void storeLE(uint8_t *ptr, uint64_t value, int numBytes) {
+        for (int i = 0; i < numBytes; i++) {
+            ptr[i] = (uint8_t) (value >> (i * 8));
+        }
+    }
+    
+    static uint64_t loadLE(const uint8_t *ptr, int numBytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < numBytes; i++) {
+            value |= ((uint64_t) ptr[i]) << (i * 8);
+        }
+        return value;
+    }
+};
+
+// Read only memory mapping of a whole file
+
+class EliasFileMapping
+{
+    public:
+    
+    const uint8_t *bytesPtr;
+    size_t numBytes;
+    
+    EliasFileMapping()
+    : bytesPtr(NULL), numBytes(0) {
+    }
+    
+    ~EliasFileMapping() {
+        close();
+    }
+    
+    // Returns false if the file cannot be opened or is empty
+    
+    bool open(const char *path)
+    {
+        close();
+        
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        
+        void *ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        
+        bytesPtr = (const uint8_t *) ptr;
+        numBytes = (size_t) st.st_size;
+        
+        return true;
+    }
+    
+    void close()
+    {
+        if (bytesPtr != NULL) {
+            munmap((void *) bytesPtr, numBytes);
+        }
+        bytesPtr = NULL;
+        numBytes = 0;
+    }
+    
+    private:
+    
+    EliasFileMapping(const EliasFileMapping &);
+    EliasFileMapping & operator=(const EliasFileMapping &);
+};
+
+// Read only memory mapping of a container file. The block offsets and
+// the bitstream point into the mapping, so nothing is copied. Only the
+// block offsets are read when the header is validated, the bitstream
+// is not read until a decoder touches the pages.
+
+class EliasContainerMapping
+{
+    public:
+    
+    EliasContainer container;
+    const uint32_t *blockBitOffsetsPtr;
+    const uint8_t *codesPtr;
+    
+    EliasContainerMapping()
+    : blockBitOffsetsPtr(NULL), codesPtr(NULL) {
+    }
+    
+    // Map the file and validate the header, returns false if the file
+    // cannot be mapped or is not a valid container. The uint32 offsets
+    // are used in place, so a big endian host is not supported.
+    
+    bool open(const char *path)
+    {
+        close();
+        
+        if (!EliasContainer::hostIsLittleEndian() || !mapping.open(path)) {
+            return false;
+        }
+        
+        if (!container.read(mapping.bytesPtr, mapping.numBytes)) {
+            close();
+            return false;
+        }
+        
+        blockBitOffsetsPtr = (const uint32_t *) (mapping.bytesPtr + container.blockOffsetsFileOffset);
+        codesPtr = mapping.bytesPtr + container.codesFileOffset;
+        
+        return true;
+    }
+    
+    void close()
+    {
+        mapping.close();
+        blockBitOffsetsPtr = NULL;
+        codesPtr = NULL;
+    }
+    
+    private:
+    
+    EliasFileMapping mapping;
+};
+
+#endif // elias_container_hpp
@@ -0,0 +1,191 @@
+//
+//  elias_deltas.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Post decode stage that converts zerod deltas back into
+//  symbols. Entropy decoders only extract the zerod delta
+//  symbols and this stage then undoes the zerod mapping and
+//  applies the deltas with a running sum modulo 256. With a
+//  vector unit 16 deltas are reconstructed at a time with a
+//  log step prefix sum.
+
+#ifndef elias_deltas_hpp
+#define elias_deltas_hpp
+
+#include <assert.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define ELIAS_DELTAS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ELIAS_DELTAS_NEON 1
+#endif
+
+class EliasZerodDeltas
+{
+    public:
+    
+    // Branch free zerod to signed delta conversion, the result is
+    // returned as the unsigned byte with the same bit pattern.
+    
+    static inline
+    uint8_t delta(uint8_t zerodVal)
+    {
+        return (uint8_t) ((zerodVal >> 1) ^ (0 - (zerodVal & 0x1)));
+    }
+    
+    // Branch free signed delta to zerod conversion, the signed byte
+    // delta is mapped so that 0 = 0, -1 = 1, 1 = 2, -2 = 3.
+    
+    static inline
+    uint8_t zerodDelta(uint8_t cur, uint8_t prev)
+    {
+        int8_t delta = (int8_t) (cur - prev);
+        return (uint8_t) (((uint8_t) delta << 1) ^ (uint8_t) (delta >> 7));
+    }
+    
+    // 16 bit versions of the zerod conversions for high bit depth
+    // symbols, the signed delta wraps modulo 65536.
+    
+    static inline
+    uint16_t delta(uint16_t zerodVal)
+    {
+        return (uint16_t) ((zerodVal >> 1) ^ (0 - (zerodVal & 0x1)));
+    }
+    
+    static inline
+    uint16_t zerodDelta(uint16_t cur, uint16_t prev)
+    {
+        int16_t delta = (int16_t) (cur - prev);
+        return (uint16_t) (((uint16_t) delta << 1) ^ (uint16_t) (delta >> 15));
+    }
+    
+    // Add N zerod deltas to N symbols in place, each delta is
+    // independent so the loop vectorizes.
+    
+    static void addDeltas(uint8_t *ptr, const uint8_t *zerodPtr, int numSymbols)
+    {
+        for (int i = 0; i < numSymbols; i++) {
+            ptr[i] = (uint8_t) (ptr[i] + delta(zerodPtr[i]));
+        }
+    }
+    
+    // Undo N zerod deltas in place, the first delta is from zero
+    
+    static void undoDeltas(uint8_t *ptr, int numSymbols)
+    {
+        int i = 0;
+        uint8_t prevSymbol = 0;
+        
+#if defined(ELIAS_DELTAS_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i lowSevenBits = _mm_set1_epi8(0x7F);
+        
+        __m128i carry = zero;
+        
+        for ( ; (i + 16) <= numSymbols; i += 16) {
+            __m128i zerodVals = _mm_loadu_si128((const __m128i *) (ptr + i));
+            
+            __m128i halfVals = _mm_and_si128(_mm_srli_epi16(zerodVals, 1), lowSevenBits);
+            __m128i signVals = _mm_sub_epi8(zero, _mm_and_si128(zerodVals, one));
+            __m128i sums = _mm_xor_si128(halfVals, signVals);
+            
+            // Prefix sum in log2(16) steps, byte adds wrap at 256
+            
+            sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 1));
+            sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 2));
+            sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 4));
+            sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 8));
+            sums = _mm_add_epi8(sums, carry);
+            
+            _mm_storeu_si128((__m128i *) (ptr + i), sums);
+            
+            // Broadcast the last symbol as the carry into the next 16
+            
+            carry = _mm_unpackhi_epi8(sums, sums);
+            carry = _mm_unpackhi_epi16(carry, carry);
+            carry = _mm_shuffle_epi32(carry, 0xFF);
+        }
+        
+        if (i > 0) {
+            prevSymbol = ptr[i - 1];
+        }
+#elif defined(ELIAS_DELTAS_NEON)
+        const uint8x16_t zero = vdupq_n_u8(0);
+        const uint8x16_t one = vdupq_n_u8(1);
+        
+        uint8x16_t carry = zero;
+        
+        for ( ; (i + 16) <= numSymbols; i += 16) {
+            uint8x16_t zerodVals = vld1q_u8(ptr + i);
+            
+            uint8x16_t sums = veorq_u8(vshrq_n_u8(zerodVals, 1),
+                                       vsubq_u8(zero, vandq_u8(zerodVals, one)));
+            
+            sums = vaddq_u8(sums, vextq_u8(zero, sums, 15));
+            sums = vaddq_u8(sums, vextq_u8(zero, sums, 14));
+            sums = vaddq_u8(sums, vextq_u8(zero, sums, 12));
+            sums = vaddq_u8(sums, vextq_u8(zero, sums, 8));
+            sums = vaddq_u8(sums, carry);
+            
+            vst1q_u8(ptr + i, sums);
+            
+            carry = vdupq_n_u8(vgetq_lane_u8(sums, 15));
+        }
+        
+        if (i > 0) {
+            prevSymbol = ptr[i - 1];
+        }
+#endif
+        
+        for ( ; i < numSymbols; i++) {
+            prevSymbol = (uint8_t) (prevSymbol + delta(ptr[i]));
+            ptr[i] = prevSymbol;
+        }
+    }
+    
+    // Undo N 16 bit zerod deltas in place, the first delta is from zero
+    
+    static void undoDeltas(uint16_t *ptr, int numSymbols)
+    {
+        uint16_t prevSymbol = 0;
+        
+        for (int i = 0; i < numSymbols; i++) {
+            prevSymbol = (uint16_t) (prevSymbol + delta(ptr[i]));
+            ptr[i] = prevSymbol;
+        }
+    }
+    
+    // Convert N symbols to zerod deltas in place, the first delta is
+    // from zero. This is the inverse of undoDeltas for either width.
+    
+    template <typename T>
+    static void doDeltas(T *ptr, int numSymbols)
+    {
+        T prevSymbol = 0;
+        
+        for (int i = 0; i < numSymbols; i++) {
+            T symbol = ptr[i];
+            ptr[i] = zerodDelta(symbol, prevSymbol);
+            prevSymbol = symbol;
+        }
+    }
+    
+    // Undo the zerod deltas for each block in place, deltas
+    // restart from zero at the start of each block.
+    
+    template <typename T>
+    static void undoBlockDeltas(T *ptr, int numBlocks, int numSymbolsInBlock)
+    {
+        for ( int blocki = 0; blocki < numBlocks; blocki++ ) {
+            undoDeltas(ptr + (blocki * numSymbolsInBlock), numSymbolsInBlock);
+        }
+    }
+};
+
+#endif // elias_deltas_hpp
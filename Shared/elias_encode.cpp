@@ -16,42 +16,32 @@
 
 uint8_t* elias_gamma_encode(uint8_t *inBytePtr, int numBytes, int * numOutputBytes, int * numOutputBits)
 {
-    EliasGammaEncoder encoder;
-    
-    for (int i = 0; i < numBytes; i++) {
-        uint8_t byteVal = inBytePtr[i];
-        encoder.encode(byteVal);
-    }
-    encoder.finish();
-    
-    *numOutputBits = encoder.numEncodedBits;
-    
-    // Calculate number of encoded bits and compare to
-    // output, these must match.
-    
-#if defined(DEBUG)
-    int numBits = encoder.numBits(inBytePtr, numBytes);
-    assert(numBits == *numOutputBits);
-#endif // DEBUG
-    
-    int numEncodedBytes = (int) encoder.bytes.size();
+    int numEncodedBytes = elias_gamma_encode_num_bytes(inBytePtr, numBytes);
     assert(numEncodedBytes > 0);
-    *numOutputBytes = numEncodedBytes;
     
     uint8_t *encodedBytes = (uint8_t *) malloc(numEncodedBytes);
     if (encodedBytes == NULL) {
         return NULL;
     }
     
-    uint8_t *outPtr = encodedBytes;
-    for ( uint8_t byte : encoder.bytes ) {
-        if (1) {
-        printf("enc byte 0x%.2X\n", byte);
-        }
-        *outPtr++ = byte;
+    *numOutputBytes = elias_gamma_encode_into(inBytePtr, numBytes, encodedBytes, numEncodedBytes, numOutputBits);
+    assert(*numOutputBytes == numEncodedBytes);
+
+#if defined(DEBUG)
+    // Table driven output must be byte identical to bit by bit encoder
+    
+    EliasGammaEncoder encoder;
+    
+    for (int i = 0; i < numBytes; i++) {
+        uint8_t byteVal = inBytePtr[i];
+        encoder.encode(byteVal);
     }
+    encoder.finish();
+    
+    assert(encoder.numEncodedBits == *numOutputBits);
+    assert((int) encoder.bytes.size() == numEncodedBytes);
+    assert(memcmp(encoder.bytes.data(), encodedBytes, numEncodedBytes) == 0);
     
-#if defined(DEBUG)
     // Verify that decoding from this buffer of symbols produces
     // the same output.
     
@@ -71,25 +61,16 @@ uint8_t* elias_gamma_encode(uint8_t *inBytePtr, int numBytes, int * numOutputByt
 
 uint8_t* elias_gamma_decode(uint8_t *inEncodedBytePtr, int numInBytes, int * numDecodedBytes, int * numDecodedBits)
 {
-    EliasGammaDecoder decoder;
-    
-    // FIXME: optimize to read directly instead of copy ??
-    vector<uint8_t> inBytesVec(numInBytes);
-    memcpy(inBytesVec.data(), inEncodedBytePtr, numInBytes);
-    
-    vector<uint8_t> decodeBytesVec = decoder.decode(inBytesVec);
-    assert(decodeBytesVec.size() > 0);
-    *numDecodedBytes = (int) decodeBytesVec.size();
+    int numSymbols = elias_gamma_decode_num_symbols(inEncodedBytePtr, numInBytes);
+    assert(numSymbols > 0);
     
-    uint8_t *decodeBytes = (uint8_t *) malloc(*numDecodedBytes);
+    uint8_t *decodeBytes = (uint8_t *) malloc(numSymbols);
     if (decodeBytes == NULL) {
         return NULL;
     }
     
-    // FIXME: how can return bytes not be copied again?
-    memcpy(decodeBytes, decodeBytesVec.data(), *numDecodedBytes);
-    
-    *numDecodedBits = decoder.numDecodedBits;
+    *numDecodedBytes = elias_gamma_decode_into(inEncodedBytePtr, numInBytes, decodeBytes, numSymbols, numDecodedBits);
+    assert(*numDecodedBytes == numSymbols);
 
     return decodeBytes;
 }
@@ -101,3 +82,170 @@ int elias_gamma_num_bits(uint8_t *inBytePtr, int n)
     EliasGammaEncoder encoder;
     return encoder.numBits(inBytePtr, n);
 }
+
+// Exact number of bytes elias_gamma_encode_into() writes for n symbols
+
+int elias_gamma_encode_num_bytes(const uint8_t *inBytePtr, int n)
+{
+    const EliasGammaCode *table = EliasGamma_codeTable(false);
+    
+    unsigned int numBits = 0;
+    for (int i = 0; i < n; i++) {
+        numBits += table[inBytePtr[i]].bitWidth;
+    }
+    
+    return (int) ((numBits + 7) / 8);
+}
+
+// Upper bound on the encoded size of any n symbols, does not read input
+
+int elias_gamma_encode_max_num_bytes(int n)
+{
+    return (int) ((((int64_t) n * 17) + 7) / 8);
+}
+
+// Encode n symbols into outBytePtr which has room for outCapacity bytes.
+// Returns the number of bytes written or -1 if outCapacity is too small.
+// The encoded output is byte identical to elias_gamma_encode().
+
+int elias_gamma_encode_into(const uint8_t *inBytePtr, int n, uint8_t *outBytePtr, int outCapacity, int * numOutputBits)
+{
+    const EliasGammaCode *table = EliasGamma_codeTable(false);
+    
+    // LSB first : pending bits are right justified at bit 0
+    
+    uint64_t accum = 0;
+    unsigned int accumNumBits = 0;
+    unsigned int numEncodedBits = 0;
+    
+    uint8_t *outPtr = outBytePtr;
+    uint8_t *outEndPtr = outBytePtr + outCapacity;
+    
+    for (int i = 0; i < n; i++) {
+        const EliasGammaCode & egc = table[inBytePtr[i]];
+        accum |= ((uint64_t)egc.code) << accumNumBits;
+        accumNumBits += egc.bitWidth;
+        numEncodedBits += egc.bitWidth;
+        
+        if (accumNumBits >= 32) {
+            if ((outEndPtr - outPtr) < 4) {
+                return -1;
+            }
+            uint32_t word = (uint32_t) accum;
+            outPtr[0] = (uint8_t) word;
+            outPtr[1] = (uint8_t) (word >> 8);
+            outPtr[2] = (uint8_t) (word >> 16);
+            outPtr[3] = (uint8_t) (word >> 24);
+            outPtr += 4;
+            accum >>= 32;
+            accumNumBits -= 32;
+        }
+    }
+    
+    // Emit final bytes that are zero padded out to a whole byte
+    
+    while (accumNumBits > 0) {
+        if (outPtr == outEndPtr) {
+            return -1;
+        }
+        *outPtr++ = (uint8_t) accum;
+        accum >>= 8;
+        accumNumBits = (accumNumBits > 8) ? (accumNumBits - 8) : 0;
+    }
+    
+    if (numOutputBits != NULL) {
+        *numOutputBits = (int) numEncodedBits;
+    }
+    
+    return (int) (outPtr - outBytePtr);
+}
+
+// Decode a LSB first stream until the remaining bits do not contain
+// a whole symbol, like EliasGammaDecoder the zero bits that pad out
+// the last byte are not a symbol. When outBytePtr is NULL symbols
+// are counted but not written.
+
+static inline
+int elias_gamma_decode_symbols(const uint8_t *inEncodedBytePtr, int numInBytes, uint8_t *outBytePtr, int outCapacity, int * numDecodedBits)
+{
+    const unsigned int maxBitsPerSymbol = 17;
+    const unsigned int numInBits = (unsigned int) numInBytes * 8;
+    
+    unsigned int bitOffset = 0;
+    int numSymbols = 0;
+    
+    while (bitOffset < numInBits) {
+        uint64_t bits;
+        unsigned int numBitsValid = EliasGammaDecoderOpt64::refill<false>(inEncodedBytePtr, numInBytes, bitOffset, bits);
+        
+        do {
+            const unsigned int numBitsLeft = numInBits - bitOffset;
+            
+            if (numBitsLeft < maxBitsPerSymbol) {
+                // Stop when the rest of the stream is zeros or when
+                // the next symbol is cut off by the end of the stream
+                
+                uint64_t bitsLeft = bits & ((0x1ULL << numBitsLeft) - 1);
+                if (bitsLeft == 0) {
+                    bitOffset = numInBits;
+                    break;
+                }
+                unsigned int countOfZeros = __builtin_ctzll(bitsLeft);
+                if (((countOfZeros << 1) + 1) > numBitsLeft) {
+                    bitOffset = numInBits;
+                    break;
+                }
+            }
+            
+            if (outBytePtr != NULL && numSymbols == outCapacity) {
+                return -1;
+            }
+            
+            unsigned int bitsThisSymbol;
+            uint8_t symbol = EliasGammaDecoderOpt64::decodeSymbol<false>(bits, bitsThisSymbol);
+            
+            if (outBytePtr != NULL) {
+                outBytePtr[numSymbols] = symbol;
+            }
+            numSymbols += 1;
+            
+            bitOffset += bitsThisSymbol;
+            if (numDecodedBits != NULL) {
+                *numDecodedBits += bitsThisSymbol;
+            }
+            numBitsValid -= bitsThisSymbol;
+        } while (bitOffset < numInBits && numBitsValid >= maxBitsPerSymbol);
+    }
+    
+    return numSymbols;
+}
+
+// Exact number of symbols elias_gamma_decode_into() writes
+
+int elias_gamma_decode_num_symbols(const uint8_t *inEncodedBytePtr, int numInBytes)
+{
+    return elias_gamma_decode_symbols(inEncodedBytePtr, numInBytes, NULL, 0, NULL);
+}
+
+// Upper bound on the number of decoded symbols, does not read input
+
+int elias_gamma_decode_max_num_symbols(int numInBytes)
+{
+    return numInBytes * 8;
+}
+
+// Decode symbols from inEncodedBytePtr into outBytePtr which has room for
+// outCapacity symbols. Returns the number of symbols written or -1 if
+// outCapacity is too small.
+
+int elias_gamma_decode_into(const uint8_t *inEncodedBytePtr, int numInBytes, uint8_t *outBytePtr, int outCapacity, int * numDecodedBits)
+{
+    int numBits = 0;
+    int numSymbols = elias_gamma_decode_symbols(inEncodedBytePtr, numInBytes, outBytePtr, outCapacity, &numBits);
+    
+    if (numDecodedBits != NULL) {
+        *numDecodedBits = numBits;
+    }
+    
+    return numSymbols;
+}
@@ -9,6 +9,7 @@
 #define elias_encode_h
 
 #include <stdlib.h>
+#include <stdint.h>
 
 // Encode N byte symbols into and output buffer of at least n.
 // Returns the number of bytes written to encodedBytes, this
@@ -32,6 +33,38 @@ uint8_t* elias_gamma_decode(uint8_t *inEncodedBytePtr, int numInBytes, int * num
 // Return the number of bits needed to store this set of symbols
     
 int elias_gamma_num_bits(uint8_t *inBytePtr, int n);
+
+// The *_into functions below read from and write to caller provided
+// buffers. They never allocate memory and never print, so input and
+// output can live in pooled or shared memory.
+
+// Exact number of bytes elias_gamma_encode_into() writes for n symbols
+
+int elias_gamma_encode_num_bytes(const uint8_t *inBytePtr, int n);
+
+// Upper bound on the encoded size of any n symbols, does not read input
+
+int elias_gamma_encode_max_num_bytes(int n);
+
+// Encode n symbols into outBytePtr which has room for outCapacity bytes.
+// Returns the number of bytes written or -1 if outCapacity is too small.
+// The encoded output is byte identical to elias_gamma_encode().
+
+int elias_gamma_encode_into(const uint8_t *inBytePtr, int n, uint8_t *outBytePtr, int outCapacity, int * numOutputBits);
+
+// Exact number of symbols elias_gamma_decode_into() writes
+
+int elias_gamma_decode_num_symbols(const uint8_t *inEncodedBytePtr, int numInBytes);
+
+// Upper bound on the number of decoded symbols, does not read input
+
+int elias_gamma_decode_max_num_symbols(int numInBytes);
+
+// Decode symbols from inEncodedBytePtr into outBytePtr which has room for
+// outCapacity symbols. Returns the number of symbols written or -1 if
+// outCapacity is too small.
+
+int elias_gamma_decode_into(const uint8_t *inEncodedBytePtr, int numInBytes, uint8_t *outBytePtr, int outCapacity, int * numDecodedBits);
     
 #ifdef __cplusplus
 }
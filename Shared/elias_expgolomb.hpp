@@ -0,0 +1,212 @@
+//
+//  elias_expgolomb.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Exp-Golomb block coding with an adaptive order k in (0, 3).
+//  Order 0 is the elias gamma code of (symbol + 1). Order k codes
+//  (symbol + 2^k) as (n - k) zeros followed by the n + 1 binary
+//  digits of the number, where n is the position of the high bit.
+//  Larger k spend more bits on small symbols and fewer bits on
+//  large symbols, so noisy blocks that are mostly large deltas
+//  encode to fewer bits.
+//
+//  Each block starts with a header that contains k, then the
+//  symbols of the block follow as MSB first order k codes. Most
+//  blocks of a smooth image use order 0, so the header is coded
+//  as 1 = 0, 01 = 1, 001 = 2, 000 = 3 which costs 1 bit for an
+//  order 0 block. The block start bit offsets point at the header.
+
+#ifndef elias_expgolomb_hpp
+#define elias_expgolomb_hpp
+
+#include "elias.hpp"
+
+class EliasExpGolomb
+{
+    public:
+    
+    static const unsigned int maxK = 3;
+    static const unsigned int maxHeaderBits = 3;
+    
+    // Block header code for each k
+    
+    static inline
+    EliasGammaCode headerCode(unsigned int k) {
+        EliasGammaCode header;
+        header.code = (k == maxK) ? 0 : 1;
+        header.bitWidth = (k == maxK) ? maxK : (k + 1);
+        return header;
+    }
+    
+    // Precomputed MSB first codes for each k, the code is the
+    // number itself since the leading zeros have no value.
+    
+    class CodeTables
+    {
+        public:
+        EliasGammaCode tables[maxK + 1][256];
+        
+        CodeTables() {
+            for (unsigned int k = 0; k <= maxK; k++) {
+                for (unsigned int symbol = 0; symbol < 256; symbol++) {
+                    unsigned int number = symbol + (0x1 << k);
+                    unsigned int highBitPosition = 31 - __builtin_clz(number);
+                    tables[k][symbol].code = number;
+                    tables[k][symbol].bitWidth = (2 * highBitPosition) - k + 1;
+                }
+            }
+        }
+    };
+    
+    static inline
+    const EliasGammaCode * codeTable(unsigned int k) {
+        static const CodeTables codeTables;
+        return codeTables.tables[k];
+    }
+    
+    // Choose the k that encodes the block with the fewest bits
+    
+    static unsigned int chooseK(const uint8_t * blockPtr, int numSymbolsInBlock)
+    {
+        unsigned int bestK = 0;
+        unsigned int bestNumBits = 0;
+        
+        for (unsigned int k = 0; k <= maxK; k++) {
+            const EliasGammaCode *table = codeTable(k);
+            unsigned int numBits = headerCode(k).bitWidth;
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                numBits += table[blockPtr[i]].bitWidth;
+            }
+            if (k == 0 || numBits < bestNumBits) {
+                bestK = k;
+                bestNumBits = numBits;
+            }
+        }
+        
+        return bestK;
+    }
+    
+    // Encode each block of numSymbolsInBlock symbols with a k header, the
+    // bit offset of each block header is appended to blockBitOffsets. The
+    // encoder must be MSB first.
+    
+    static void encodeBlocks(EliasGammaEncoderOpt64 & encoder,
+                             const uint8_t * symbols,
+                             int numSymbols,
+                             int numSymbolsInBlock,
+                             vector<uint32_t> & blockBitOffsets)
+    {
+#if defined(DEBUG)
+        assert(encoder.emitMSB);
+        assert((numSymbols % numSymbolsInBlock) == 0);
+#endif // DEBUG
+        
+        const int numBlocks = numSymbols / numSymbolsInBlock;
+        
+        // Header plus the largest code for each symbol
+        encoder.reserveSymbols(numSymbols + numBlocks);
+        
+        blockBitOffsets.reserve(blockBitOffsets.size() + numBlocks);
+        
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint8_t * blockPtr = symbols + (blocki * numSymbolsInBlock);
+            const unsigned int k = chooseK(blockPtr, numSymbolsInBlock);
+            const EliasGammaCode *table = codeTable(k);
+            
+            blockBitOffsets.push_back(encoder.numEncodedBits);
+            
+            encoder.encodeCode(headerCode(k));
+            
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                encoder.encodeCode(table[blockPtr[i]]);
+            }
+        }
+        
+        encoder.finish();
+    }
+    
+    // Decode one order K symbol from a MSB aligned register and consume
+    // its bits. The count of zeros is limited like EliasGammaDecoderOpt64.
+    
+    template <unsigned int K>
+    static inline
+    uint8_t decodeSymbol(uint64_t & bits, unsigned int & bitsThisSymbol)
+    {
+        unsigned int countOfZeros = __builtin_clzll(bits | (0x1ULL << (63 - 8)));
+        bitsThisSymbol = (countOfZeros << 1) + K + 1;
+        unsigned int number = (unsigned int) (bits >> (64 - bitsThisSymbol));
+        bits <<= bitsThisSymbol;
+
+#if defined(DEBUG)
+        assert(number >= (0x1u << K) && number < (256u + (0x1u << K)));
+#endif // DEBUG
+        
+        return (uint8_t) (number - (0x1 << K));
+    }
+    
+    // Specialized kernel for one k, returns the bit offset after the
+    // last decoded symbol.
+    
+    template <unsigned int K>
+    static
+    unsigned int decodeSymbols(const uint8_t * encodedBitsPtr,
+                               const unsigned int numEncodedBytes,
+                               unsigned int bitOffset,
+                               unsigned int numSymbols,
+                               uint8_t * decodedBytesPtr)
+    {
+        const unsigned int maxBitsPerSymbol = 17;
+        
+        while (numSymbols > 0) {
+            uint64_t bits;
+            unsigned int numBitsValid = EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+            
+            do {
+                unsigned int bitsThisSymbol;
+                *decodedBytesPtr++ = decodeSymbol<K>(bits, bitsThisSymbol);
+                bitOffset += bitsThisSymbol;
+                numBitsValid -= bitsThisSymbol;
+                numSymbols -= 1;
+            } while (numSymbols > 0 && numBitsValid >= maxBitsPerSymbol);
+        }
+        
+        return bitOffset;
+    }
+    
+    // Read the block header at bitOffset and decode the block symbols
+    // with the kernel for that k, returns the bit offset after the block.
+    
+    static
+    unsigned int decodeBlock(const uint8_t * encodedBitsPtr,
+                             const unsigned int numEncodedBytes,
+                             unsigned int bitOffset,
+                             unsigned int numSymbolsInBlock,
+                             uint8_t * decodedBytesPtr)
+    {
+        // Order and header width indexed by the top 3 bits
+        
+        static const uint8_t headerKs[8] = { 3, 2, 1, 1, 0, 0, 0, 0 };
+        static const uint8_t headerBitWidths[8] = { 3, 3, 2, 2, 1, 1, 1, 1 };
+        
+        uint64_t bits;
+        EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+        const unsigned int top3 = (unsigned int) (bits >> (64 - maxHeaderBits));
+        const unsigned int k = headerKs[top3];
+        bitOffset += headerBitWidths[top3];
+        
+        switch (k) {
+            case 0:
+                return decodeSymbols<0>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock, decodedBytesPtr);
+            case 1:
+                return decodeSymbols<1>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock, decodedBytesPtr);
+            case 2:
+                return decodeSymbols<2>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock, decodedBytesPtr);
+            default:
+                return decodeSymbols<3>(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock, decodedBytesPtr);
+        }
+    }
+};
+
+#endif // elias_expgolomb_hpp
@@ -0,0 +1,210 @@
+//
+//  elias_hybrid.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Block coding that bounds the worst case size and decode time. A
+//  zerod delta of 255 is a 17 bit elias gamma code, so noisy blocks
+//  can take more than twice the bits of the raw pixels. Each block
+//  is coded in the mode that needs the fewest bits:
+//
+//  gamma    : elias gamma codes of the zerod deltas
+//  literal  : the 8 bit pixels of the block, starting on a byte
+//             boundary so that the decoder can memcpy them
+//  constant : 8 bits hold the value of every pixel
+//
+//  The 2 bit mode is not in the bitstream, it is stored in the low
+//  bits of the 32 bit block table entry next to the bit offset:
+//
+//  entry = (bitOffset << 2) | mode
+//
+//  so the decoder dispatches with the one load it needs for the
+//  offset. Bit offsets must be less than 2^30, the encoder fails when
+//  a block would start past that. A block is never more than
+//  (8 * numSymbolsInBlock + 7) bits and a literal block decodes with
+//  one memcpy. Constant blocks are coded like the constant blocks of
+//  EliasGammaRunBlocks. All codes are MSB first.
+
+#ifndef elias_hybrid_hpp
+#define elias_hybrid_hpp
+
+#include "elias.hpp"
+#include "elias_deltas.hpp"
+#include "elias_runs.hpp"
+
+typedef enum {
+  EliasHybridModeGamma = 0,
+  EliasHybridModeLiteral = 1,
+  EliasHybridModeConstant = 2
+} EliasHybridMode;
+
+class EliasHybridBlocks
+{
+    public:
+    
+    static const unsigned int maxNumSymbolsInBlock = 32 * 32;
+    static const uint32_t maxBitOffset = (0x1U << 30) - 1;
+    
+    static inline
+    uint32_t blockEntry(uint32_t bitOffset, EliasHybridMode mode) {
+#if defined(DEBUG)
+        assert(bitOffset <= maxBitOffset);
+#endif // DEBUG
+        return (bitOffset << 2) | (uint32_t) mode;
+    }
+    
+    static inline
+    uint32_t blockBitOffset(uint32_t entry) {
+        return entry >> 2;
+    }
+    
+    static inline
+    EliasHybridMode blockMode(uint32_t entry) {
+        return (EliasHybridMode) (entry & 0x3);
+    }
+    
+    // Zero bits written before a literal block at bitOffset
+    
+    static inline
+    unsigned int numLiteralPaddingBits(uint32_t bitOffset) {
+        return (8 - (bitOffset & 0x7)) & 0x7;
+    }
+    
+    // Choose the mode with the fewest bits for a block of zerod deltas
+    // that starts at bitOffset. A literal block is chosen over a gamma
+    // block of the same size since it decodes faster.
+    
+    static EliasHybridMode chooseMode(const uint8_t * blockPtr, int numSymbolsInBlock, uint32_t bitOffset)
+    {
+        if (EliasGammaRunBlocks::isConstant(blockPtr, numSymbolsInBlock)) {
+            return EliasHybridModeConstant;
+        }
+    
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        const unsigned int numLiteralBits = numLiteralPaddingBits(bitOffset) + (8 * numSymbolsInBlock);
+        unsigned int numGammaBits = 0;
+    
+        for (int i = 0; i < numSymbolsInBlock; i++) {
+            numGammaBits += table[blockPtr[i]].bitWidth;
+        }
+    
+        return (numGammaBits < numLiteralBits) ? EliasHybridModeGamma : EliasHybridModeLiteral;
+    }
+    
+    // Encode each block of numSymbolsInBlock zerod deltas in the mode
+    // with the fewest bits and append the entry of each block to
+    // blockEntries. The encoder must be MSB first. Returns false if a
+    // block would start at a bit offset larger than maxBitOffset.
+    
+    static bool encodeBlocks(EliasGammaEncoderOpt64 & encoder,
+                             const uint8_t * symbols,
+                             int numSymbols,
+                             int numSymbolsInBlock,
+                             vector<uint32_t> & blockEntries)
+    {
+#if defined(DEBUG)
+        assert(encoder.emitMSB);
+        assert((numSymbols % numSymbolsInBlock) == 0);
+        assert(numSymbolsInBlock <= (int) maxNumSymbolsInBlock);
+#endif // DEBUG
+    
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        const int numBlocks = numSymbols / numSymbolsInBlock;
+    
+        // Literal padding and constant values fit in one code per block
+        encoder.reserveSymbols(numSymbols + numBlocks);
+    
+        blockEntries.reserve(blockEntries.size() + numBlocks);
+    
+        uint8_t pixels[maxNumSymbolsInBlock];
+    
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint8_t * blockPtr = symbols + (blocki * numSymbolsInBlock);
+            const EliasHybridMode mode = chooseMode(blockPtr, numSymbolsInBlock, encoder.numEncodedBits);
+    
+            // The start of the block after any literal padding must fit
+            // in the 30 bits of the entry
+    
+            const uint64_t blockBitOffset = (uint64_t) encoder.numEncodedBits +
+                ((mode == EliasHybridModeLiteral) ? numLiteralPaddingBits(encoder.numEncodedBits) : 0);
+            if (blockBitOffset > maxBitOffset) {
+                return false;
+            }
+    
+            if (mode == EliasHybridModeConstant) {
+                blockEntries.push_back(blockEntry(encoder.numEncodedBits, mode));
+                encoder.encodeCode(EliasGammaRunBlocks::constantCode(blockPtr));
+            } else if (mode == EliasHybridModeLiteral) {
+                EliasGammaCode padding;
+                padding.code = 0;
+                padding.bitWidth = numLiteralPaddingBits(encoder.numEncodedBits);
+                if (padding.bitWidth > 0) {
+                    encoder.encodeCode(padding);
+                }
+    
+                blockEntries.push_back(blockEntry(encoder.numEncodedBits, mode));
+    
+                memcpy(pixels, blockPtr, numSymbolsInBlock);
+                EliasZerodDeltas::undoDeltas(pixels, numSymbolsInBlock);
+    
+                for (int i = 0; i < numSymbolsInBlock; i++) {
+                    EliasGammaCode value;
+                    value.code = pixels[i];
+                    value.bitWidth = 8;
+                    encoder.encodeCode(value);
+                }
+            } else {
+                blockEntries.push_back(blockEntry(encoder.numEncodedBits, mode));
+                for (int i = 0; i < numSymbolsInBlock; i++) {
+                    encoder.encodeCode(table[blockPtr[i]]);
+                }
+            }
+        }
+    
+        encoder.finish();
+    
+        return true;
+    }
+    
+    // Decode the block with the table entry to pixel values, returns the
+    // bit offset after the block.
+    
+    static inline
+    unsigned int decodeBlock(const uint8_t * encodedBitsPtr,
+                             const unsigned int numEncodedBytes,
+                             uint32_t entry,
+                             unsigned int numSymbolsInBlock,
+                             uint8_t * decodedBytesPtr)
+    {
+        const unsigned int bitOffset = blockBitOffset(entry);
+    
+        switch (blockMode(entry)) {
+            case EliasHybridModeLiteral: {
+#if defined(DEBUG)
+                assert((bitOffset & 0x7) == 0);
+                assert(((bitOffset >> 3) + numSymbolsInBlock) <= numEncodedBytes);
+#endif // DEBUG
+                memcpy(decodedBytesPtr, encodedBitsPtr + (bitOffset >> 3), numSymbolsInBlock);
+                return bitOffset + (8 * numSymbolsInBlock);
+            }
+            case EliasHybridModeConstant: {
+                const uint8_t *bytePtr = encodedBitsPtr + (bitOffset >> 3);
+                const unsigned int word = (bytePtr[0] << 8) | bytePtr[1];
+                const uint8_t value = (uint8_t) (word >> (8 - (bitOffset & 0x7)));
+                memset(decodedBytesPtr, value, numSymbolsInBlock);
+                return bitOffset + 8;
+            }
+            default: {
+#if defined(DEBUG)
+                assert(blockMode(entry) == EliasHybridModeGamma);
+#endif // DEBUG
+                unsigned int numBitsRead = EliasGammaDecoderTable<>::decodeSymbols(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock, decodedBytesPtr);
+                EliasZerodDeltas::undoDeltas(decodedBytesPtr, numSymbolsInBlock);
+                return numBitsRead;
+            }
+        }
+    }
+};
+
+#endif // elias_hybrid_hpp
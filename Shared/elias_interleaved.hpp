@@ -0,0 +1,440 @@
+//
+//  elias_interleaved.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Interleaved elias gamma streams. Decoding a single stream is a
+//  serial chain since the start of symbol i+1 is only known once
+//  symbol i has been decoded. This format splits symbols into chunks,
+//  typically one 8x8 block of 64 symbols, and assigns chunks round
+//  robin to 2, 4 or 8 independent MSB first streams so that one core
+//  can advance several chains at the same time.
+//
+//  Layout:
+//
+//  byte 0     : number of streams (1, 2, 4, 8)
+//  byte 1     : zero
+//  bytes 2-3  : number of symbols in a chunk as little endian uint16
+//  bytes 4-7  : number of symbols as little endian uint32
+//  bytes 8... : interleaved stream bytes
+//
+//  Chunk c is stored in stream (c % numStreams). Whole chunks are
+//  assigned to streams since a round robin of single symbols would
+//  place the large first delta of every block in the same stream.
+//
+//  Bytes from the streams are stored in the order the decoder reads
+//  them. The decoder keeps a 64 bit register for each stream and the
+//  streams share one read pointer. Every 3 symbols each register is
+//  topped up with as many whole bytes as fit, which leaves at least
+//  56 valid bits so the next 3 symbols (at most 51 bits) never need
+//  a refill check. Streams of different lengths need no padding and
+//  the encoder runs the same schedule to order the bytes. Eight zero
+//  bytes at the end keep the 64 bit loads inside a valid buffer, the
+//  decoder zero fills any load that would cross the end of a
+//  truncated buffer.
+
+#ifndef elias_interleaved_hpp
+#define elias_interleaved_hpp
+
+#include "elias.hpp"
+
+class EliasGammaInterleaved
+{
+    public:
+    
+    static const unsigned int headerNumBytes = 8;
+    static const unsigned int symbolsPerRefill = 3;
+    static const unsigned int numPaddingBytes = 8;
+    
+    static bool isValidNumStreams(unsigned int numStreams) {
+        return (numStreams == 1 || numStreams == 2 || numStreams == 4 || numStreams == 8);
+    }
+    
+    // Header queries, the buffer must contain at least headerNumBytes
+    
+    static unsigned int numStreams(const uint8_t * encodedPtr) {
+        return encodedPtr[0];
+    }
+    
+    static unsigned int numSymbolsInChunk(const uint8_t * encodedPtr) {
+        return ((unsigned int) encodedPtr[2]) |
+        (((unsigned int) encodedPtr[3]) << 8);
+    }
+    
+    static unsigned int numSymbols(const uint8_t * encodedPtr) {
+        return ((unsigned int) encodedPtr[4]) |
+        (((unsigned int) encodedPtr[5]) << 8) |
+        (((unsigned int) encodedPtr[6]) << 16) |
+        (((unsigned int) encodedPtr[7]) << 24);
+    }
+    
+    static void writeHeader(uint8_t * encodedPtr, unsigned int numStreams, unsigned int numSymbolsInChunk, unsigned int numSymbols) {
+        encodedPtr[0] = (uint8_t) numStreams;
+        encodedPtr[1] = 0;
+        encodedPtr[2] = (uint8_t) numSymbolsInChunk;
+        encodedPtr[3] = (uint8_t) (numSymbolsInChunk >> 8);
+        encodedPtr[4] = (uint8_t) numSymbols;
+        encodedPtr[5] = (uint8_t) (numSymbols >> 8);
+        encodedPtr[6] = (uint8_t) (numSymbols >> 16);
+        encodedPtr[7] = (uint8_t) (numSymbols >> 24);
+    }
+    
+    // The number of whole bytes that fit into a register that holds
+    // numBitsValid bits, the register then holds 56 to 63 bits.
+    
+    static inline
+    unsigned int numRefillBytes(unsigned int numBitsValid) {
+        return (63 - numBitsValid) >> 3;
+    }
+    
+    // Invoke visitor.refill(streami) and visitor.decode(streami, symboli)
+    // in the order used by the decoder. Each group of N chunks is decoded
+    // in lockstep so that symbol k of every chunk in the group is decoded
+    // before symbol k+1 and every stream is refilled before each 3 symbols.
+    // Chunks in a final partial group refill before each symbol.
+    
+    template <unsigned int N, typename V>
+    static inline
+    void visitDecodeOrder(unsigned int numSymbolsInChunk,
+                          unsigned int numSymbols,
+                          V & visitor)
+    {
+        const unsigned int numSymbolsInGroup = N * numSymbolsInChunk;
+        const unsigned int numGroups = numSymbols / numSymbolsInGroup;
+        
+        for (unsigned int groupi = 0; groupi < numGroups; groupi++) {
+            const unsigned int groupStart = groupi * numSymbolsInGroup;
+            
+            for (unsigned int symboli = 0; symboli < numSymbolsInChunk; symboli += symbolsPerRefill) {
+                unsigned int endSymboli = symboli + symbolsPerRefill;
+                if (endSymboli > numSymbolsInChunk) {
+                    endSymboli = numSymbolsInChunk;
+                }
+                
+                for (unsigned int streami = 0; streami < N; streami++) {
+                    visitor.refill(streami);
+                }
+                
+                for (unsigned int i = symboli; i < endSymboli; i++) {
+                    for (unsigned int streami = 0; streami < N; streami++) {
+                        visitor.decode(streami, groupStart + (streami * numSymbolsInChunk) + i);
+                    }
+                }
+            }
+        }
+        
+        for (unsigned int i = numGroups * numSymbolsInGroup; i < numSymbols; i++) {
+            unsigned int streami = (i / numSymbolsInChunk) % N;
+            visitor.refill(streami);
+            visitor.decode(streami, i);
+        }
+    }
+};
+
+class EliasGammaInterleavedEncoder
+{
+    public:
+    vector<uint8_t> bytes;
+    unsigned int numStreams;
+    unsigned int numSymbolsInChunk;
+    
+    EliasGammaInterleavedEncoder()
+    : numStreams(4), numSymbolsInChunk(64) {
+    }
+    
+    void reset() {
+        bytes.clear();
+    }
+    
+    // Encode N symbols with chunks assigned round robin to numStreams
+    // streams and write the header and the interleaved bytes to bytes.
+    
+    void encode(const uint8_t * byteVals, int numByteVals) {
+#if defined(DEBUG)
+        assert(EliasGammaInterleaved::isValidNumStreams(numStreams));
+        assert(numSymbolsInChunk >= 1 && numSymbolsInChunk <= 0xFFFF);
+#endif // DEBUG
+        
+        switch (numStreams) {
+            case 1:
+                encodeStreams<1>(byteVals, numByteVals);
+                break;
+            case 2:
+                encodeStreams<2>(byteVals, numByteVals);
+                break;
+            case 4:
+                encodeStreams<4>(byteVals, numByteVals);
+                break;
+            case 8:
+                encodeStreams<8>(byteVals, numByteVals);
+                break;
+        }
+    }
+    
+    private:
+    
+    template <unsigned int N>
+    void encodeStreams(const uint8_t * byteVals, int numByteVals) {
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        
+        EliasGammaEncoderOpt64 encoders[N];
+        
+        for ( EliasGammaEncoderOpt64 & encoder : encoders ) {
+            encoder.emitMSB = true;
+            encoder.emitPaddingZeros = false;
+            encoder.reserveSymbols((numByteVals / N) + numSymbolsInChunk);
+        }
+        
+        for (int i = 0; i < numByteVals; i++) {
+            unsigned int chunki = i / numSymbolsInChunk;
+            encoders[chunki % N].encodeCode(table[byteVals[i]]);
+        }
+        
+        size_t numStreamBytes = 0;
+        
+        for ( EliasGammaEncoderOpt64 & encoder : encoders ) {
+            encoder.finish();
+            numStreamBytes += encoder.bytes.size();
+        }
+        
+        bytes.clear();
+        bytes.reserve(EliasGammaInterleaved::headerNumBytes + numStreamBytes + (N * 8) + EliasGammaInterleaved::numPaddingBytes);
+        bytes.resize(EliasGammaInterleaved::headerNumBytes);
+        
+        EliasGammaInterleaved::writeHeader(bytes.data(), N, numSymbolsInChunk, numByteVals);
+        
+        // Emit bytes in the order the decoder reads them
+        
+        Scheduler<N> scheduler(encoders, byteVals, bytes);
+        
+        EliasGammaInterleaved::visitDecodeOrder<N>(numSymbolsInChunk, numByteVals, scheduler);
+        
+        for (unsigned int i = 0; i < EliasGammaInterleaved::numPaddingBytes; i++) {
+            bytes.push_back(0);
+        }
+
+#if defined(DEBUG)
+        for (unsigned int streami = 0; streami < N; streami++) {
+            assert(scheduler.byteOffsets[streami] >= encoders[streami].bytes.size());
+        }
+#endif // DEBUG
+    }
+    
+    // Track the valid bits in each decoder register so that stream bytes
+    // are appended at the point the decoder reads them, a stream that has
+    // been fully read emits zero bytes.
+    
+    template <unsigned int N>
+    struct Scheduler {
+        const EliasGammaEncoderOpt64 *encoders;
+        const uint8_t *byteVals;
+        vector<uint8_t> & bytes;
+        const EliasGammaCode *table;
+        unsigned int numBitsValid[N];
+        unsigned int byteOffsets[N];
+        
+        Scheduler(const EliasGammaEncoderOpt64 *inEncoders, const uint8_t *inByteVals, vector<uint8_t> & outBytes)
+        : encoders(inEncoders), byteVals(inByteVals), bytes(outBytes), table(EliasGamma_codeTable(true))
+        {
+            for (unsigned int streami = 0; streami < N; streami++) {
+                numBitsValid[streami] = 0;
+                byteOffsets[streami] = 0;
+            }
+        }
+        
+        inline void refill(unsigned int streami) {
+            const vector<uint8_t> & streamBytes = encoders[streami].bytes;
+            unsigned int numBytes = EliasGammaInterleaved::numRefillBytes(numBitsValid[streami]);
+            
+            for (unsigned int i = 0; i < numBytes; i++) {
+                unsigned int byteOffset = byteOffsets[streami]++;
+                bytes.push_back((byteOffset < streamBytes.size()) ? streamBytes[byteOffset] : 0);
+            }
+            
+            numBitsValid[streami] += numBytes * 8;
+        }
+        
+        inline void decode(unsigned int streami, unsigned int symboli) {
+            numBitsValid[streami] -= table[byteVals[symboli]].bitWidth;
+        }
+    };
+};
+
+// Decoder that keeps a 64 bit register for each stream. Streams are
+// decoded in lockstep, so the clz for one stream does not depend on
+// the result of the previous symbol in a different stream.
+
+class EliasGammaInterleavedDecoder
+{
+    public:
+    
+    EliasGammaInterleavedDecoder()
+    {
+    }
+    
+    // A refill loads 64 bits from the shared read pointer and keeps the
+    // whole bytes that fit below the valid bits in the register, the
+    // remaining bits of the load belong to the following streams and
+    // are masked off. Like EliasGammaDecoderOpt64::refill(), a load
+    // that would cross streamEndPtr reads the remaining bytes followed
+    // by zeros so that a truncated buffer is never read past the end.
+    
+    static inline
+    void refill(uint64_t & bits,
+                unsigned int & numBitsValid,
+                const uint8_t * & streamBytesPtr,
+                const uint8_t * streamEndPtr)
+    {
+        const unsigned int numBytes = EliasGammaInterleaved::numRefillBytes(numBitsValid);
+        const unsigned int numBitsAfter = numBitsValid + (numBytes * 8);
+        uint64_t word;
+        
+        if (streamBytesPtr <= streamEndPtr && (streamEndPtr - streamBytesPtr) >= 8) {
+            word = EliasGamma_load64BE(streamBytesPtr);
+        } else {
+            uint8_t tail[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            for (unsigned int i = 0; (streamBytesPtr + i) < streamEndPtr && i < 8; i++) {
+                tail[i] = streamBytesPtr[i];
+            }
+            word = EliasGamma_load64BE(tail);
+        }
+        
+        word >>= numBitsValid;
+        bits |= word & (~0ULL << (64 - numBitsAfter));
+        numBitsValid = numBitsAfter;
+        streamBytesPtr += numBytes;
+    }
+    
+    static inline
+    void decode(uint64_t & bits,
+                unsigned int & numBitsValid,
+                uint8_t * decodedBytePtr)
+    {
+        unsigned int bitsThisSymbol;
+        *decodedBytePtr = EliasGammaDecoderOpt64::decodeSymbol<true>(bits, bitsThisSymbol);
+        numBitsValid -= bitsThisSymbol;
+    }
+    
+    // Decode numSymbols with N streams, this loop must visit streams in
+    // the same order as EliasGammaInterleaved::visitDecodeOrder(). The
+    // register state is kept in local arrays that are only indexed with
+    // constants so that the compiler can keep each stream in registers.
+    
+    template <unsigned int N>
+    static
+    void decodeStreams(const uint8_t * streamBytesPtr,
+                       const uint8_t * streamEndPtr,
+                       unsigned int numSymbolsInChunk,
+                       unsigned int numSymbols,
+                       uint8_t * decodedBytesPtr)
+    {
+        const unsigned int symbolsPerRefill = EliasGammaInterleaved::symbolsPerRefill;
+        const unsigned int numSymbolsInGroup = N * numSymbolsInChunk;
+        const unsigned int numGroups = numSymbols / numSymbolsInGroup;
+        
+        uint64_t bits[N];
+        unsigned int numBitsValid[N];
+        
+        for (unsigned int streami = 0; streami < N; streami++) {
+            bits[streami] = 0;
+            numBitsValid[streami] = 0;
+        }
+        
+        for (unsigned int groupi = 0; groupi < numGroups; groupi++) {
+            uint8_t *groupOutPtr = decodedBytesPtr + (groupi * numSymbolsInGroup);
+            
+            for (unsigned int symboli = 0; symboli < numSymbolsInChunk; symboli += symbolsPerRefill) {
+                unsigned int endSymboli = symboli + symbolsPerRefill;
+                if (endSymboli > numSymbolsInChunk) {
+                    endSymboli = numSymbolsInChunk;
+                }
+                
+                EachStream<0, N>::refill(bits, numBitsValid, streamBytesPtr, streamEndPtr);
+                
+                for (unsigned int i = symboli; i < endSymboli; i++) {
+                    EachStream<0, N>::decode(bits, numBitsValid, groupOutPtr + i, numSymbolsInChunk);
+                }
+            }
+        }
+        
+        for (unsigned int i = numGroups * numSymbolsInGroup; i < numSymbols; i++) {
+            unsigned int streami = (i / numSymbolsInChunk) % N;
+            refill(bits[streami], numBitsValid[streami], streamBytesPtr, streamEndPtr);
+            decode(bits[streami], numBitsValid[streami], decodedBytesPtr + i);
+        }
+    }
+    
+    // Decode all the symbols in an interleaved buffer, returns false
+    // if the header is not valid. Like the other decoders, the stream
+    // contents are trusted to match the symbol count in the header,
+    // but reads never go past numEncodedBytes.
+    
+    bool decode(const uint8_t * encodedPtr,
+                const unsigned int numEncodedBytes,
+                vector<uint8_t> & outBytesVec)
+    {
+        if (numEncodedBytes < (EliasGammaInterleaved::headerNumBytes + EliasGammaInterleaved::numPaddingBytes)) {
+            return false;
+        }
+        
+        const unsigned int numStreams = EliasGammaInterleaved::numStreams(encodedPtr);
+        const unsigned int numSymbolsInChunk = EliasGammaInterleaved::numSymbolsInChunk(encodedPtr);
+        const unsigned int numSymbols = EliasGammaInterleaved::numSymbols(encodedPtr);
+        
+        if (!EliasGammaInterleaved::isValidNumStreams(numStreams) || numSymbolsInChunk == 0) {
+            return false;
+        }
+        
+        if (outBytesVec.size() != numSymbols) {
+            outBytesVec.resize(numSymbols);
+        }
+        
+        const uint8_t *streamBytesPtr = encodedPtr + EliasGammaInterleaved::headerNumBytes;
+        const uint8_t *streamEndPtr = encodedPtr + numEncodedBytes;
+        
+        switch (numStreams) {
+            case 1:
+                decodeStreams<1>(streamBytesPtr, streamEndPtr, numSymbolsInChunk, numSymbols, outBytesVec.data());
+                break;
+            case 2:
+                decodeStreams<2>(streamBytesPtr, streamEndPtr, numSymbolsInChunk, numSymbols, outBytesVec.data());
+                break;
+            case 4:
+                decodeStreams<4>(streamBytesPtr, streamEndPtr, numSymbolsInChunk, numSymbols, outBytesVec.data());
+                break;
+            case 8:
+                decodeStreams<8>(streamBytesPtr, streamEndPtr, numSymbolsInChunk, numSymbols, outBytesVec.data());
+                break;
+        }
+        
+        return true;
+    }
+    
+    private:
+    
+    template <unsigned int S, unsigned int N>
+    struct EachStream {
+        static inline void refill(uint64_t (&bits)[N], unsigned int (&numBitsValid)[N], const uint8_t * & streamBytesPtr, const uint8_t * streamEndPtr) {
+            EliasGammaInterleavedDecoder::refill(bits[S], numBitsValid[S], streamBytesPtr, streamEndPtr);
+            EachStream<S + 1, N>::refill(bits, numBitsValid, streamBytesPtr, streamEndPtr);
+        }
+        
+        static inline void decode(uint64_t (&bits)[N], unsigned int (&numBitsValid)[N], uint8_t * decodedBytesPtr, unsigned int numSymbolsInChunk) {
+            EliasGammaInterleavedDecoder::decode(bits[S], numBitsValid[S], decodedBytesPtr + (S * numSymbolsInChunk));
+            EachStream<S + 1, N>::decode(bits, numBitsValid, decodedBytesPtr, numSymbolsInChunk);
+        }
+    };
+    
+    template <unsigned int N>
+    struct EachStream<N, N> {
+        static inline void refill(uint64_t (&/*bits*/)[N], unsigned int (&/*numBitsValid*/)[N], const uint8_t * & /*streamBytesPtr*/, const uint8_t * /*streamEndPtr*/) {
+        }
+        
+        static inline void decode(uint64_t (&/*bits*/)[N], unsigned int (&/*numBitsValid*/)[N], uint8_t * /*decodedBytesPtr*/, unsigned int /*numSymbolsInChunk*/) {
+        }
+    };
+    
+};
+
+#endif // elias_interleaved_hpp
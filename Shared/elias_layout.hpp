@@ -0,0 +1,316 @@
+//
+//  elias_layout.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Output layouts for the CPU block decoders. The decoders produce
+//  symbols in block order, so an image needs a second deblock pass
+//  over the whole frame like flattenBlocksOfSize or the crop shader.
+//  A layout writer is handed each block as soon as it is decoded and
+//  stores the pixels straight into the final layout:
+//
+//  raster : cropped raster of a region with outRowStride bytes per row
+//  slices : the combined slices texture of drawInMTKView, slice i of a
+//           block holds symbols (4i, 4i+3) in one BGRA texel and the
+//           slices are tiled 8 across, ready to upload to
+//           _renderCombinedSlices
+//  morton : each block is a contiguous tile of pixels in block row
+//           order. The block grid is cut into squares of S x S blocks,
+//           S is the largest power of 2 that fits in both dimensions,
+//           squares are stored in raster order and tiles in a square
+//           in morton (Z) order. A square cut off by the right or
+//           bottom edge skips the morton indices of missing blocks, so
+//           there is exactly one tile for each block.
+//
+//  Each writer covers the block range (startBlockX, endBlockX - 1) by
+//  (startBlockY, endBlockY - 1) and writeBlock() only touches the
+//  output of one block, so block rows can be written in parallel.
+
+#ifndef elias_layout_hpp
+#define elias_layout_hpp
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+typedef enum {
+  EliasOutputLayoutRaster = 0,
+  EliasOutputLayoutSlices,
+  EliasOutputLayoutMorton
+} EliasOutputLayoutKind;
+
+class EliasOutputLayout
+{
+    public:
+
+    // Slices in one row of the combined slices texture, see the
+    // maxCol blit logic in drawInMTKView.
+
+    static const int maxNumSlicesInRow = 4096 / 512;
+
+    // Interleave the bits of x and y, x is in the even bits
+
+    static inline
+    uint32_t mortonIndex(uint32_t x, uint32_t y) {
+        return spreadBits(x) | (spreadBits(y) << 1);
+    }
+
+    // Width and height in BGRA texels of the combined slices texture
+
+    static int slicesWidth(int numBlocksInWidth) {
+        return numBlocksInWidth * maxNumSlicesInRow;
+    }
+
+    static int slicesHeight(int numBlocksInHeight, int blockDim) {
+        const int numSlices = (blockDim * blockDim) / 4;
+        return numBlocksInHeight * ((numSlices + maxNumSlicesInRow - 1) / maxNumSlicesInRow);
+    }
+
+    // Blocks in the width and height of a morton square, the largest
+    // power of 2 that is not larger than either grid dimension.
+
+    static int mortonSquareDim(int numBlocksInWidth, int numBlocksInHeight) {
+        const int minDim = std::min(numBlocksInWidth, numBlocksInHeight);
+        int squareDim = 1;
+        while ((squareDim * 2) <= minDim) {
+            squareDim *= 2;
+        }
+        return squareDim;
+    }
+
+    // Tile index of a block in the morton layout. The tiles before the
+    // square that holds the block are counted in raster order of the
+    // squares, then the blocks of that square with a smaller morton
+    // index are counted one quadrant level at a time.
+
+    static uint32_t mortonTileIndex(int blockX, int blockY, int numBlocksInWidth, int numBlocksInHeight, int squareDim)
+    {
+        const int squareY = blockY / squareDim;
+        const int squareX = blockX / squareDim;
+        const int rowHeight = std::min(squareDim, numBlocksInHeight - (squareY * squareDim));
+
+        uint32_t tilei = (uint32_t) (squareY * squareDim) * numBlocksInWidth;
+        tilei += (uint32_t) (squareX * squareDim) * rowHeight;
+
+        int x = blockX - (squareX * squareDim);
+        int y = blockY - (squareY * squareDim);
+        int w = std::min(squareDim, numBlocksInWidth - (squareX * squareDim));
+        int h = rowHeight;
+
+        if (w == squareDim && h == squareDim) {
+            return tilei + mortonIndex(x, y);
+        }
+
+        // Quadrants are in the order (0, 0), (1, 0), (0, 1), (1, 1)
+
+        for (int half = squareDim / 2; half > 0; half /= 2) {
+            const int qx = (x >= half) ? 1 : 0;
+            const int qy = (y >= half) ? 1 : 0;
+            const int leftW = std::min(w, half);
+            const int rightW = std::max(w - half, 0);
+            const int topH = std::min(h, half);
+            const int bottomH = std::max(h - half, 0);
+
+            if (qy == 1) {
+                tilei += (leftW + rightW) * topH;
+            }
+            if (qx == 1) {
+                tilei += leftW * (qy ? bottomH : topH);
+            }
+
+            x -= qx * half;
+            y -= qy * half;
+            w = qx ? rightW : leftW;
+            h = qy ? bottomH : topH;
+        }
+
+        return tilei;
+    }
+
+    // Smallest outRowStride for a layout of a width x height image, the
+    // morton layout has no rows and returns 0.
+
+    static int minRowStride(EliasOutputLayoutKind kind, int width, int blockDim) {
+        const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+        switch (kind) {
+            case EliasOutputLayoutRaster: {
+                return width;
+            }
+            case EliasOutputLayoutSlices: {
+                return slicesWidth(numBlocksInWidth) * 4;
+            }
+            default: {
+                return 0;
+            }
+        }
+    }
+
+    // Number of output bytes for a layout of a width x height image
+
+    static size_t numBytes(EliasOutputLayoutKind kind, int width, int height, int blockDim, int outRowStride) {
+        const int numBlocksInWidth = (width + blockDim - 1) / blockDim;
+        const int numBlocksInHeight = (height + blockDim - 1) / blockDim;
+        switch (kind) {
+            case EliasOutputLayoutRaster: {
+                return (size_t) outRowStride * height;
+            }
+            case EliasOutputLayoutSlices: {
+                return (size_t) outRowStride * slicesHeight(numBlocksInHeight, blockDim);
+            }
+            default: {
+                return ((size_t) numBlocksInWidth * numBlocksInHeight) * (blockDim * blockDim);
+            }
+        }
+    }
+
+    private:
+
+    static inline
+    uint32_t spreadBits(uint32_t v) {
+        v &= 0x0000FFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+};
+
+// Cropped raster of the region (regionX, regionY, regionWidth, regionHeight),
+// row r of the region starts at outPtr + (r * outRowStride). Only the
+// blocks that intersect the region are in the block range.
+
+template <int BlockDim>
+class EliasRasterWriter
+{
+    public:
+
+    int startBlockX;
+    int endBlockX;
+    int startBlockY;
+    int endBlockY;
+
+    EliasRasterWriter(uint8_t *outPtr, int outRowStride, int regionX, int regionY, int regionWidth, int regionHeight)
+    : outPtr(outPtr), outRowStride(outRowStride), regionX(regionX), regionY(regionY), regionWidth(regionWidth), regionHeight(regionHeight)
+    {
+        startBlockX = regionX / BlockDim;
+        endBlockX = ((regionX + regionWidth - 1) / BlockDim) + 1;
+        startBlockY = regionY / BlockDim;
+        endBlockY = ((regionY + regionHeight - 1) / BlockDim) + 1;
+    }
+
+    void writeBlock(int blockX, int blockY, const uint8_t *blockPixels) const
+    {
+        const int blockDim = BlockDim;
+
+        const int blockRootY = blockY * blockDim;
+        const int startY = std::max(regionY, blockRootY);
+        const int endY = std::min(regionY + regionHeight, blockRootY + blockDim);
+
+        const int blockRootX = blockX * blockDim;
+        const int startX = std::max(regionX, blockRootX);
+        const int endX = std::min(regionX + regionWidth, blockRootX + blockDim);
+
+        uint8_t *outRowPtr = outPtr + ((size_t)(startY - regionY) * outRowStride) + (startX - regionX);
+        const uint8_t *blockRowPtr = blockPixels + ((startY - blockRootY) * blockDim) + (startX - blockRootX);
+
+        if ((endX - startX) == blockDim) {
+            // Interior block, the copy size is a constant
+            for ( int y = startY; y < endY; y++ ) {
+                memcpy(outRowPtr, blockRowPtr, blockDim);
+                outRowPtr += outRowStride;
+                blockRowPtr += blockDim;
+            }
+        } else {
+            for ( int y = startY; y < endY; y++ ) {
+                memcpy(outRowPtr, blockRowPtr, endX - startX);
+                outRowPtr += outRowStride;
+                blockRowPtr += blockDim;
+            }
+        }
+    }
+
+    private:
+
+    uint8_t *outPtr;
+    const int outRowStride;
+    const int regionX;
+    const int regionY;
+    const int regionWidth;
+    const int regionHeight;
+};
+
+// Combined slices texture with outRowStride bytes per row of texels,
+// see EliasOutputLayout::slicesWidth() and slicesHeight().
+
+template <int BlockDim>
+class EliasSliceWriter
+{
+    public:
+
+    static const int numSlices = (BlockDim * BlockDim) / 4;
+
+    int startBlockX;
+    int endBlockX;
+    int startBlockY;
+    int endBlockY;
+
+    EliasSliceWriter(uint8_t *outPtr, int outRowStride, int numBlocksInWidth, int numBlocksInHeight)
+    : startBlockX(0), endBlockX(numBlocksInWidth), startBlockY(0), endBlockY(numBlocksInHeight),
+    outPtr(outPtr), outRowStride(outRowStride)
+    {
+    }
+
+    void writeBlock(int blockX, int blockY, const uint8_t *blockPixels) const
+    {
+        const int numSliceCols = EliasOutputLayout::maxNumSlicesInRow;
+
+        for ( int slice = 0; slice < numSlices; slice++ ) {
+            const int x = ((slice % numSliceCols) * endBlockX) + blockX;
+            const int y = ((slice / numSliceCols) * endBlockY) + blockY;
+            memcpy(outPtr + ((size_t)y * outRowStride) + (x * 4), blockPixels + (slice * 4), 4);
+        }
+    }
+
+    private:
+
+    uint8_t *outPtr;
+    const int outRowStride;
+};
+
+// Morton ordered tiles of BlockDim x BlockDim pixels, see
+// EliasOutputLayout::mortonTileIndex().
+
+template <int BlockDim>
+class EliasMortonWriter
+{
+    public:
+
+    int startBlockX;
+    int endBlockX;
+    int startBlockY;
+    int endBlockY;
+
+    EliasMortonWriter(uint8_t *outPtr, int numBlocksInWidth, int numBlocksInHeight)
+    : startBlockX(0), endBlockX(numBlocksInWidth), startBlockY(0), endBlockY(numBlocksInHeight),
+    outPtr(outPtr), squareDim(EliasOutputLayout::mortonSquareDim(numBlocksInWidth, numBlocksInHeight))
+    {
+    }
+
+    void writeBlock(int blockX, int blockY, const uint8_t *blockPixels) const
+    {
+        const int numSymbolsInBlock = BlockDim * BlockDim;
+        const size_t tilei = EliasOutputLayout::mortonTileIndex(blockX, blockY, endBlockX, endBlockY, squareDim);
+        memcpy(outPtr + (tilei * numSymbolsInBlock), blockPixels, numSymbolsInBlock);
+    }
+
+    private:
+
+    uint8_t *outPtr;
+    const int squareDim;
+};
+
+#endif // elias_layout_hpp
@@ -0,0 +1,195 @@
+//
+//  elias_planes.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Split interleaved colour pixels into 8 bit planes that are each
+//  encoded as a grayscale image, and merge decoded planes back into
+//  interleaved pixels. BGRA input has 4 planes and RGB input has 3.
+//
+//  With the YCoCg-R transform, the B G R planes are replaced by
+//  Y Co Cg planes so that most of the colour detail ends up in Y.
+//  Each lifting step is done modulo 256, so the transform stays
+//  exactly reversible with 8 bit planes. Alpha is never transformed.
+//
+//  Decoded planes are in block order, mergeBlockRow() deblocks,
+//  undoes the colour transform and interleaves one row of blocks
+//  in a single pass over the planes.
+
+#ifndef elias_planes_hpp
+#define elias_planes_hpp
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef enum {
+  EliasPixelFormatBGRA = 0,
+  EliasPixelFormatRGB
+} EliasPixelFormat;
+
+typedef enum {
+  EliasColorTransformNone = 0,
+  EliasColorTransformYCoCgR
+} EliasColorTransform;
+
+class EliasPlanes
+{
+    public:
+    
+    static const unsigned int maxNumPlanes = 4;
+    
+    static inline
+    unsigned int numPlanes(EliasPixelFormat format) {
+        return (format == EliasPixelFormatBGRA) ? 4 : 3;
+    }
+    
+    // Forward YCoCg-R on one pixel, with the signed half of Co and Cg
+    
+    static inline
+    void forwardYCoCgR(uint8_t r, uint8_t g, uint8_t b, uint8_t & y, uint8_t & co, uint8_t & cg)
+    {
+        co = (uint8_t) (r - b);
+        uint8_t t = (uint8_t) (b + (((int8_t) co) >> 1));
+        cg = (uint8_t) (g - t);
+        y = (uint8_t) (t + (((int8_t) cg) >> 1));
+    }
+    
+    static inline
+    void inverseYCoCgR(uint8_t y, uint8_t co, uint8_t cg, uint8_t & r, uint8_t & g, uint8_t & b)
+    {
+        uint8_t t = (uint8_t) (y - (((int8_t) cg) >> 1));
+        g = (uint8_t) (cg + t);
+        b = (uint8_t) (t - (((int8_t) co) >> 1));
+        r = (uint8_t) (b + co);
+    }
+    
+    // Split numPixels interleaved pixels into raster planes. The plane
+    // order is B G R A for BGRA and R G B for RGB, or Y Co Cg (A) with
+    // the YCoCg-R transform.
+    
+    static void split(const uint8_t *pixels,
+                      int numPixels,
+                      EliasPixelFormat format,
+                      EliasColorTransform transform,
+                      uint8_t * const *planes)
+    {
+        if (format == EliasPixelFormatBGRA) {
+            if (transform == EliasColorTransformYCoCgR) {
+                splitPixels<4, 2, 1, 0, true>(pixels, numPixels, planes);
+            } else {
+                splitPixels<4, 2, 1, 0, false>(pixels, numPixels, planes);
+            }
+        } else {
+            if (transform == EliasColorTransformYCoCgR) {
+                splitPixels<3, 0, 1, 2, true>(pixels, numPixels, planes);
+            } else {
+                splitPixels<3, 0, 1, 2, false>(pixels, numPixels, planes);
+            }
+        }
+    }
+    
+    // Merge one row of blocks from block order planes into interleaved
+    // pixels. blockPlanes point at the first symbol of the block row in
+    // each plane, outRowsPtr points at the first pixel of the image row
+    // y = (blockY * BlockDim) and numRows rows are written.
+    
+    template <int BlockDim>
+    static void mergeBlockRow(const uint8_t * const *blockPlanes,
+                              int width,
+                              int numRows,
+                              int numBlocksInWidth,
+                              EliasPixelFormat format,
+                              EliasColorTransform transform,
+                              uint8_t *outRowsPtr,
+                              int outRowStride)
+    {
+        if (format == EliasPixelFormatBGRA) {
+            if (transform == EliasColorTransformYCoCgR) {
+                mergePixels<BlockDim, 4, 2, 1, 0, true>(blockPlanes, width, numRows, numBlocksInWidth, outRowsPtr, outRowStride);
+            } else {
+                mergePixels<BlockDim, 4, 2, 1, 0, false>(blockPlanes, width, numRows, numBlocksInWidth, outRowsPtr, outRowStride);
+            }
+        } else {
+            if (transform == EliasColorTransformYCoCgR) {
+                mergePixels<BlockDim, 3, 0, 1, 2, true>(blockPlanes, width, numRows, numBlocksInWidth, outRowsPtr, outRowStride);
+            } else {
+                mergePixels<BlockDim, 3, 0, 1, 2, false>(blockPlanes, width, numRows, numBlocksInWidth, outRowsPtr, outRowStride);
+            }
+        }
+    }
+    
+    private:
+    
+    // R G B are the byte offsets of each channel in a pixel, plane 0 1 2
+    // holds the channel at byte offset 0 1 2 unless transformed.
+    
+    template <int NumChannels, int R, int G, int B, bool YCoCg>
+    static void splitPixels(const uint8_t *pixels, int numPixels, uint8_t * const *planes)
+    {
+        uint8_t *plane0 = planes[0];
+        uint8_t *plane1 = planes[1];
+        uint8_t *plane2 = planes[2];
+        uint8_t *plane3 = (NumChannels == 4) ? planes[3] : NULL;
+        
+        for (int i = 0; i < numPixels; i++) {
+            const uint8_t *pixelPtr = pixels + (i * NumChannels);
+            
+            if (YCoCg) {
+                forwardYCoCgR(pixelPtr[R], pixelPtr[G], pixelPtr[B], plane0[i], plane1[i], plane2[i]);
+            } else {
+                plane0[i] = pixelPtr[0];
+                plane1[i] = pixelPtr[1];
+                plane2[i] = pixelPtr[2];
+            }
+            
+            if (NumChannels == 4) {
+                plane3[i] = pixelPtr[3];
+            }
+        }
+    }
+    
+    template <int BlockDim, int NumChannels, int R, int G, int B, bool YCoCg>
+    static void mergePixels(const uint8_t * const *blockPlanes,
+                            int width,
+                            int numRows,
+                            int numBlocksInWidth,
+                            uint8_t *outRowsPtr,
+                            int outRowStride)
+    {
+        const int numSymbolsInBlock = (BlockDim * BlockDim);
+        
+        for (int blockX = 0; blockX < numBlocksInWidth; blockX++) {
+            const int x = blockX * BlockDim;
+            const int numCols = (width - x) < BlockDim ? (width - x) : BlockDim;
+            const int blockOffset = blockX * numSymbolsInBlock;
+            
+            for (int row = 0; row < numRows; row++) {
+                const int symboli = blockOffset + (row * BlockDim);
+                const uint8_t *p0 = blockPlanes[0] + symboli;
+                const uint8_t *p1 = blockPlanes[1] + symboli;
+                const uint8_t *p2 = blockPlanes[2] + symboli;
+                const uint8_t *p3 = (NumChannels == 4) ? (blockPlanes[3] + symboli) : NULL;
+                uint8_t *outPtr = outRowsPtr + ((size_t)row * outRowStride) + (x * NumChannels);
+                
+                for (int col = 0; col < numCols; col++) {
+                    if (YCoCg) {
+                        inverseYCoCgR(p0[col], p1[col], p2[col], outPtr[R], outPtr[G], outPtr[B]);
+                    } else {
+                        outPtr[0] = p0[col];
+                        outPtr[1] = p1[col];
+                        outPtr[2] = p2[col];
+                    }
+                    
+                    if (NumChannels == 4) {
+                        outPtr[3] = p3[col];
+                    }
+                    
+                    outPtr += NumChannels;
+                }
+            }
+        }
+    }
+};
+
+#endif // elias_planes_hpp
@@ -0,0 +1,337 @@
+//
+//  elias_predict.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Block coding with a per block choice of 2D predictor and scan
+//  order. The plain block deltas predict each pixel from the
+//  previous byte in row major order, so the pixel above is ignored
+//  and the step from the end of one row to the start of the next
+//  gives a large delta. Each block here starts with a 4 bit mode
+//  header followed by the elias gamma codes of the zerod residuals
+//  in scan order. The mode is (scan * numPredictors + predictor):
+//
+//  row major  : left, up, average, MED (LOCO-I) or gradient
+//  serpentine : the same predictors with odd rows scanned right to
+//               left, the left neighbor is the previous pixel in scan
+//  hilbert    : previous pixel along the hilbert curve, left only
+//
+//  The first pixel of a row predicts from the pixel above, the first
+//  row predicts from the previous pixel and the first pixel predicts
+//  from zero. The up predictor ignores the scan direction, so
+//  serpentine up gives the same residuals as row major up and is not
+//  searched. The encoder keeps the mode with the fewest bits. All
+//  codes are MSB first and the block start bit offsets point at the
+//  mode header.
+
+#ifndef elias_predict_hpp
+#define elias_predict_hpp
+
+#include "elias.hpp"
+#include "elias_deltas.hpp"
+
+typedef enum {
+  EliasScanOrderRowMajor = 0,
+  EliasScanOrderSerpentine,
+  EliasScanOrderHilbert
+} EliasScanOrder;
+
+typedef enum {
+  EliasPredictorLeft = 0,
+  EliasPredictorUp,
+  EliasPredictorAverage,
+  EliasPredictorMED,
+  EliasPredictorGradient
+} EliasPredictor;
+
+class EliasBlockPredictors
+{
+    public:
+    
+    static const unsigned int numPredictors = 5;
+    static const unsigned int numModes = (2 * numPredictors) + 1;
+    static const unsigned int modeBitWidth = 4;
+    static const unsigned int maxNumSymbolsInBlock = 32 * 32;
+    
+    const int blockDim;
+    
+    // Block offset of each pixel in hilbert curve order
+    vector<uint16_t> hilbertOrder;
+    
+    EliasBlockPredictors(int blockDim) : blockDim(blockDim)
+    {
+#if defined(DEBUG)
+        assert(blockDim > 0 && (blockDim & (blockDim - 1)) == 0);
+        assert((blockDim * blockDim) <= (int) maxNumSymbolsInBlock);
+#endif // DEBUG
+    
+        const int numSymbolsInBlock = blockDim * blockDim;
+        hilbertOrder.resize(numSymbolsInBlock);
+    
+        for (int d = 0; d < numSymbolsInBlock; d++) {
+            int x = 0;
+            int y = 0;
+            int t = d;
+            for (int s = 1; s < blockDim; s *= 2) {
+                int rx = 1 & (t / 2);
+                int ry = 1 & (t ^ rx);
+                if (ry == 0) {
+                    if (rx == 1) {
+                        x = s - 1 - x;
+                        y = s - 1 - y;
+                    }
+                    int tmp = x;
+                    x = y;
+                    y = tmp;
+                }
+                x += s * rx;
+                y += s * ry;
+                t /= 4;
+            }
+            hilbertOrder[d] = (uint16_t) ((y * blockDim) + x);
+        }
+    }
+    
+    static inline
+    EliasScanOrder modeScanOrder(unsigned int mode) {
+        return (EliasScanOrder) (mode / numPredictors);
+    }
+    
+    static inline
+    EliasPredictor modePredictor(unsigned int mode) {
+        return (EliasPredictor) (mode % numPredictors);
+    }
+    
+    // A serpentine scan only changes the left neighbor, so serpentine
+    // up duplicates row major up
+    
+    static inline
+    bool isDuplicateMode(unsigned int mode) {
+        return modeScanOrder(mode) == EliasScanOrderSerpentine && modePredictor(mode) == EliasPredictorUp;
+    }
+    
+    // Predict a pixel from its left (w), upper (n) and upper left (nw)
+    // neighbors, left is the previous pixel in the row scan direction.
+    
+    static inline
+    uint8_t predict(EliasPredictor predictor, uint8_t w, uint8_t n, uint8_t nw)
+    {
+        switch (predictor) {
+            case EliasPredictorLeft: {
+                return w;
+            }
+            case EliasPredictorUp: {
+                return n;
+            }
+            case EliasPredictorAverage: {
+                return (uint8_t) ((w + n) >> 1);
+            }
+            case EliasPredictorMED: {
+                uint8_t minWN = min(w, n);
+                uint8_t maxWN = max(w, n);
+                if (nw >= maxWN) {
+                    return minWN;
+                } else if (nw <= minWN) {
+                    return maxWN;
+                } else {
+                    return (uint8_t) (w + n - nw);
+                }
+            }
+            default: {
+                int gradient = (int) w + (int) n - (int) nw;
+                return (uint8_t) max(0, min(255, gradient));
+            }
+        }
+    }
+    
+    // Walk the rows of a block with a fixed predictor, odd rows are
+    // scanned right to left when serpentine is true. To encode, in holds
+    // the block pixels and out gets the zerod residuals in scan order.
+    // To decode, in holds the zerod residuals and out gets the pixels.
+    // Predictions only read pixels that are already decoded.
+    
+    template <bool Decode, EliasPredictor Predictor>
+    void applyRows(bool serpentine, const uint8_t *in, uint8_t *out) const
+    {
+        const uint8_t *pixels = Decode ? out : in;
+        int i = 0;
+        
+        for (int y = 0; y < blockDim; y++) {
+            const bool reverse = serpentine && ((y & 0x1) != 0);
+            const int dx = reverse ? -1 : 1;
+            int pos = (y * blockDim) + (reverse ? (blockDim - 1) : 0);
+            
+            for (int k = 0; k < blockDim; k++, i++, pos += dx) {
+                uint8_t pred;
+                if (k == 0) {
+                    pred = (y == 0) ? 0 : pixels[pos - blockDim];
+                } else if (y == 0) {
+                    pred = pixels[pos - dx];
+                } else {
+                    pred = predict(Predictor, pixels[pos - dx], pixels[pos - blockDim], pixels[pos - blockDim - dx]);
+                }
+                
+                if (Decode) {
+                    out[pos] = (uint8_t) (pred + EliasZerodDeltas::delta(in[i]));
+                } else {
+                    out[i] = EliasZerodDeltas::zerodDelta(in[pos], pred);
+                }
+            }
+        }
+    }
+    
+    // Walk a block in the scan order of mode, see applyRows
+    
+    template <bool Decode>
+    void applyMode(unsigned int mode, const uint8_t *in, uint8_t *out) const
+    {
+        const EliasScanOrder scanOrder = modeScanOrder(mode);
+        const bool serpentine = (scanOrder == EliasScanOrderSerpentine);
+        
+        if (scanOrder == EliasScanOrderHilbert) {
+            const int numSymbolsInBlock = blockDim * blockDim;
+            uint8_t prev = 0;
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                const int pos = hilbertOrder[i];
+                if (Decode) {
+                    prev = (uint8_t) (prev + EliasZerodDeltas::delta(in[i]));
+                    out[pos] = prev;
+                } else {
+                    out[i] = EliasZerodDeltas::zerodDelta(in[pos], prev);
+                    prev = in[pos];
+                }
+            }
+            return;
+        }
+        
+        switch (modePredictor(mode)) {
+            case EliasPredictorLeft: {
+                applyRows<Decode, EliasPredictorLeft>(serpentine, in, out);
+                break;
+            }
+            case EliasPredictorUp: {
+                applyRows<Decode, EliasPredictorUp>(serpentine, in, out);
+                break;
+            }
+            case EliasPredictorAverage: {
+                applyRows<Decode, EliasPredictorAverage>(serpentine, in, out);
+                break;
+            }
+            case EliasPredictorMED: {
+                applyRows<Decode, EliasPredictorMED>(serpentine, in, out);
+                break;
+            }
+            default: {
+                applyRows<Decode, EliasPredictorGradient>(serpentine, in, out);
+                break;
+            }
+        }
+    }
+    
+    // Choose the mode with the fewest bits for a block of pixels, the
+    // zerod residuals of the chosen mode are written to residuals.
+    
+    unsigned int chooseMode(const uint8_t * blockPtr, uint8_t * residuals) const
+    {
+        const int numSymbolsInBlock = blockDim * blockDim;
+        uint8_t modeResiduals[maxNumSymbolsInBlock];
+        unsigned int bestMode = 0;
+        unsigned int bestNumBits = 0xFFFFFFFF;
+    
+        for (unsigned int mode = 0; mode < numModes; mode++) {
+            if (isDuplicateMode(mode)) {
+                continue;
+            }
+    
+            applyMode<false>(mode, blockPtr, modeResiduals);
+    
+            unsigned int numBits = 0;
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                numBits += EliasGamma_bitWidth(modeResiduals[i]);
+            }
+    
+            if (numBits < bestNumBits) {
+                bestMode = mode;
+                bestNumBits = numBits;
+                memcpy(residuals, modeResiduals, numSymbolsInBlock);
+            }
+        }
+    
+        return bestMode;
+    }
+    
+    // Encode each block of pixels in block order with a mode header, the
+    // bit offset of each block header is appended to blockBitOffsets.
+    // The encoder must be MSB first.
+    
+    void encodeBlocks(EliasGammaEncoderOpt64 & encoder,
+                      const uint8_t * pixels,
+                      int numSymbols,
+                      vector<uint32_t> & blockBitOffsets) const
+    {
+        const int numSymbolsInBlock = blockDim * blockDim;
+    
+#if defined(DEBUG)
+        assert(encoder.emitMSB);
+        assert((numSymbols % numSymbolsInBlock) == 0);
+#endif // DEBUG
+    
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        const int numBlocks = numSymbols / numSymbolsInBlock;
+    
+        // Header plus the largest code for each symbol
+        encoder.reserveSymbols(numSymbols + numBlocks);
+    
+        blockBitOffsets.reserve(blockBitOffsets.size() + numBlocks);
+    
+        uint8_t residuals[maxNumSymbolsInBlock];
+    
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint8_t * blockPtr = pixels + (blocki * numSymbolsInBlock);
+            const unsigned int mode = chooseMode(blockPtr, residuals);
+    
+            blockBitOffsets.push_back(encoder.numEncodedBits);
+    
+            EliasGammaCode header;
+            header.code = mode;
+            header.bitWidth = modeBitWidth;
+            encoder.encodeCode(header);
+    
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                encoder.encodeCode(table[residuals[i]]);
+            }
+        }
+    
+        encoder.finish();
+    }
+    
+    // Decode the block that starts at bitOffset to pixel values,
+    // returns the bit offset after the block.
+    
+    unsigned int decodeBlock(const uint8_t * encodedBitsPtr,
+                             const unsigned int numEncodedBytes,
+                             unsigned int bitOffset,
+                             uint8_t * decodedBytesPtr) const
+    {
+        const int numSymbolsInBlock = blockDim * blockDim;
+    
+        const uint8_t *bytePtr = encodedBitsPtr + (bitOffset >> 3);
+        const unsigned int word = (bytePtr[0] << 8) | bytePtr[1];
+        const unsigned int mode = (word >> (16 - modeBitWidth - (bitOffset & 0x7))) & 0xF;
+    
+#if defined(DEBUG)
+        assert(mode < numModes);
+#endif // DEBUG
+    
+        uint8_t residuals[maxNumSymbolsInBlock];
+    
+        bitOffset = EliasGammaDecoderTable<>::decodeSymbols(encodedBitsPtr, numEncodedBytes, bitOffset + modeBitWidth, numSymbolsInBlock, residuals);
+    
+        applyMode<true>(mode, residuals, decodedBytesPtr);
+
+        return bitOffset;
+    }
+};
+
+#endif // elias_predict_hpp
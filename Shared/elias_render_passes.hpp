@@ -0,0 +1,337 @@
+//
+//  elias_render_passes.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  CPU emulation of the render pass graph in drawInMTKView. Each
+//  decode pass runs one fragment per block, like fragmentShaderB8W12
+//  and fragmentShaderB8W16, and writes 4 symbols into each BGRA8
+//  render target. Every pass but the last also writes a state target
+//  with the 16 bit numBitsRead in B G and prevSymbol in R, the next
+//  pass reads it back to continue decoding the block. The symbol
+//  targets are then blitted into one combined slices texture and a
+//  crop pass writes one grayscale BGRA pixel for each image pixel.
+//
+//  A unorm8 channel written as (k / 255.0h) reads back as k, since
+//  the half precision error of k/255 is at most k * 2^-11 after the
+//  multiply by 255, so the state round trip is emulated with bytes.
+//
+//  The schedule sets the number of symbols decoded in each pass and
+//  the max number of render targets (MRT) a pass can write. The app
+//  schedule is 12 12 12 12 16 with 4 targets. The bytes read from
+//  textures and buffers and the bytes written to render targets are
+//  counted for each pass. This counts fetches as issued by the
+//  shaders, it does not model texture or tile caches.
+
+#ifndef elias_render_passes_hpp
+#define elias_render_passes_hpp
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+typedef enum {
+  EliasRenderPassDecode = 0,
+  EliasRenderPassBlit,
+  EliasRenderPassCrop
+} EliasRenderPassKind;
+
+typedef struct {
+  EliasRenderPassKind kind;
+  int numSymbols;
+  int numRenderTargets;
+  uint64_t textureBytesRead;
+  uint64_t bufferBytesRead;
+  uint64_t textureBytesWritten;
+} EliasRenderPassStats;
+
+class EliasRenderPassSchedule
+{
+    public:
+
+    // Symbols per block decoded by each pass, each is a multiple of 4
+
+    std::vector<int> symbolsPerPass;
+
+    int maxRenderTargets;
+
+    // When true, the symbol targets are blitted into one texture that
+    // the crop pass reads as in the app. Otherwise the crop pass reads
+    // each slice texture directly and there is no blit pass.
+
+    bool combineSlices;
+
+    EliasRenderPassSchedule() : maxRenderTargets(4), combineSlices(true)
+    {
+    }
+
+    // Fewest passes for numSymbolsInBlock with maxRenderTargets, each
+    // pass but the last keeps one target for the state. With 8x8 blocks
+    // and 4 targets this is the 12 12 12 12 16 schedule of the app.
+
+    static EliasRenderPassSchedule fewestPasses(int numSymbolsInBlock, int maxRenderTargets)
+    {
+        EliasRenderPassSchedule schedule;
+        schedule.maxRenderTargets = maxRenderTargets;
+
+        // A pass needs a state target and a symbol target, an empty
+        // schedule is not valid.
+
+        if (maxRenderTargets < 2) {
+            return schedule;
+        }
+
+        const int numInPass = (maxRenderTargets - 1) * 4;
+        const int numInLastPass = maxRenderTargets * 4;
+
+        int numLeft = numSymbolsInBlock;
+
+        while (numLeft > numInLastPass) {
+            schedule.symbolsPerPass.push_back(numInPass);
+            numLeft -= numInPass;
+        }
+
+        schedule.symbolsPerPass.push_back(numLeft);
+
+        return schedule;
+    }
+
+    // Render targets written by pass passi
+
+    int numRenderTargets(int passi) const {
+        const bool isLastPass = (passi + 1) == (int) symbolsPerPass.size();
+        return (symbolsPerPass[passi] / 4) + (isLastPass ? 0 : 1);
+    }
+
+    bool isValid(int numSymbolsInBlock) const {
+        if (symbolsPerPass.empty() || maxRenderTargets < 2) {
+            return false;
+        }
+        int numSymbols = 0;
+        for (int passi = 0; passi < (int) symbolsPerPass.size(); passi++) {
+            if (symbolsPerPass[passi] <= 0 || (symbolsPerPass[passi] % 4) != 0) {
+                return false;
+            }
+            if (numRenderTargets(passi) > maxRenderTargets) {
+                return false;
+            }
+            numSymbols += symbolsPerPass[passi];
+        }
+        return numSymbols == numSymbolsInBlock;
+    }
+};
+
+class EliasRenderPassEmulator
+{
+    public:
+
+    // Combined slices texture is at most 8 blocks wide, see the
+    // maxCol blit logic in drawInMTKView.
+
+    static const int maxNumSlicesInRow = 4096 / 512;
+
+    // Decode the blocks of a width x height image with the passes of
+    // schedule. The bitstream is MSB first with 2 padding bytes and
+    // blockStartBitOffsetsPtr has one offset for each block. The gray
+    // pixels written by the crop pass are stored in outPixels, the
+    // block order symbols are also stored in outBlockSymbols when not
+    // NULL. Returns false when the schedule does not fit blockDim.
+
+    static bool decode(const EliasRenderPassSchedule & schedule,
+                       const uint8_t *bitBuff,
+                       const uint32_t *blockStartBitOffsetsPtr,
+                       int width,
+                       int height,
+                       int blockDim,
+                       uint8_t *outPixels,
+                       int outRowStride,
+                       uint8_t *outBlockSymbols,
+                       std::vector<EliasRenderPassStats> & outStats)
+    {
+        const int numSymbolsInBlock = blockDim * blockDim;
+
+        if (!schedule.isValid(numSymbolsInBlock)) {
+            return false;
+        }
+
+        const int blockWidth = (width + blockDim - 1) / blockDim;
+        const int blockHeight = (height + blockDim - 1) / blockDim;
+        const int numBlocks = blockWidth * blockHeight;
+        const int numSlices = numSymbolsInBlock / 4;
+        const uint64_t numTextureBytes = (uint64_t) numBlocks * 4;
+
+        outStats.clear();
+
+        // One BGRA8 texel for each block in every slice texture, the
+        // state texture starts out as all zeros like _render12Zeros.
+
+        std::vector<std::vector<uint8_t> > slices(numSlices);
+        std::vector<uint8_t> state(numBlocks * 4, 0);
+
+        int slicei = 0;
+
+        for (int passi = 0; passi < (int) schedule.symbolsPerPass.size(); passi++) {
+            const int numSymbols = schedule.symbolsPerPass[passi];
+            const bool isLastPass = (passi + 1) == (int) schedule.symbolsPerPass.size();
+
+            EliasRenderPassStats stats;
+            stats.kind = EliasRenderPassDecode;
+            stats.numSymbols = numSymbols;
+            stats.numRenderTargets = schedule.numRenderTargets(passi);
+
+            for (int i = 0; i < (numSymbols / 4); i++) {
+                slices[slicei + i].resize(numBlocks * 4);
+            }
+
+            for (int blocki = 0; blocki < numBlocks; blocki++) {
+                uint8_t *statePtr = &state[blocki * 4];
+                uint16_t numBitsRead = (uint16_t) ((statePtr[1] << 8) | statePtr[0]);
+                uint16_t prevSymbol = statePtr[2];
+                const uint32_t numBitsReadForBlockRoot = blockStartBitOffsetsPtr[blocki];
+
+                for (int i = 0; i < (numSymbols / 4); i++) {
+                    uint8_t *texelPtr = &slices[slicei + i][blocki * 4];
+                    for (int c = 0; c < 4; c++) {
+                        texelPtr[c] = decodeOneSymbol(numBitsReadForBlockRoot, numBitsRead, prevSymbol, bitBuff);
+                    }
+                }
+
+                if (!isLastPass) {
+                    statePtr[0] = (uint8_t) (numBitsRead & 0xFF);
+                    statePtr[1] = (uint8_t) (numBitsRead >> 8);
+                    statePtr[2] = (uint8_t) prevSymbol;
+                    statePtr[3] = 0xFF;
+                }
+            }
+
+            // Each fragment reads the state texel, the block offset and
+            // 3 bitstream bytes for each symbol.
+
+            stats.textureBytesRead = numTextureBytes;
+            stats.bufferBytesRead = (uint64_t) numBlocks * (4 + (3 * numSymbols));
+            stats.textureBytesWritten = numTextureBytes * stats.numRenderTargets;
+            outStats.push_back(stats);
+
+            slicei += numSymbols / 4;
+        }
+
+        if (outBlockSymbols != NULL) {
+            for (int blocki = 0; blocki < numBlocks; blocki++) {
+                uint8_t *blockPtr = outBlockSymbols + (blocki * numSymbolsInBlock);
+                for (int i = 0; i < numSlices; i++) {
+                    memcpy(blockPtr + (i * 4), &slices[i][blocki * 4], 4);
+                }
+            }
+        }
+
+        // Blit each slice to the combined texture
+
+        const int combinedWidth = blockWidth * maxNumSlicesInRow;
+        std::vector<uint8_t> combined;
+
+        if (schedule.combineSlices) {
+            const int numSliceRows = (numSlices + maxNumSlicesInRow - 1) / maxNumSlicesInRow;
+            combined.resize((size_t) combinedWidth * (blockHeight * numSliceRows) * 4);
+
+            for (int i = 0; i < numSlices; i++) {
+                const int x = (i % maxNumSlicesInRow) * blockWidth;
+                const int y = (i / maxNumSlicesInRow) * blockHeight;
+                for (int row = 0; row < blockHeight; row++) {
+                    memcpy(&combined[(((size_t)(y + row) * combinedWidth) + x) * 4],
+                           &slices[i][row * blockWidth * 4],
+                           blockWidth * 4);
+                }
+            }
+
+            EliasRenderPassStats stats;
+            stats.kind = EliasRenderPassBlit;
+            stats.numSymbols = 0;
+            stats.numRenderTargets = 1;
+            stats.textureBytesRead = numTextureBytes * numSlices;
+            stats.bufferBytesRead = 0;
+            stats.textureBytesWritten = numTextureBytes * numSlices;
+            outStats.push_back(stats);
+        }
+
+        // Crop pass, see cropAndGrayscaleFromTexturesFragmentShader
+
+        for (int y = 0; y < height; y++) {
+            uint8_t *outRowPtr = outPixels + ((size_t)y * outRowStride);
+
+            for (int x = 0; x < width; x++) {
+                const int blockX = x / blockDim;
+                const int blockY = y / blockDim;
+                const int offsetFromBlockRoot = ((y - (blockY * blockDim)) * blockDim) + (x - (blockX * blockDim));
+                const int slice = offsetFromBlockRoot / 4;
+                const uint8_t *texelPtr;
+
+                if (schedule.combineSlices) {
+                    const int inX = blockX + ((slice % maxNumSlicesInRow) * blockWidth);
+                    const int inY = blockY + ((slice / maxNumSlicesInRow) * blockHeight);
+                    texelPtr = &combined[(((size_t)inY * combinedWidth) + inX) * 4];
+                } else {
+                    texelPtr = &slices[slice][((blockY * blockWidth) + blockX) * 4];
+                }
+
+                outRowPtr[x] = texelPtr[offsetFromBlockRoot % 4];
+            }
+        }
+
+        {
+            EliasRenderPassStats stats;
+            stats.kind = EliasRenderPassCrop;
+            stats.numSymbols = 0;
+            stats.numRenderTargets = 1;
+            stats.textureBytesRead = (uint64_t) width * height * 4;
+            stats.bufferBytesRead = 0;
+            stats.textureBytesWritten = (uint64_t) width * height * 4;
+            outStats.push_back(stats);
+        }
+
+        return true;
+    }
+
+    private:
+
+    // decode_one_eliasg_symbol() with the 8 bit clz of eliasgDecodeSymbol()
+
+    static inline
+    uint8_t decodeOneSymbol(const uint32_t numBitsReadForBlockRoot,
+                            uint16_t & numBitsRead,
+                            uint16_t & prevSymbol,
+                            const uint8_t *bitBuff)
+    {
+        const uint32_t currentNumBits = numBitsReadForBlockRoot + numBitsRead;
+        const uint8_t *bytePtr = bitBuff + (currentNumBits / 8);
+        const unsigned int numBitsReadMod8 = currentNumBits % 8;
+
+        uint16_t b0 = (uint16_t) ((bytePtr[0] << numBitsReadMod8) & 0xFF);
+        uint16_t inputBitPattern = (uint16_t) (b0 << 8);
+        inputBitPattern |= (uint16_t) (bytePtr[1] << numBitsReadMod8);
+        inputBitPattern |= (uint16_t) (bytePtr[2] >> (8 - numBitsReadMod8));
+
+        const uint8_t hiByte = (uint8_t) (inputBitPattern >> 8);
+        const unsigned int countOfZeros = (hiByte == 0) ? 8 : (__builtin_clz(hiByte) - 24);
+
+        uint16_t shiftedLeft = (uint16_t) (inputBitPattern << countOfZeros);
+        uint16_t shiftedRight = (uint16_t) (shiftedLeft >> (16 - (countOfZeros + 1)));
+
+        const uint8_t symbol = (uint8_t) (shiftedRight - 1);
+        numBitsRead = (uint16_t) (numBitsRead + ((countOfZeros << 1) + 1));
+
+        // offset_to_num_neg() maps 0 1 2 3 4 to 0 -1 1 -2 2
+
+        const uint16_t oneIfOdd = symbol & 0x1;
+        const uint16_t valDiv2 = (uint16_t) ((symbol + oneIfOdd) >> 1);
+        const uint16_t delta = oneIfOdd ? (uint16_t) (0 - valDiv2) : valDiv2;
+
+        prevSymbol = (uint16_t) ((prevSymbol + delta) & 0xFF);
+
+        return (uint8_t) prevSymbol;
+    }
+};
+
+#endif // elias_render_passes_hpp
@@ -0,0 +1,282 @@
+//
+//  elias_runs.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Block coding with fast paths for flat image areas. A flat area
+//  turns into long runs of zero deltas that each cost 1 bit and
+//  one decode step. Each block starts with a mode header:
+//
+//  1  : gamma block, blockDim * blockDim elias gamma codes as in the
+//       plain format
+//  01 : run block, like a gamma block except that the escape number
+//       257 is followed by the gamma code of (runLength - minZeroRun + 1)
+//       and stands for a run of runLength zero deltas
+//  00 : constant block, 8 bits hold the value of every pixel
+//
+//  A constant block decodes with a memset and a zero run decodes
+//  with a memset of zero deltas. The escape costs 17 bits, so only
+//  runs of at least minZeroRun zeros are escaped. Runs longer than
+//  maxZeroRun are split so that the run length code fits in 17 bits.
+//  All codes are MSB first and the block start bit offsets point at
+//  the mode header.
+
+#ifndef elias_runs_hpp
+#define elias_runs_hpp
+
+#include "elias.hpp"
+#include "elias_deltas.hpp"
+
+typedef enum {
+  EliasBlockModeGamma = 0,
+  EliasBlockModeRuns,
+  EliasBlockModeConstant
+} EliasBlockMode;
+
+class EliasGammaRunBlocks
+{
+    public:
+    
+    static const unsigned int minZeroRun = 20;
+    static const unsigned int maxZeroRun = minZeroRun + 510;
+    static const unsigned int escapeNumber = 257;
+    static const unsigned int maxBitsPerSymbol = 17;
+    
+    // Elias gamma code of a number in the range (1, 511)
+    
+    static inline
+    EliasGammaCode numberCode(unsigned int number) {
+        unsigned int highBitPosition = 31 - __builtin_clz(number);
+        EliasGammaCode egc;
+        egc.code = number;
+        egc.bitWidth = (highBitPosition * 2) + 1;
+        return egc;
+    }
+    
+    // Block mode header code
+    
+    static inline
+    EliasGammaCode headerCode(EliasBlockMode mode) {
+        EliasGammaCode header;
+        header.code = (mode == EliasBlockModeGamma) ? 1 : (mode == EliasBlockModeRuns) ? 1 : 0;
+        header.bitWidth = (mode == EliasBlockModeGamma) ? 1 : 2;
+        return header;
+    }
+    
+    // Length of the run of zero deltas that starts at symboli, at most maxZeroRun
+    
+    static inline
+    int zeroRunLength(const uint8_t * blockPtr, int symboli, int numSymbolsInBlock) {
+        int endi = symboli;
+        while (endi < numSymbolsInBlock && blockPtr[endi] == 0 && (endi - symboli) < (int) maxZeroRun) {
+            endi++;
+        }
+        return endi - symboli;
+    }
+    
+    // Number of bits needed to encode a block of zerod deltas in a mode
+    
+    static unsigned int numBits(const uint8_t * blockPtr, int numSymbolsInBlock, EliasBlockMode mode)
+    {
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        unsigned int numBlockBits = headerCode(mode).bitWidth;
+        
+        if (mode == EliasBlockModeConstant) {
+            return numBlockBits + 8;
+        }
+        
+        for (int i = 0; i < numSymbolsInBlock; ) {
+            int runLength = (mode == EliasBlockModeRuns) ? zeroRunLength(blockPtr, i, numSymbolsInBlock) : 0;
+            
+            if (runLength >= (int) minZeroRun) {
+                numBlockBits += numberCode(escapeNumber).bitWidth;
+                numBlockBits += numberCode(runLength - minZeroRun + 1).bitWidth;
+                i += runLength;
+            } else {
+                numBlockBits += table[blockPtr[i]].bitWidth;
+                i += 1;
+            }
+        }
+        
+        return numBlockBits;
+    }
+    
+    // A block is constant when every delta after the first is zero
+    
+    static bool isConstant(const uint8_t * blockPtr, int numSymbolsInBlock)
+    {
+        for (int i = 1; i < numSymbolsInBlock; i++) {
+            if (blockPtr[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // 8 bit code of the pixel value of every pixel in a constant block
+    
+    static inline
+    EliasGammaCode constantCode(const uint8_t * blockPtr)
+    {
+        EliasGammaCode value;
+        value.code = EliasZerodDeltas::delta(blockPtr[0]);
+        value.bitWidth = 8;
+        return value;
+    }
+    
+    // Choose the mode that encodes the block with the fewest bits
+    
+    static EliasBlockMode chooseMode(const uint8_t * blockPtr, int numSymbolsInBlock)
+    {
+        if (isConstant(blockPtr, numSymbolsInBlock)) {
+            return EliasBlockModeConstant;
+        }
+        
+        unsigned int numGammaBits = numBits(blockPtr, numSymbolsInBlock, EliasBlockModeGamma);
+        unsigned int numRunsBits = numBits(blockPtr, numSymbolsInBlock, EliasBlockModeRuns);
+        
+        return (numRunsBits < numGammaBits) ? EliasBlockModeRuns : EliasBlockModeGamma;
+    }
+    
+    // Encode each block of numSymbolsInBlock zerod deltas with a mode
+    // header, the bit offset of each block header is appended to
+    // blockBitOffsets. The encoder must be MSB first.
+    
+    static void encodeBlocks(EliasGammaEncoderOpt64 & encoder,
+                             const uint8_t * symbols,
+                             int numSymbols,
+                             int numSymbolsInBlock,
+                             vector<uint32_t> & blockBitOffsets)
+    {
+#if defined(DEBUG)
+        assert(encoder.emitMSB);
+        assert((numSymbols % numSymbolsInBlock) == 0);
+#endif // DEBUG
+        
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        const int numBlocks = numSymbols / numSymbolsInBlock;
+        
+        // Header plus the largest code for each symbol
+        encoder.reserveSymbols(numSymbols + numBlocks);
+        
+        blockBitOffsets.reserve(blockBitOffsets.size() + numBlocks);
+        
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint8_t * blockPtr = symbols + (blocki * numSymbolsInBlock);
+            const EliasBlockMode mode = chooseMode(blockPtr, numSymbolsInBlock);
+            
+            blockBitOffsets.push_back(encoder.numEncodedBits);
+            
+            encoder.encodeCode(headerCode(mode));
+            
+            if (mode == EliasBlockModeConstant) {
+                encoder.encodeCode(constantCode(blockPtr));
+                continue;
+            }
+            
+            for (int i = 0; i < numSymbolsInBlock; ) {
+                int runLength = (mode == EliasBlockModeRuns) ? zeroRunLength(blockPtr, i, numSymbolsInBlock) : 0;
+                
+                if (runLength >= (int) minZeroRun) {
+                    encoder.encodeCode(numberCode(escapeNumber));
+                    encoder.encodeCode(numberCode(runLength - minZeroRun + 1));
+                    i += runLength;
+                } else {
+                    encoder.encodeCode(table[blockPtr[i]]);
+                    i += 1;
+                }
+            }
+        }
+        
+        encoder.finish();
+    }
+    
+    // Decode one number in the range (1, 511) from a MSB aligned register
+    
+    static inline
+    unsigned int decodeNumber(uint64_t & bits, unsigned int & bitsThisSymbol)
+    {
+        unsigned int countOfZeros = __builtin_clzll(bits | (0x1ULL << (63 - 8)));
+        bitsThisSymbol = (countOfZeros << 1) + 1;
+        unsigned int number = (unsigned int) (bits >> (64 - bitsThisSymbol));
+        bits <<= bitsThisSymbol;
+        return number;
+    }
+    
+    // Decode the zerod deltas of a run block, returns the bit offset
+    // after the last symbol.
+    
+    static
+    unsigned int decodeRunSymbols(const uint8_t * encodedBitsPtr,
+                                  const unsigned int numEncodedBytes,
+                                  unsigned int bitOffset,
+                                  unsigned int numSymbols,
+                                  uint8_t * decodedBytesPtr)
+    {
+        uint8_t * const endPtr = decodedBytesPtr + numSymbols;
+        
+        while (decodedBytesPtr < endPtr) {
+            uint64_t bits;
+            unsigned int numBitsValid = EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+            
+            do {
+                unsigned int bitsThisSymbol;
+                unsigned int number = decodeNumber(bits, bitsThisSymbol);
+                bitOffset += bitsThisSymbol;
+                numBitsValid -= bitsThisSymbol;
+                
+                if (number == escapeNumber) {
+                    if (numBitsValid < maxBitsPerSymbol) {
+                        numBitsValid = EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+                    }
+                    unsigned int runLength = decodeNumber(bits, bitsThisSymbol) + minZeroRun - 1;
+                    bitOffset += bitsThisSymbol;
+                    numBitsValid -= bitsThisSymbol;
+#if defined(DEBUG)
+                    assert((decodedBytesPtr + runLength) <= endPtr);
+#endif // DEBUG
+                    memset(decodedBytesPtr, 0, runLength);
+                    decodedBytesPtr += runLength;
+                } else {
+#if defined(DEBUG)
+                    assert(number >= 1 && number <= 256);
+#endif // DEBUG
+                    *decodedBytesPtr++ = (uint8_t) (number - 1);
+                }
+            } while (decodedBytesPtr < endPtr && numBitsValid >= maxBitsPerSymbol);
+        }
+        
+        return bitOffset;
+    }
+    
+    // Read the mode header at bitOffset and decode one block to pixel
+    // values, returns the bit offset after the block.
+    
+    static
+    unsigned int decodeBlock(const uint8_t * encodedBitsPtr,
+                             const unsigned int numEncodedBytes,
+                             unsigned int bitOffset,
+                             unsigned int numSymbolsInBlock,
+                             uint8_t * decodedBytesPtr)
+    {
+        uint64_t bits;
+        EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+        
+        if ((bits >> 63) != 0) {
+            bitOffset = EliasGammaDecoderTable<>::decodeSymbols(encodedBitsPtr, numEncodedBytes, bitOffset + 1, numSymbolsInBlock, decodedBytesPtr);
+        } else if ((bits >> 62) != 0) {
+            bitOffset = decodeRunSymbols(encodedBitsPtr, numEncodedBytes, bitOffset + 2, numSymbolsInBlock, decodedBytesPtr);
+        } else {
+            uint8_t value = (uint8_t) (bits >> (64 - 2 - 8));
+            memset(decodedBytesPtr, value, numSymbolsInBlock);
+            return bitOffset + 2 + 8;
+        }
+        
+        EliasZerodDeltas::undoDeltas(decodedBytesPtr, numSymbolsInBlock);
+        
+        return bitOffset;
+    }
+};
+
+#endif // elias_runs_hpp
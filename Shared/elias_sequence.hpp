@@ -0,0 +1,595 @@
+//
+//  elias_sequence.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  Multi frame sequence of images coded with temporal block deltas.
+//  Each block of frame N is coded against the same block of frame
+//  N-1 and starts with a mode header:
+//
+//  0  : unchanged block, no other bits and no decode work
+//  10 : temporal block, elias gamma codes of the zerod delta from
+//       the pixel at the same position in the previous frame
+//  11 : intra block, elias gamma codes of the zerod deltas between
+//       pixels of the block as in the plain block format
+//
+//  The decoder keeps the previous frame in block order and updates
+//  it in place. All codes are MSB first. The first frame is coded
+//  against an all zero frame, so it only contains intra blocks.
+//
+//  A per block offset would cost 32 bits for an unchanged block that
+//  is coded in 1 bit, so the block index of a frame only stores the
+//  bit offset of the first block in each group of (1 << groupShift)
+//  blocks. Blocks in a group are decoded in order and groups can be
+//  decoded independently.
+//
+//  File layout, all values are little endian and each section starts
+//  at a 64 byte aligned file offset like EliasContainer. The frame
+//  table is written after the frames so that frames can be streamed
+//  to disk as they are encoded.
+//
+//  Header (64 bytes):
+//
+//  bytes 0-3   : magic "ELGS"
+//  bytes 4-5   : version
+//  bytes 6-7   : header size in bytes
+//  bytes 8-11  : image width
+//  bytes 12-15 : image height
+//  byte 16     : blockDim, one of 4, 8, 16, 32
+//  byte 17     : bit order, 0 = MSB first
+//  byte 18     : number of zero padding bytes at the end of each bitstream
+//  byte 19     : groupShift, log2 of the number of blocks in a group
+//  bytes 20-23 : number of blocks in a frame
+//  bytes 24-27 : number of frames
+//  bytes 28-31 : zero
+//  bytes 32-39 : file offset of the frame table
+//  bytes 40-63 : zero
+//
+//  Frame table entry (32 bytes):
+//
+//  bytes 0-7   : file offset of the frame group bit offsets section
+//  bytes 8-15  : file offset of the frame bitstream section
+//  bytes 16-23 : size of the frame bitstream section including padding
+//  bytes 24-31 : zero
+
+#ifndef elias_sequence_hpp
+#define elias_sequence_hpp
+
+#include "elias.hpp"
+#include "elias_deltas.hpp"
+#include "elias_container.hpp"
+
+typedef enum {
+  EliasTemporalModeUnchanged = 0,
+  EliasTemporalModeDelta,
+  EliasTemporalModeIntra
+} EliasTemporalMode;
+
+class EliasTemporalBlocks
+{
+    public:
+    
+    static const unsigned int maxNumSymbolsInBlock = 32 * 32;
+    
+    // Block mode header code
+    
+    static inline
+    EliasGammaCode headerCode(EliasTemporalMode mode) {
+        EliasGammaCode header;
+        header.code = (mode == EliasTemporalModeUnchanged) ? 0 : (mode == EliasTemporalModeDelta) ? 2 : 3;
+        header.bitWidth = (mode == EliasTemporalModeUnchanged) ? 1 : 2;
+        return header;
+    }
+    
+    // Number of bits needed to encode a block in a mode, prevBlockPtr
+    // is only read for the temporal mode.
+    
+    static unsigned int numBits(const uint8_t * blockPtr,
+                                const uint8_t * prevBlockPtr,
+                                int numSymbolsInBlock,
+                                EliasTemporalMode mode)
+    {
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        unsigned int numBlockBits = headerCode(mode).bitWidth;
+        
+        if (mode == EliasTemporalModeUnchanged) {
+            return numBlockBits;
+        }
+        
+        uint8_t prev = 0;
+        
+        for (int i = 0; i < numSymbolsInBlock; i++) {
+            if (mode == EliasTemporalModeDelta) {
+                prev = prevBlockPtr[i];
+            }
+            numBlockBits += table[EliasZerodDeltas::zerodDelta(blockPtr[i], prev)].bitWidth;
+            prev = blockPtr[i];
+        }
+        
+        return numBlockBits;
+    }
+    
+    // Choose the mode that encodes the block with the fewest bits,
+    // prevBlockPtr is NULL for the first frame.
+    
+    static EliasTemporalMode chooseMode(const uint8_t * blockPtr,
+                                        const uint8_t * prevBlockPtr,
+                                        int numSymbolsInBlock)
+    {
+        if (prevBlockPtr == NULL) {
+            return EliasTemporalModeIntra;
+        }
+        if (memcmp(blockPtr, prevBlockPtr, numSymbolsInBlock) == 0) {
+            return EliasTemporalModeUnchanged;
+        }
+        
+        unsigned int numDeltaBits = numBits(blockPtr, prevBlockPtr, numSymbolsInBlock, EliasTemporalModeDelta);
+        unsigned int numIntraBits = numBits(blockPtr, prevBlockPtr, numSymbolsInBlock, EliasTemporalModeIntra);
+        
+        return (numDeltaBits < numIntraBits) ? EliasTemporalModeDelta : EliasTemporalModeIntra;
+    }
+    
+    // Encode one frame of block order pixels against the previous frame,
+    // prevBlockPixels is NULL for the first frame. The bit offset of each
+    // block header is appended to blockBitOffsets. The encoder must be
+    // MSB first.
+    
+    static void encodeFrame(EliasGammaEncoderOpt64 & encoder,
+                            const uint8_t * blockPixels,
+                            const uint8_t * prevBlockPixels,
+                            int numSymbols,
+                            int numSymbolsInBlock,
+                            vector<uint32_t> & blockBitOffsets)
+    {
+#if defined(DEBUG)
+        assert(encoder.emitMSB);
+        assert((numSymbols % numSymbolsInBlock) == 0);
+#endif // DEBUG
+        
+        const EliasGammaCode *table = EliasGamma_codeTable(true);
+        const int numBlocks = numSymbols / numSymbolsInBlock;
+        
+        // Header plus the largest code for each symbol
+        encoder.reserveSymbols(numSymbols + numBlocks);
+        
+        blockBitOffsets.reserve(blockBitOffsets.size() + numBlocks);
+        
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            const uint8_t * blockPtr = blockPixels + (blocki * numSymbolsInBlock);
+            const uint8_t * prevBlockPtr = prevBlockPixels ? (prevBlockPixels + (blocki * numSymbolsInBlock)) : NULL;
+            const EliasTemporalMode mode = chooseMode(blockPtr, prevBlockPtr, numSymbolsInBlock);
+            
+            blockBitOffsets.push_back(encoder.numEncodedBits);
+            
+            encoder.encodeCode(headerCode(mode));
+            
+            if (mode == EliasTemporalModeUnchanged) {
+                continue;
+            }
+            
+            uint8_t prev = 0;
+            
+            for (int i = 0; i < numSymbolsInBlock; i++) {
+                if (mode == EliasTemporalModeDelta) {
+                    prev = prevBlockPtr[i];
+                }
+                encoder.encodeCode(table[EliasZerodDeltas::zerodDelta(blockPtr[i], prev)]);
+                prev = blockPtr[i];
+            }
+        }
+        
+        encoder.finish();
+    }
+    
+    // Read the mode header at bitOffset and update one block of the
+    // previous frame in place, scratchPtr holds numSymbolsInBlock
+    // temporal deltas. Returns the bit offset after the block.
+    
+    static
+    unsigned int decodeBlock(const uint8_t * encodedBitsPtr,
+                             const unsigned int numEncodedBytes,
+                             unsigned int bitOffset,
+                             unsigned int numSymbolsInBlock,
+                             uint8_t * blockPtr,
+                             uint8_t * scratchPtr)
+    {
+        uint64_t bits;
+        EliasGammaDecoderOpt64::refill<true>(encodedBitsPtr, numEncodedBytes, bitOffset, bits);
+        
+        if ((bits >> 63) == 0) {
+            return bitOffset + 1;
+        } else if ((bits >> 62) == 2) {
+            bitOffset = EliasGammaDecoderTable<>::decodeSymbols(encodedBitsPtr, numEncodedBytes, bitOffset + 2, numSymbolsInBlock, scratchPtr);
+            EliasZerodDeltas::addDeltas(blockPtr, scratchPtr, numSymbolsInBlock);
+        } else {
+            bitOffset = EliasGammaDecoderTable<>::decodeSymbols(encodedBitsPtr, numEncodedBytes, bitOffset + 2, numSymbolsInBlock, blockPtr);
+            EliasZerodDeltas::undoDeltas(blockPtr, numSymbolsInBlock);
+        }
+        
+        return bitOffset;
+    }
+    
+    // Update a whole frame of block order pixels in place, each group
+    // of (1 << groupShift) blocks starts at its group bit offset.
+    
+    static void decodeFrame(const uint8_t * encodedBitsPtr,
+                            const unsigned int numEncodedBytes,
+                            const uint32_t * groupBitOffsetsPtr,
+                            int numBlocks,
+                            unsigned int groupShift,
+                            unsigned int numSymbolsInBlock,
+                            uint8_t * blockPixels)
+    {
+#if defined(DEBUG)
+        assert(numSymbolsInBlock <= maxNumSymbolsInBlock);
+#endif // DEBUG
+        
+        uint8_t scratch[maxNumSymbolsInBlock];
+        unsigned int bitOffset = 0;
+        
+        for (int blocki = 0; blocki < numBlocks; blocki++) {
+            if ((blocki & ((1 << groupShift) - 1)) == 0) {
+                bitOffset = groupBitOffsetsPtr[blocki >> groupShift];
+            }
+            bitOffset = decodeBlock(encodedBitsPtr, numEncodedBytes, bitOffset, numSymbolsInBlock,
+                                    blockPixels + (blocki * numSymbolsInBlock), scratch);
+        }
+    }
+    
+};
+
+// Header and frame table of a sequence file
+
+class EliasSequenceContainer
+{
+    public:
+    
+    static const unsigned int version = 1;
+    static const unsigned int headerNumBytes = 64;
+    static const unsigned int frameEntryNumBytes = 32;
+    static const unsigned int defaultGroupShift = 5;
+    
+    typedef struct {
+        uint64_t groupOffsetsFileOffset;
+        uint64_t codesFileOffset;
+        uint64_t codesNumBytes;
+    } Frame;
+    
+    unsigned int width;
+    unsigned int height;
+    unsigned int blockDim;
+    EliasBitOrder bitOrder;
+    unsigned int paddingNumBytes;
+    unsigned int numBlocks;
+    unsigned int groupShift;
+    uint64_t frameTableFileOffset;
+    vector<Frame> frames;
+    
+    EliasSequenceContainer()
+    : width(0), height(0), blockDim(8), bitOrder(EliasBitOrderMSB),
+    paddingNumBytes(EliasContainer::minPaddingNumBytes), numBlocks(0), groupShift(defaultGroupShift), frameTableFileOffset(0) {
+    }
+    
+    // Number of block order symbols in one frame
+    
+    unsigned int numSymbols() const {
+        return numBlocks * (blockDim * blockDim);
+    }
+    
+    // Number of group bit offsets in the block index of a frame
+    
+    unsigned int numGroups() const {
+        return (unsigned int) (((uint64_t) numBlocks + (1 << groupShift) - 1) >> groupShift);
+    }
+    
+    // Serialize the header to headerNumBytes bytes
+    
+    void writeHeader(uint8_t *headerPtr) const
+    {
+        memset(headerPtr, 0, headerNumBytes);
+        memcpy(headerPtr, "ELGS", 4);
+        EliasContainer::storeLE(headerPtr + 4, version, 2);
+        EliasContainer::storeLE(headerPtr + 6, headerNumBytes, 2);
+        EliasContainer::storeLE(headerPtr + 8, width, 4);
+        EliasContainer::storeLE(headerPtr + 12, height, 4);
+        headerPtr[16] = (uint8_t) blockDim;
+        headerPtr[17] = (uint8_t) bitOrder;
+        headerPtr[18] = (uint8_t) paddingNumBytes;
+        headerPtr[19] = (uint8_t) groupShift;
+        EliasContainer::storeLE(headerPtr + 20, numBlocks, 4);
+        EliasContainer::storeLE(headerPtr + 24, frames.size(), 4);
+        EliasContainer::storeLE(headerPtr + 32, frameTableFileOffset, 8);
+    }
+    
+    // Serialize the frame table
+    
+    void writeFrameTable(vector<uint8_t> & bytes) const
+    {
+        bytes.assign(frames.size() * frameEntryNumBytes, 0);
+        
+        for (size_t framei = 0; framei < frames.size(); framei++) {
+            uint8_t *entryPtr = bytes.data() + (framei * frameEntryNumBytes);
+            EliasContainer::storeLE(entryPtr, frames[framei].groupOffsetsFileOffset, 8);
+            EliasContainer::storeLE(entryPtr + 8, frames[framei].codesFileOffset, 8);
+            EliasContainer::storeLE(entryPtr + 16, frames[framei].codesNumBytes, 8);
+        }
+    }
+    
+    // Parse and validate the header and frame table, returns false if
+    // any section does not fit in bytesN, a field is out of range or the
+    // group offsets of a frame decrease or point past its bitstream.
+    
+    bool read(const uint8_t *bytesPtr, uint64_t bytesN)
+    {
+        if (bytesN < headerNumBytes || memcmp(bytesPtr, "ELGS", 4) != 0) {
+            return false;
+        }
+        if (EliasContainer::loadLE(bytesPtr + 4, 2) != version || EliasContainer::loadLE(bytesPtr + 6, 2) != headerNumBytes) {
+            return false;
+        }
+        
+        width = (unsigned int) EliasContainer::loadLE(bytesPtr + 8, 4);
+        height = (unsigned int) EliasContainer::loadLE(bytesPtr + 12, 4);
+        blockDim = bytesPtr[16];
+        const unsigned int bitOrderByte = bytesPtr[17];
+        paddingNumBytes = bytesPtr[18];
+        groupShift = bytesPtr[19];
+        numBlocks = (unsigned int) EliasContainer::loadLE(bytesPtr + 20, 4);
+        const uint64_t numFrames = EliasContainer::loadLE(bytesPtr + 24, 4);
+        frameTableFileOffset = EliasContainer::loadLE(bytesPtr + 32, 8);
+        
+        if (blockDim != 4 && blockDim != 8 && blockDim != 16 && blockDim != 32) {
+            return false;
+        }
+        if (bitOrderByte != EliasBitOrderMSB || paddingNumBytes < EliasContainer::minPaddingNumBytes || groupShift > 16) {
+            return false;
+        }
+        bitOrder = (EliasBitOrder) bitOrderByte;
+        
+        const uint64_t numBlocksInWidth = (width + blockDim - 1) / blockDim;
+        const uint64_t numBlocksInHeight = (height + blockDim - 1) / blockDim;
+        
+        if (numBlocks != (numBlocksInWidth * numBlocksInHeight)) {
+            return false;
+        }
+        if ((frameTableFileOffset % EliasContainer::sectionAlignment) != 0 ||
+            frameTableFileOffset < headerNumBytes ||
+            frameTableFileOffset > bytesN ||
+            (numFrames * frameEntryNumBytes) > (bytesN - frameTableFileOffset)) {
+            return false;
+        }
+        
+        frames.resize((size_t) numFrames);
+        
+        for (size_t framei = 0; framei < frames.size(); framei++) {
+            const uint8_t *entryPtr = bytesPtr + frameTableFileOffset + (framei * frameEntryNumBytes);
+            Frame & frame = frames[framei];
+            frame.groupOffsetsFileOffset = EliasContainer::loadLE(entryPtr, 8);
+            frame.codesFileOffset = EliasContainer::loadLE(entryPtr + 8, 8);
+            frame.codesNumBytes = EliasContainer::loadLE(entryPtr + 16, 8);
+            
+            if ((frame.groupOffsetsFileOffset % EliasContainer::sectionAlignment) != 0 ||
+                (frame.codesFileOffset % EliasContainer::sectionAlignment) != 0) {
+                return false;
+            }
+            if (frame.groupOffsetsFileOffset < headerNumBytes ||
+                frame.groupOffsetsFileOffset > frame.codesFileOffset ||
+                ((uint64_t) numGroups() * 4) > (frame.codesFileOffset - frame.groupOffsetsFileOffset) ||
+                frame.codesFileOffset > frameTableFileOffset ||
+                frame.codesNumBytes > (frameTableFileOffset - frame.codesFileOffset) ||
+                frame.codesNumBytes < paddingNumBytes) {
+                return false;
+            }
+            
+            // Decoders read ahead into the padding, so it must be zero
+            
+            const uint8_t *paddingPtr = bytesPtr + frame.codesFileOffset + frame.codesNumBytes - paddingNumBytes;
+            for (unsigned int i = 0; i < paddingNumBytes; i++) {
+                if (paddingPtr[i] != 0) {
+                    return false;
+                }
+            }
+            
+            // Each group must start inside the bitstream and after the
+            // start of the previous group
+            
+            const uint8_t *groupOffsetsPtr = bytesPtr + frame.groupOffsetsFileOffset;
+            uint64_t prevBitOffset = 0;
+            for (unsigned int groupi = 0; groupi < numGroups(); groupi++) {
+                const uint64_t bitOffset = EliasContainer::loadLE(groupOffsetsPtr + (groupi * 4), 4);
+                if (bitOffset < prevBitOffset || bitOffset >= (frame.codesNumBytes * 8)) {
+                    return false;
+                }
+                prevBitOffset = bitOffset;
+            }
+        }
+        
+        return true;
+    }
+};
+
+// Append frames to a sequence file as they are encoded, only the frame
+// table is held in memory. The header is written by finish().
+
+class EliasSequenceWriter
+{
+    public:
+    
+    EliasSequenceContainer sequence;
+    
+    EliasSequenceWriter()
+    : fp(NULL), fileOffset(0) {
+    }
+    
+    ~EliasSequenceWriter() {
+        if (fp != NULL) {
+            fclose(fp);
+        }
+    }
+    
+    // Create the file and reserve space for the header, returns false
+    // on an IO error.
+    
+    bool open(const char *path, unsigned int width, unsigned int height, unsigned int blockDim)
+    {
+        sequence = EliasSequenceContainer();
+        sequence.width = width;
+        sequence.height = height;
+        sequence.blockDim = blockDim;
+        sequence.numBlocks = ((width + blockDim - 1) / blockDim) * ((height + blockDim - 1) / blockDim);
+        
+        fp = fopen(path, "wb");
+        fileOffset = 0;
+        
+        if (fp == NULL) {
+            return false;
+        }
+        
+        uint8_t header[EliasSequenceContainer::headerNumBytes];
+        memset(header, 0, sizeof(header));
+        return writeBytes(header, sizeof(header));
+    }
+    
+    // Append the codes and block offsets of the next frame, only the
+    // offset of the first block in each group is written. The codes
+    // must end with padding zeros, as emitted by an encoder with
+    // emitPaddingZeros set.
+    
+    bool appendFrame(const uint8_t *codesPtr,
+                     uint64_t codesNumBytes,
+                     const uint32_t *blockBitOffsetsPtr)
+    {
+#if defined(DEBUG)
+        assert(fp != NULL);
+        assert(codesNumBytes >= sequence.paddingNumBytes);
+        for (unsigned int i = 0; i < sequence.paddingNumBytes; i++) {
+            assert(codesPtr[codesNumBytes - 1 - i] == 0);
+        }
+#endif // DEBUG
+        
+        EliasSequenceContainer::Frame frame;
+        
+        vector<uint8_t> offsetBytes(sequence.numGroups() * 4);
+        for (unsigned int groupi = 0; groupi < sequence.numGroups(); groupi++) {
+            EliasContainer::storeLE(offsetBytes.data() + (groupi * 4), blockBitOffsetsPtr[groupi << sequence.groupShift], 4);
+        }
+        
+        if (!alignFile()) {
+            return false;
+        }
+        frame.groupOffsetsFileOffset = fileOffset;
+        if (!writeBytes(offsetBytes.data(), offsetBytes.size()) || !alignFile()) {
+            return false;
+        }
+        frame.codesFileOffset = fileOffset;
+        frame.codesNumBytes = codesNumBytes;
+        if (!writeBytes(codesPtr, codesNumBytes)) {
+            return false;
+        }
+        
+        sequence.frames.push_back(frame);
+        
+        return true;
+    }
+    
+    // Write the frame table and the header and close the file
+    
+    bool finish()
+    {
+        vector<uint8_t> tableBytes;
+        sequence.writeFrameTable(tableBytes);
+        
+        bool worked = alignFile();
+        sequence.frameTableFileOffset = fileOffset;
+        worked = worked && writeBytes(tableBytes.data(), tableBytes.size());
+        
+        uint8_t header[EliasSequenceContainer::headerNumBytes];
+        sequence.writeHeader(header);
+        worked = worked && (fseek(fp, 0, SEEK_SET) == 0);
+        worked = worked && (fwrite(header, 1, sizeof(header), fp) == sizeof(header));
+        
+        int closeResult = fclose(fp);
+        fp = NULL;
+        
+        return worked && (closeResult == 0);
+    }
+    
+    private:
+    
+    FILE *fp;
+    uint64_t fileOffset;
+    
+    bool writeBytes(const uint8_t *ptr, uint64_t numBytes)
+    {
+        if (numBytes > 0 && fwrite(ptr, 1, (size_t) numBytes, fp) != numBytes) {
+            return false;
+        }
+        fileOffset += numBytes;
+        return true;
+    }
+    
+    // Zero pad the file to the next section boundary
+    
+    bool alignFile()
+    {
+        const uint8_t zeros[EliasContainer::sectionAlignment] = { 0 };
+        return writeBytes(zeros, EliasContainer::alignSection(fileOffset) - fileOffset);
+    }
+    
+    EliasSequenceWriter(const EliasSequenceWriter &);
+    EliasSequenceWriter & operator=(const EliasSequenceWriter &);
+};
+
+// Read only memory mapping of a sequence file, the group offsets and
+// bitstream of each frame point into the mapping.
+
+class EliasSequenceMapping
+{
+    public:
+    
+    EliasSequenceContainer sequence;
+    
+    // Map the file and validate the header and frame table, returns
+    // false if the file cannot be mapped or is not a valid sequence.
+    
+    bool open(const char *path)
+    {
+        close();
+        
+        if (!EliasContainer::hostIsLittleEndian() || !mapping.open(path)) {
+            return false;
+        }
+        
+        if (!sequence.read(mapping.bytesPtr, mapping.numBytes)) {
+            close();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    void close()
+    {
+        mapping.close();
+        sequence.frames.clear();
+    }
+    
+    unsigned int numFrames() const {
+        return (unsigned int) sequence.frames.size();
+    }
+    
+    const uint32_t * groupBitOffsetsPtr(unsigned int framei) const {
+        return (const uint32_t *) (mapping.bytesPtr + sequence.frames[framei].groupOffsetsFileOffset);
+    }
+    
+    const uint8_t * codesPtr(unsigned int framei) const {
+        return mapping.bytesPtr + sequence.frames[framei].codesFileOffset;
+    }
+    
+    private:
+    
+    EliasFileMapping mapping;
+};
+
+#endif // elias_sequence_hpp
@@ -0,0 +1,404 @@
+//
+//  elias_simd.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  SIMD block decoder where each vector lane decodes its own
+//  8x8 block, this is the CPU version of the fragment shader
+//  approach where each pixel decodes one block. Each lane
+//  reads a 32 bit window at its own bit offset, counts leading
+//  zeros to find the code width and then undoes the block
+//  deltas in lockstep with the other lanes. Decoded symbols
+//  are written to the output with a lane transpose.
+
+#ifndef elias_simd_hpp
+#define elias_simd_hpp
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ELIAS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ELIAS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef enum {
+  EliasSIMDLevelScalar = 0,
+  EliasSIMDLevelSSE41,
+  EliasSIMDLevelAVX2,
+  EliasSIMDLevelNEON
+} EliasSIMDLevel;
+
+class EliasGammaBlockDecoderSIMD
+{
+    public:
+    
+    enum {
+        blockDim = 8,
+        numSymbolsInBlock = (blockDim * blockDim)
+    };
+    
+    // Query the best instruction set supported by the CPU at runtime
+    
+    static EliasSIMDLevel detectLevel()
+    {
+#if defined(ELIAS_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+        if (__builtin_cpu_supports("avx2")) {
+            return EliasSIMDLevelAVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return EliasSIMDLevelSSE41;
+        }
+        return EliasSIMDLevelScalar;
+#elif defined(ELIAS_SIMD_NEON)
+        return EliasSIMDLevelNEON;
+#else
+        return EliasSIMDLevelScalar;
+#endif
+    }
+    
+    static EliasSIMDLevel level()
+    {
+        static const EliasSIMDLevel detectedLevel = detectLevel();
+        return detectedLevel;
+    }
+    
+    // The number of blocks decoded at the same time, 0 for scalar
+    
+    static int numLanes(EliasSIMDLevel simdLevel)
+    {
+        switch (simdLevel) {
+            case EliasSIMDLevelAVX2:
+                return 8;
+            case EliasSIMDLevelSSE41:
+            case EliasSIMDLevelNEON:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+    
+    // Decode blocks starting at startBlocki in groups of numLanes(simdLevel)
+    // blocks and return the block index where SIMD decoding stopped. A group
+    // is only decoded when the 32 bit window reads of every lane are known to
+    // be inside the buffer, the remaining blocks must be decoded by the caller
+    // with a scalar decoder. MSB first bit order and block deltas are assumed.
+    
+    static int decodeBlocks(EliasSIMDLevel simdLevel,
+                            const uint8_t *bitBuff,
+                            int bitBuffN,
+                            const uint32_t *blockStartBitOffsetsPtr,
+                            int startBlocki,
+                            int numBlocks,
+                            uint8_t *outBuffer)
+    {
+        const int lanes = numLanes(simdLevel);
+        int blocki = startBlocki;
+        
+        if (lanes == 0) {
+            return blocki;
+        }
+        
+        // A group ends at the start offset of the next block, so the final
+        // group that contains the last block is left for the scalar decoder.
+        
+        for ( ; (blocki + lanes) < numBlocks; blocki += lanes ) {
+            uint32_t groupEndBitOffset = blockStartBitOffsetsPtr[blocki + lanes];
+            if (((groupEndBitOffset >> 3) + 4) > (uint32_t) bitBuffN) {
+                break;
+            }
+            
+            const uint32_t *groupOffsetsPtr = blockStartBitOffsetsPtr + blocki;
+            uint8_t *groupOutPtr = outBuffer + (blocki * numSymbolsInBlock);
+            
+            switch (simdLevel) {
+#if defined(ELIAS_SIMD_X86)
+                case EliasSIMDLevelAVX2:
+                    decodeGroupAVX2(bitBuff, groupOffsetsPtr, groupOutPtr);
+                    break;
+                case EliasSIMDLevelSSE41:
+                    decodeGroupSSE41(bitBuff, groupOffsetsPtr, groupOutPtr);
+                    break;
+#endif // ELIAS_SIMD_X86
+#if defined(ELIAS_SIMD_NEON)
+                case EliasSIMDLevelNEON:
+                    decodeGroupNEON(bitBuff, groupOffsetsPtr, groupOutPtr);
+                    break;
+#endif // ELIAS_SIMD_NEON
+                default:
+                    return blocki;
+            }
+        }
+        
+        return blocki;
+    }
+    
+    private:
+    
+    static inline uint32_t load32BE(const uint8_t *ptr)
+    {
+        uint32_t word;
+        memcpy(&word, ptr, sizeof(word));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        word = __builtin_bswap32(word);
+#endif
+        return word;
+    }
+
+#if defined(ELIAS_SIMD_X86)
+    
+    // 8x8 byte transpose where the rows are 8 decode steps of 8 lanes,
+    // each lane's 8 symbols are then written to that lane's block.
+    
+    __attribute__((target("sse2")))
+    static inline void transposeStore8x8(const uint8_t *stagingPtr, uint8_t *outPtr)
+    {
+        __m128i r01 = _mm_loadu_si128((const __m128i *) (stagingPtr + 0));
+        __m128i r23 = _mm_loadu_si128((const __m128i *) (stagingPtr + 16));
+        __m128i r45 = _mm_loadu_si128((const __m128i *) (stagingPtr + 32));
+        __m128i r67 = _mm_loadu_si128((const __m128i *) (stagingPtr + 48));
+        
+        __m128i a = _mm_unpacklo_epi8(r01, _mm_srli_si128(r01, 8));
+        __m128i b = _mm_unpacklo_epi8(r23, _mm_srli_si128(r23, 8));
+        __m128i c = _mm_unpacklo_epi8(r45, _mm_srli_si128(r45, 8));
+        __m128i d = _mm_unpacklo_epi8(r67, _mm_srli_si128(r67, 8));
+        
+        __m128i abLo = _mm_unpacklo_epi16(a, b);
+        __m128i abHi = _mm_unpackhi_epi16(a, b);
+        __m128i cdLo = _mm_unpacklo_epi16(c, d);
+        __m128i cdHi = _mm_unpackhi_epi16(c, d);
+        
+        __m128i lanes01 = _mm_unpacklo_epi32(abLo, cdLo);
+        __m128i lanes23 = _mm_unpackhi_epi32(abLo, cdLo);
+        __m128i lanes45 = _mm_unpacklo_epi32(abHi, cdHi);
+        __m128i lanes67 = _mm_unpackhi_epi32(abHi, cdHi);
+        
+        _mm_storel_epi64((__m128i *) (outPtr + 0*numSymbolsInBlock), lanes01);
+        _mm_storel_epi64((__m128i *) (outPtr + 1*numSymbolsInBlock), _mm_srli_si128(lanes01, 8));
+        _mm_storel_epi64((__m128i *) (outPtr + 2*numSymbolsInBlock), lanes23);
+        _mm_storel_epi64((__m128i *) (outPtr + 3*numSymbolsInBlock), _mm_srli_si128(lanes23, 8));
+        _mm_storel_epi64((__m128i *) (outPtr + 4*numSymbolsInBlock), lanes45);
+        _mm_storel_epi64((__m128i *) (outPtr + 5*numSymbolsInBlock), _mm_srli_si128(lanes45, 8));
+        _mm_storel_epi64((__m128i *) (outPtr + 6*numSymbolsInBlock), lanes67);
+        _mm_storel_epi64((__m128i *) (outPtr + 7*numSymbolsInBlock), _mm_srli_si128(lanes67, 8));
+    }
+    
+    // 8 lanes, the window for each lane is read with a gather
+    
+    __attribute__((target("avx2")))
+    static void decodeGroupAVX2(const uint8_t *bitBuff,
+                                const uint32_t *groupOffsetsPtr,
+                                uint8_t *groupOutPtr)
+    {
+        const __m256i bswapMask = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+                                                   3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+        const __m256i packOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        const __m256i seven = _mm256_set1_epi32(7);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i exponentBias = _mm256_set1_epi32(150);
+        const __m256i thirtyTwo = _mm256_set1_epi32(32);
+        const __m256i zero = _mm256_setzero_si256();
+        
+        __m256i bitOffsets = _mm256_loadu_si256((const __m256i *) groupOffsetsPtr);
+        __m256i prevSymbols = zero;
+        
+        uint8_t staging[numSymbolsInBlock * 8];
+        __m256i steps[4];
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli++ ) {
+            __m256i byteOffsets = _mm256_srli_epi32(bitOffsets, 3);
+            __m256i window = _mm256_i32gather_epi32((const int *) bitBuff, byteOffsets, 1);
+            window = _mm256_shuffle_epi8(window, bswapMask);
+            window = _mm256_sllv_epi32(window, _mm256_and_si256(bitOffsets, seven));
+            
+            // The top 24 bits convert to float exactly, the exponent of
+            // the float gives the position of the leading 1 bit.
+            
+            __m256 top24 = _mm256_cvtepi32_ps(_mm256_srli_epi32(window, 8));
+            __m256i numZeros = _mm256_sub_epi32(exponentBias, _mm256_srli_epi32(_mm256_castps_si256(top24), 23));
+            __m256i bitWidths = _mm256_add_epi32(_mm256_add_epi32(numZeros, numZeros), one);
+            
+            __m256i symbols = _mm256_srlv_epi32(window, _mm256_sub_epi32(thirtyTwo, bitWidths));
+            symbols = _mm256_sub_epi32(symbols, one);
+            bitOffsets = _mm256_add_epi32(bitOffsets, bitWidths);
+            
+            // Undo zigzag, then add to the previous symbol in the block
+            
+            __m256i deltas = _mm256_xor_si256(_mm256_srli_epi32(symbols, 1),
+                                              _mm256_sub_epi32(zero, _mm256_and_si256(symbols, one)));
+            prevSymbols = _mm256_and_si256(_mm256_add_epi32(prevSymbols, deltas), byteMask);
+            
+            steps[symboli & 3] = prevSymbols;
+            
+            if ((symboli & 3) == 3) {
+                __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(steps[0], steps[1]),
+                                                     _mm256_packus_epi32(steps[2], steps[3]));
+                packed = _mm256_permutevar8x32_epi32(packed, packOrder);
+                _mm256_storeu_si256((__m256i *) (staging + (symboli - 3) * 8), packed);
+            }
+        }
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli += 8 ) {
+            transposeStore8x8(staging + symboli * 8, groupOutPtr + symboli);
+        }
+    }
+    
+    // 4 lanes, SSE has no gather or variable shift so each window is
+    // loaded with a scalar read and shifts are done as multiplies by 2^n.
+    
+    __attribute__((target("sse4.1")))
+    static inline __m128i powerOfTwoSSE41(__m128i exponents)
+    {
+        __m128i floatBits = _mm_slli_epi32(_mm_add_epi32(exponents, _mm_set1_epi32(127)), 23);
+        return _mm_cvttps_epi32(_mm_castsi128_ps(floatBits));
+    }
+    
+    __attribute__((target("sse4.1")))
+    static void decodeGroupSSE41(const uint8_t *bitBuff,
+                                 const uint32_t *groupOffsetsPtr,
+                                 uint8_t *groupOutPtr)
+    {
+        const __m128i seven = _mm_set1_epi32(7);
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128i exponentBias = _mm_set1_epi32(150);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i transposeMask = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+        
+        __m128i bitOffsets = _mm_loadu_si128((const __m128i *) groupOffsetsPtr);
+        __m128i prevSymbols = zero;
+        
+        uint8_t staging[numSymbolsInBlock * 4];
+        __m128i steps[4];
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli++ ) {
+            __m128i window = _mm_setr_epi32((int) load32BE(bitBuff + (_mm_extract_epi32(bitOffsets, 0) >> 3)),
+                                            (int) load32BE(bitBuff + (_mm_extract_epi32(bitOffsets, 1) >> 3)),
+                                            (int) load32BE(bitBuff + (_mm_extract_epi32(bitOffsets, 2) >> 3)),
+                                            (int) load32BE(bitBuff + (_mm_extract_epi32(bitOffsets, 3) >> 3)));
+            window = _mm_mullo_epi32(window, powerOfTwoSSE41(_mm_and_si128(bitOffsets, seven)));
+            
+            __m128 top24 = _mm_cvtepi32_ps(_mm_srli_epi32(window, 8));
+            __m128i numZeros = _mm_sub_epi32(exponentBias, _mm_srli_epi32(_mm_castps_si128(top24), 23));
+            __m128i bitWidths = _mm_add_epi32(_mm_add_epi32(numZeros, numZeros), one);
+            
+            // (window >> (32 - width)) is the high word of (window * 2^width)
+            
+            __m128i scale = powerOfTwoSSE41(bitWidths);
+            __m128i evenProducts = _mm_mul_epu32(window, scale);
+            __m128i oddProducts = _mm_mul_epu32(_mm_srli_epi64(window, 32), _mm_srli_epi64(scale, 32));
+            __m128i symbols = _mm_blend_epi16(_mm_srli_epi64(evenProducts, 32), oddProducts, 0xCC);
+            symbols = _mm_sub_epi32(symbols, one);
+            bitOffsets = _mm_add_epi32(bitOffsets, bitWidths);
+            
+            __m128i deltas = _mm_xor_si128(_mm_srli_epi32(symbols, 1),
+                                           _mm_sub_epi32(zero, _mm_and_si128(symbols, one)));
+            prevSymbols = _mm_and_si128(_mm_add_epi32(prevSymbols, deltas), byteMask);
+            
+            steps[symboli & 3] = prevSymbols;
+            
+            if ((symboli & 3) == 3) {
+                __m128i packed = _mm_packus_epi16(_mm_packus_epi32(steps[0], steps[1]),
+                                                  _mm_packus_epi32(steps[2], steps[3]));
+                _mm_storeu_si128((__m128i *) (staging + (symboli - 3) * 4), packed);
+            }
+        }
+        
+        // Each 16 byte row holds 4 steps of 4 lanes, group bytes by lane
+        // and then transpose 4x4 words so that each register is one lane.
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli += 16 ) {
+            const uint8_t *rowPtr = staging + symboli * 4;
+            __m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (rowPtr + 0)), transposeMask);
+            __m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (rowPtr + 16)), transposeMask);
+            __m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (rowPtr + 32)), transposeMask);
+            __m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (rowPtr + 48)), transposeMask);
+            
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+            
+            _mm_storeu_si128((__m128i *) (groupOutPtr + 0*numSymbolsInBlock + symboli), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (groupOutPtr + 1*numSymbolsInBlock + symboli), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (groupOutPtr + 2*numSymbolsInBlock + symboli), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i *) (groupOutPtr + 3*numSymbolsInBlock + symboli), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+
+#endif // ELIAS_SIMD_X86
+
+#if defined(ELIAS_SIMD_NEON)
+    
+    // 4 lanes, NEON has a native clz and a signed variable shift
+    
+    static void decodeGroupNEON(const uint8_t *bitBuff,
+                                const uint32_t *groupOffsetsPtr,
+                                uint8_t *groupOutPtr)
+    {
+        const uint32x4_t seven = vdupq_n_u32(7);
+        const uint32x4_t one = vdupq_n_u32(1);
+        const uint32x4_t byteMask = vdupq_n_u32(0xFF);
+        const int32x4_t thirtyTwo = vdupq_n_s32(32);
+        
+        uint32x4_t bitOffsets = vld1q_u32(groupOffsetsPtr);
+        uint32x4_t prevSymbols = vdupq_n_u32(0);
+        
+        uint8_t staging[numSymbolsInBlock * 4];
+        uint16x4_t steps[4];
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli++ ) {
+            uint32_t windows[4];
+            windows[0] = load32BE(bitBuff + (vgetq_lane_u32(bitOffsets, 0) >> 3));
+            windows[1] = load32BE(bitBuff + (vgetq_lane_u32(bitOffsets, 1) >> 3));
+            windows[2] = load32BE(bitBuff + (vgetq_lane_u32(bitOffsets, 2) >> 3));
+            windows[3] = load32BE(bitBuff + (vgetq_lane_u32(bitOffsets, 3) >> 3));
+            
+            uint32x4_t window = vld1q_u32(windows);
+            window = vshlq_u32(window, vreinterpretq_s32_u32(vandq_u32(bitOffsets, seven)));
+            
+            uint32x4_t numZeros = vclzq_u32(window);
+            uint32x4_t bitWidths = vaddq_u32(vaddq_u32(numZeros, numZeros), one);
+            
+            // A negative shift count is a right shift
+            
+            int32x4_t rightShifts = vsubq_s32(vreinterpretq_s32_u32(bitWidths), thirtyTwo);
+            uint32x4_t symbols = vsubq_u32(vshlq_u32(window, rightShifts), one);
+            bitOffsets = vaddq_u32(bitOffsets, bitWidths);
+            
+            uint32x4_t deltas = veorq_u32(vshrq_n_u32(symbols, 1),
+                                          vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(symbols, one)))));
+            prevSymbols = vandq_u32(vaddq_u32(prevSymbols, deltas), byteMask);
+            
+            steps[symboli & 3] = vmovn_u32(prevSymbols);
+            
+            if ((symboli & 3) == 3) {
+                uint8x16_t packed = vcombine_u8(vmovn_u16(vcombine_u16(steps[0], steps[1])),
+                                                vmovn_u16(vcombine_u16(steps[2], steps[3])));
+                vst1q_u8(staging + (symboli - 3) * 4, packed);
+            }
+        }
+        
+        // De-interleaving load of 16 steps splits the 4 lanes
+        
+        for ( int symboli = 0; symboli < numSymbolsInBlock; symboli += 16 ) {
+            uint8x16x4_t lanes = vld4q_u8(staging + symboli * 4);
+            vst1q_u8(groupOutPtr + 0*numSymbolsInBlock + symboli, lanes.val[0]);
+            vst1q_u8(groupOutPtr + 1*numSymbolsInBlock + symboli, lanes.val[1]);
+            vst1q_u8(groupOutPtr + 2*numSymbolsInBlock + symboli, lanes.val[2]);
+            vst1q_u8(groupOutPtr + 3*numSymbolsInBlock + symboli, lanes.val[3]);
+        }
+    }
+
+#endif // ELIAS_SIMD_NEON
+};
+
+#endif // elias_simd_hpp
@@ -0,0 +1,158 @@
+//
+//  elias_threads.hpp
+//
+//  Created by Mo DeJong on 6/3/18.
+//  Copyright © 2018 helpurock. All rights reserved.
+//
+//  A minimal fixed size worker pool used to run block decode
+//  work in parallel. Worker threads are created once and then
+//  reused for each frame so that a decode does not pay the cost
+//  of thread creation.
+
+#ifndef elias_threads_hpp
+#define elias_threads_hpp
+
+#include <assert.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class EliasWorkerPool
+{
+    public:
+    
+    // Create a pool with numWorkers background threads, note that
+    // the thread that invokes apply() also executes tasks.
+    
+    explicit EliasWorkerPool(int numWorkers)
+    : work(nullptr), numTasks(0), nextTask(0), numTasksDone(0), isStopping(false)
+    {
+        for (int i = 0; i < numWorkers; i++) {
+            workers.push_back(std::thread(&EliasWorkerPool::workerLoop, this));
+        }
+    }
+    
+    ~EliasWorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        workCond.notify_all();
+        for ( std::thread & worker : workers ) {
+            worker.join();
+        }
+    }
+    
+    EliasWorkerPool(const EliasWorkerPool &) = delete;
+    EliasWorkerPool & operator=(const EliasWorkerPool &) = delete;
+    
+    // The number of threads that can execute tasks at the same time
+    
+    int concurrency() const {
+        return (int) workers.size() + 1;
+    }
+    
+    // Invoke taskFunc(taski) for each taski in (0, numTasks - 1) and
+    // return once every task has completed, like dispatch_apply().
+    
+    void apply(int inNumTasks, const std::function<void(int)> & taskFunc)
+    {
+        if (inNumTasks <= 0) {
+            return;
+        }
+        
+        if (workers.size() == 0 || inNumTasks == 1) {
+            for (int taski = 0; taski < inNumTasks; taski++) {
+                taskFunc(taski);
+            }
+            return;
+        }
+        
+        std::unique_lock<std::mutex> applyLock(applyMutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        work = &taskFunc;
+        numTasks = inNumTasks;
+        nextTask = 0;
+        numTasksDone = 0;
+        
+        workCond.notify_all();
+        
+        // The calling thread takes tasks until none are left
+        
+        while (nextTask < numTasks) {
+            int taski = nextTask++;
+            lock.unlock();
+            taskFunc(taski);
+            lock.lock();
+            numTasksDone++;
+        }
+        
+        doneCond.wait(lock, [this]{ return numTasksDone == numTasks; });
+        
+        work = nullptr;
+        numTasks = 0;
+        nextTask = 0;
+        numTasksDone = 0;
+    }
+    
+    // Shared pool with one thread for each hardware core
+    
+    static EliasWorkerPool & sharedPool()
+    {
+        static EliasWorkerPool pool(defaultNumWorkers());
+        return pool;
+    }
+    
+    static int defaultNumWorkers()
+    {
+        int numCores = (int) std::thread::hardware_concurrency();
+        return (numCores > 1) ? (numCores - 1) : 0;
+    }
+    
+    private:
+    
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        while (1) {
+            workCond.wait(lock, [this]{ return isStopping || (nextTask < numTasks); });
+            
+            if (isStopping) {
+                return;
+            }
+            
+            int taski = nextTask++;
+            const std::function<void(int)> *taskFuncPtr = work;
+            
+            lock.unlock();
+            (*taskFuncPtr)(taski);
+            lock.lock();
+            
+            numTasksDone++;
+            if (numTasksDone == numTasks) {
+                doneCond.notify_all();
+            }
+        }
+    }
+    
+    std::vector<std::thread> workers;
+    
+    std::mutex applyMutex;
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    
+    const std::function<void(int)> *work;
+    int numTasks;
+    int nextTask;
+    int numTasksDone;
+    bool isStopping;
+};
+
+#endif // elias_threads_hpp